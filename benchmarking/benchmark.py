@@ -1,15 +1,15 @@
 import argparse
 import csv
 import os
-from filesystem import Ext4FileSystem, Ext4FuseFileSystem, FloudsFileSystem
+from filesystem import Ext4FileSystem, Ext4FuseFileSystem, FloudsFileSystem, FloudsSingleThreadedFileSystem
 from workload import Workload
 
 # Main function that parses arguments, runs workloads, and saves results to csv
 def main():
-    default_workloads = ["append_small_1000", "create_dirs_deep_250000", "create_dirs_flat_250000", "create_small_5000", "delete_small_5000", "dirops_deep_5000", "dirops_flat_5000", "fileserver_read_500", "fileserver_read_5000", "fileserver_rw_500", "fileserver_rw_5000", "open_close_5000", "remove_dirs_deep_20000", "remove_dirs_flat_20000", "rread_1g", "rwrite_1g", "seqread_1g", "seqwrite_1g"]
+    default_workloads = ["append_small_1000", "create_dirs_deep_250000", "create_dirs_flat_250000", "create_small_5000", "delete_small_5000", "dirops_deep_5000", "dirops_flat_5000", "fileserver_read_500", "fileserver_read_5000", "fileserver_read_mt_5000", "fileserver_rw_500", "fileserver_rw_5000", "list_flat_250000", "open_close_5000", "remove_dirs_deep_20000", "remove_dirs_flat_20000", "rread_1g", "rwrite_1g", "seqread_1g", "seqwrite_1g", "stat_flat_250000"]
 
     parser = argparse.ArgumentParser(description="Benchmarking Suite")
-    parser.add_argument("--target", required=True, choices=["ext4", "ext4_fuse", "flouds"], help="Target filesystem to benchmark")
+    parser.add_argument("--target", required=True, choices=["ext4", "ext4_fuse", "flouds", "flouds_single_threaded"], help="Target filesystem to benchmark")
     parser.add_argument("--workloads", nargs='*', help="Specific workloads to run (default: all)", choices=default_workloads)
     parser.add_argument("--output", help="Output file for results", default="benchmark_results.csv")
     parser.add_argument("--folder", help="Folder to run benchmarks in (default: current directory)", default=".")
@@ -27,6 +27,8 @@ def main():
         filesystem = Ext4FuseFileSystem()
     elif args.target == "flouds":
         filesystem = FloudsFileSystem()
+    elif args.target == "flouds_single_threaded":
+        filesystem = FloudsSingleThreadedFileSystem()
     
     # If no specific workloads provided, run all default workloads
     workloads = args.workloads if args.workloads else default_workloads
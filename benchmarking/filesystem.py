@@ -55,4 +55,11 @@ class FloudsFileSystem(FileSystem):
 
     def teardown(self):
         os.system("fusermount -u tmp")
-        os.system("rm -rf tmp flouds.img succinct_filesystem")
\ No newline at end of file
+        os.system("rm -rf tmp flouds.img succinct_filesystem")
+
+# FLOUDS filesystem that handles one request at a time, to compare the scaling of the multi-threaded session
+class FloudsSingleThreadedFileSystem(FloudsFileSystem):
+    def setup(self):
+        os.system("sudo cp ../build/succinct_filesystem ./succinct_filesystem")
+        os.system("mkdir tmp")
+        os.system("sudo ./succinct_filesystem -s $(pwd)/flouds.img tmp")
\ No newline at end of file
@@ -0,0 +1,15 @@
+set $dir=tmp
+set $nfiles=250000
+set $meandirwidth=250000
+
+define fileset name=listflat,path=$dir,size=0,entries=$nfiles,dirwidth=$meandirwidth,prealloc=100
+
+define process name=list,instances=1
+{
+  thread name=listthread,memsize=1m,instances=1
+  {
+    flowop listdir name=listdir1,filesetname=listflat
+  }
+}
+
+run 10
\ No newline at end of file
@@ -0,0 +1,15 @@
+set $dir=tmp
+set $nfiles=250000
+set $meandirwidth=600
+
+define fileset name=statflat,path=$dir,size=0,entries=$nfiles,dirwidth=$meandirwidth,prealloc=100
+
+define process name=stat,instances=1
+{
+  thread name=statthread,memsize=1m,instances=1
+  {
+    flowop statfile name=stat1,filesetname=statflat
+  }
+}
+
+run 10
\ No newline at end of file
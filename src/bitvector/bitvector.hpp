@@ -31,6 +31,19 @@ public:
      */
     virtual void set(size_t position, bool value) = 0;
 
+    /**
+     * Sets a range of bits to the given value. Strategies may override this to set whole words at once.
+     * 
+     * @param position The 0-based position of the first bit to set.
+     * @param count The number of bits to set. position + count must not exceed the size of the bit vector.
+     * @param value The value to set the bits to.
+     */
+    virtual void set_range(size_t position, size_t count, bool value) {
+        for (size_t i = position; i < position + count; i++) {
+            set(i, value);
+        }
+    }
+
     /**
      * Accesses the value of the bit at the specified position.
      * 
@@ -129,4 +142,7 @@ class SaskeliBitVectorStrategy;
 template <> BitVector* create_bitvector<SaskeliBitVectorStrategy>(size_t n);
 
 class AdaptiveDynamicBitVectorStrategy;
-template <> BitVector* create_bitvector<AdaptiveDynamicBitVectorStrategy>(size_t n);
\ No newline at end of file
+template <> BitVector* create_bitvector<AdaptiveDynamicBitVectorStrategy>(size_t n);
+
+class BTreeBitVectorStrategy;
+template <> BitVector* create_bitvector<BTreeBitVectorStrategy>(size_t n);
\ No newline at end of file
@@ -0,0 +1,44 @@
+/**
+ * This file is part of the Succinct Filesystem project.
+ * 
+ * Copyright (c) 2026 Sebastian Brunnert <mail@sebastianbrunnert.de>
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+/**
+ * Gets the position of the (rank+1)-th 1-bit within a machine word.
+ * 
+ * @param word The word to search in.
+ * @param rank The 0-based rank of the 1-bit to find. Must be less than the number of 1-bits in the word.
+ * @return The 0-based position of the 1-bit within the word.
+ */
+inline size_t select_in_word(uint64_t word, size_t rank) {
+    #if defined(__BMI2__)
+    // Deposit a single bit at the position of the rank-th 1-bit of the word
+    return __builtin_ctzll(_pdep_u64(1ull << rank, word));
+    #else
+    // Skip whole bytes first, then clear the lowest 1-bits of the target byte
+    size_t shift = 0;
+    size_t count = __builtin_popcountll(word & 0xFF);
+    while (rank >= count) {
+        rank -= count;
+        shift += 8;
+        count = __builtin_popcountll((word >> shift) & 0xFF);
+    }
+
+    uint64_t byte = (word >> shift) & 0xFF;
+    for (; rank > 0; rank--) {
+        byte &= byte - 1;
+    }
+    return shift + __builtin_ctzll(byte);
+    #endif
+}
@@ -0,0 +1,519 @@
+/**
+ * This file is part of the Succinct Filesystem project.
+ *
+ * Copyright (c) 2026 Sebastian Brunnert <mail@sebastianbrunnert.de>
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <vector>
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+#include "bitvector.hpp"
+#include "broadword.hpp"
+
+/**
+ * Dynamic implementation of the BitVector interface as a counted B+ tree.
+ * The bits are stored in leaves of up to 512 bits. Each inner node stores the number of bits and 1-bits of each child, so all operations take logarithmic time.
+ * The serialized format is the same as the one of the WordBitVectorStrategy.
+ */
+class BTreeBitVectorStrategy : public BitVector {
+private:
+    static constexpr size_t LEAF_WORDS = 8;
+    static constexpr size_t LEAF_BITS = LEAF_WORDS * 64;
+    static constexpr size_t FANOUT = 16;
+
+    struct Leaf {
+        uint64_t words[LEAF_WORDS] = {};
+    };
+
+    struct Inner {
+        size_t count = 0;
+        size_t bits[FANOUT];
+        size_t ones[FANOUT];
+        void* children[FANOUT];
+    };
+
+    /**
+     * Result of an insertion into a subtree. If the subtree was split, the new right sibling is returned with its counts.
+     */
+    struct Split {
+        void* node = nullptr;
+        size_t bits = 0;
+        size_t ones = 0;
+    };
+
+    // Leaves have height 0
+    void* root;
+    size_t height = 0;
+    size_t num_bits = 0;
+    size_t num_ones = 0;
+
+    static size_t get_bits(const uint64_t* words, size_t offset, size_t length) {
+        size_t word = offset / 64;
+        size_t shift = offset % 64;
+        uint64_t value = words[word] >> shift;
+        if (shift > 0 && shift + length > 64) {
+            value |= words[word + 1] << (64 - shift);
+        }
+        return length == 64 ? value : value & ((1ull << length) - 1);
+    }
+
+    static void put_bits(uint64_t* words, size_t offset, size_t length, uint64_t value) {
+        size_t word = offset / 64;
+        size_t shift = offset % 64;
+        uint64_t mask = length == 64 ? ~0ull : (1ull << length) - 1;
+        words[word] = (words[word] & ~(mask << shift)) | (value << shift);
+        if (shift > 0 && shift + length > 64) {
+            words[word + 1] = (words[word + 1] & ~(mask >> (64 - shift))) | (value >> (64 - shift));
+        }
+    }
+
+    static void copy_bits(uint64_t* destination, size_t destination_offset, const uint64_t* source, size_t source_offset, size_t length) {
+        for (size_t i = 0; i < length; i += 64) {
+            size_t chunk = std::min<size_t>(64, length - i);
+            put_bits(destination, destination_offset + i, chunk, get_bits(source, source_offset + i, chunk));
+        }
+    }
+
+    static size_t count_ones(const uint64_t* words, size_t length) {
+        size_t count = 0;
+        for (size_t i = 0; i < length / 64; i++) {
+            count += __builtin_popcountll(words[i]);
+        }
+        if (length % 64 > 0) {
+            count += __builtin_popcountll(words[length / 64] & ((1ull << (length % 64)) - 1));
+        }
+        return count;
+    }
+
+    /**
+     * Builds a tree from a contiguous bit sequence. Leaves are filled completely.
+     */
+    void build(const uint64_t* words, size_t n) {
+        std::vector<void*> nodes;
+        std::vector<size_t> bits;
+        std::vector<size_t> ones;
+        for (size_t offset = 0; offset < n || nodes.empty(); offset += LEAF_BITS) {
+            Leaf* leaf = new Leaf();
+            size_t length = std::min(LEAF_BITS, n - offset);
+            if (words != nullptr) {
+                copy_bits(leaf->words, 0, words, offset, length);
+            }
+            nodes.push_back(leaf);
+            bits.push_back(length);
+            ones.push_back(count_ones(leaf->words, length));
+        }
+
+        height = 0;
+        while (nodes.size() > 1) {
+            std::vector<void*> parents;
+            std::vector<size_t> parent_bits;
+            std::vector<size_t> parent_ones;
+            // Inner nodes are split as soon as they are full, so they hold at most FANOUT - 1 children
+            for (size_t i = 0; i < nodes.size(); i += FANOUT - 1) {
+                Inner* inner = new Inner();
+                size_t total_bits = 0;
+                size_t total_ones = 0;
+                for (size_t j = i; j < std::min(i + FANOUT - 1, nodes.size()); j++) {
+                    inner->children[inner->count] = nodes[j];
+                    inner->bits[inner->count] = bits[j];
+                    inner->ones[inner->count] = ones[j];
+                    inner->count++;
+                    total_bits += bits[j];
+                    total_ones += ones[j];
+                }
+                parents.push_back(inner);
+                parent_bits.push_back(total_bits);
+                parent_ones.push_back(total_ones);
+            }
+            nodes.swap(parents);
+            bits.swap(parent_bits);
+            ones.swap(parent_ones);
+            height++;
+        }
+
+        root = nodes[0];
+        num_bits = n;
+        num_ones = ones[0];
+    }
+
+    void destroy(void* node, size_t level) {
+        if (level == 0) {
+            delete static_cast<Leaf*>(node);
+            return;
+        }
+        Inner* inner = static_cast<Inner*>(node);
+        for (size_t i = 0; i < inner->count; i++) {
+            destroy(inner->children[i], level - 1);
+        }
+        delete inner;
+    }
+
+    /**
+     * Finds the child of an inner node that contains the given position and makes the position relative to that child.
+     */
+    static size_t find_child(const Inner* inner, size_t& position) {
+        size_t i = 0;
+        while (i + 1 < inner->count && position >= inner->bits[i]) {
+            position -= inner->bits[i];
+            i++;
+        }
+        return i;
+    }
+
+    /**
+     * Collects the bits of a subtree into a contiguous word array.
+     */
+    void collect(const void* node, size_t level, size_t length, uint64_t* words, size_t& offset) const {
+        if (level == 0) {
+            copy_bits(words, offset, static_cast<const Leaf*>(node)->words, 0, length);
+            offset += length;
+            return;
+        }
+        const Inner* inner = static_cast<const Inner*>(node);
+        for (size_t i = 0; i < inner->count; i++) {
+            collect(inner->children[i], level - 1, inner->bits[i], words, offset);
+        }
+    }
+
+    Split insert(void* node, size_t level, size_t length, size_t position, bool value) {
+        if (level == 0) {
+            Leaf* leaf = static_cast<Leaf*>(node);
+            Split split;
+            if (length == LEAF_BITS) {
+                // Move the upper half into a new leaf
+                Leaf* right = new Leaf();
+                copy_bits(right->words, 0, leaf->words, LEAF_BITS / 2, LEAF_BITS / 2);
+                std::memset(leaf->words + LEAF_WORDS / 2, 0, LEAF_WORDS / 2 * sizeof(uint64_t));
+                split = {right, LEAF_BITS / 2, count_ones(right->words, LEAF_BITS / 2)};
+                if (position > LEAF_BITS / 2) {
+                    insert(right, 0, LEAF_BITS / 2, position - LEAF_BITS / 2, value);
+                    split.bits++;
+                    split.ones += value ? 1 : 0;
+                    return split;
+                }
+            }
+
+            size_t word_index = position / 64;
+            size_t bit_index = position % 64;
+            for (size_t i = LEAF_WORDS - 1; i > word_index; i--) {
+                leaf->words[i] = (leaf->words[i] << 1) | (leaf->words[i - 1] >> 63);
+            }
+            uint64_t mask = (1ull << bit_index) - 1;
+            leaf->words[word_index] = (leaf->words[word_index] & mask) | ((leaf->words[word_index] & ~mask) << 1);
+            if (value) {
+                leaf->words[word_index] |= (1ull << bit_index);
+            }
+            return split;
+        }
+
+        Inner* inner = static_cast<Inner*>(node);
+        size_t i = inner->count - 1;
+        size_t offset = position;
+        for (size_t j = 0; j < inner->count; j++) {
+            if (offset <= inner->bits[j]) {
+                i = j;
+                break;
+            }
+            offset -= inner->bits[j];
+        }
+
+        Split child_split = insert(inner->children[i], level - 1, inner->bits[i], offset, value);
+        inner->bits[i]++;
+        inner->ones[i] += value ? 1 : 0;
+        if (child_split.node == nullptr) {
+            return Split();
+        }
+
+        // Add the new child after the split one
+        inner->bits[i] -= child_split.bits;
+        inner->ones[i] -= child_split.ones;
+        for (size_t j = inner->count; j > i + 1; j--) {
+            inner->children[j] = inner->children[j - 1];
+            inner->bits[j] = inner->bits[j - 1];
+            inner->ones[j] = inner->ones[j - 1];
+        }
+        inner->children[i + 1] = child_split.node;
+        inner->bits[i + 1] = child_split.bits;
+        inner->ones[i + 1] = child_split.ones;
+        inner->count++;
+
+        if (inner->count < FANOUT) {
+            return Split();
+        }
+
+        // Split a full inner node into two halves
+        Inner* right = new Inner();
+        Split split{right, 0, 0};
+        for (size_t j = FANOUT / 2; j < FANOUT; j++) {
+            right->children[right->count] = inner->children[j];
+            right->bits[right->count] = inner->bits[j];
+            right->ones[right->count] = inner->ones[j];
+            right->count++;
+            split.bits += inner->bits[j];
+            split.ones += inner->ones[j];
+        }
+        inner->count = FANOUT / 2;
+        return split;
+    }
+
+    /**
+     * Removes a bit from a subtree.
+     *
+     * @return The value of the removed bit.
+     */
+    bool remove(void* node, size_t level, size_t position) {
+        if (level == 0) {
+            Leaf* leaf = static_cast<Leaf*>(node);
+            size_t word_index = position / 64;
+            size_t bit_index = position % 64;
+            bool value = (leaf->words[word_index] >> bit_index) & 1;
+
+            uint64_t mask = (1ull << bit_index) - 1;
+            leaf->words[word_index] = (leaf->words[word_index] & mask) | ((leaf->words[word_index] >> 1) & ~mask);
+            for (size_t i = word_index; i < LEAF_WORDS - 1; i++) {
+                leaf->words[i] |= (leaf->words[i + 1] << 63);
+                leaf->words[i + 1] >>= 1;
+            }
+            return value;
+        }
+
+        Inner* inner = static_cast<Inner*>(node);
+        size_t i = find_child(inner, position);
+        bool value = remove(inner->children[i], level - 1, position);
+        inner->bits[i]--;
+        inner->ones[i] -= value ? 1 : 0;
+        rebalance(inner, level, i);
+        return value;
+    }
+
+    /**
+     * Removes empty children and merges a child that became small with one of its neighbours.
+     */
+    void rebalance(Inner* inner, size_t level, size_t i) {
+        if (inner->bits[i] == 0) {
+            destroy(inner->children[i], level - 1);
+            erase_child(inner, i);
+            return;
+        }
+
+        size_t child_size = level == 1 ? inner->bits[i] : static_cast<Inner*>(inner->children[i])->count;
+        size_t capacity = level == 1 ? LEAF_BITS : FANOUT;
+        if (child_size >= capacity / 4) {
+            return;
+        }
+
+        for (size_t left : {i - 1, i}) {
+            // Merge the children left and left + 1 if both exist and fit into one node
+            if (left == SIZE_MAX || left + 1 >= inner->count) continue;
+            if (level == 1) {
+                if (inner->bits[left] + inner->bits[left + 1] > LEAF_BITS) continue;
+                Leaf* target = static_cast<Leaf*>(inner->children[left]);
+                Leaf* source = static_cast<Leaf*>(inner->children[left + 1]);
+                copy_bits(target->words, inner->bits[left], source->words, 0, inner->bits[left + 1]);
+            } else {
+                Inner* target = static_cast<Inner*>(inner->children[left]);
+                Inner* source = static_cast<Inner*>(inner->children[left + 1]);
+                if (target->count + source->count > FANOUT - 1) continue;
+                for (size_t j = 0; j < source->count; j++) {
+                    target->children[target->count] = source->children[j];
+                    target->bits[target->count] = source->bits[j];
+                    target->ones[target->count] = source->ones[j];
+                    target->count++;
+                }
+                source->count = 0;
+            }
+
+            inner->bits[left] += inner->bits[left + 1];
+            inner->ones[left] += inner->ones[left + 1];
+            destroy(inner->children[left + 1], level - 1);
+            erase_child(inner, left + 1);
+            return;
+        }
+    }
+
+    static void erase_child(Inner* inner, size_t i) {
+        for (size_t j = i; j + 1 < inner->count; j++) {
+            inner->children[j] = inner->children[j + 1];
+            inner->bits[j] = inner->bits[j + 1];
+            inner->ones[j] = inner->ones[j + 1];
+        }
+        inner->count--;
+    }
+
+    template <bool one> size_t select(size_t n) const {
+        size_t total = one ? num_ones : num_bits - num_ones;
+        if (n == 0 || n > total) {
+            throw std::out_of_range(one ? "n exceeds number of 1-bits" : "n exceeds number of 0-bits");
+        }
+
+        const void* node = root;
+        size_t position = 0;
+        for (size_t level = height; level > 0; level--) {
+            const Inner* inner = static_cast<const Inner*>(node);
+            size_t i = 0;
+            while (true) {
+                size_t count = one ? inner->ones[i] : inner->bits[i] - inner->ones[i];
+                if (n <= count) break;
+                n -= count;
+                position += inner->bits[i];
+                i++;
+            }
+            node = inner->children[i];
+        }
+
+        const Leaf* leaf = static_cast<const Leaf*>(node);
+        for (size_t i = 0; ; i++) {
+            uint64_t word = one ? leaf->words[i] : ~leaf->words[i];
+            size_t count = __builtin_popcountll(word);
+            if (n <= count) {
+                return position + i * 64 + select_in_word(word, n - 1);
+            }
+            n -= count;
+        }
+    }
+
+public:
+    BTreeBitVectorStrategy(size_t n) {
+        build(nullptr, n);
+    }
+
+    ~BTreeBitVectorStrategy() override {
+        destroy(root, height);
+    }
+
+    void set(size_t position, bool value) override {
+        std::vector<std::pair<Inner*, size_t>> path;
+        void* node = root;
+        for (size_t level = height; level > 0; level--) {
+            Inner* inner = static_cast<Inner*>(node);
+            size_t i = find_child(inner, position);
+            path.push_back({inner, i});
+            node = inner->children[i];
+        }
+
+        Leaf* leaf = static_cast<Leaf*>(node);
+        bool old_value = (leaf->words[position / 64] >> (position % 64)) & 1;
+        if (old_value == value) return;
+
+        leaf->words[position / 64] ^= (1ull << (position % 64));
+        for (auto& [inner, i] : path) {
+            inner->ones[i] += value ? 1 : -1;
+        }
+        num_ones += value ? 1 : -1;
+    }
+
+    bool access(size_t position) const override {
+        const void* node = root;
+        for (size_t level = height; level > 0; level--) {
+            const Inner* inner = static_cast<const Inner*>(node);
+            node = inner->children[find_child(inner, position)];
+        }
+        return (static_cast<const Leaf*>(node)->words[position / 64] >> (position % 64)) & 1;
+    }
+
+    size_t size() const override {
+        return num_bits;
+    }
+
+    size_t rank1(size_t position) const override {
+        const void* node = root;
+        size_t count = 0;
+        for (size_t level = height; level > 0; level--) {
+            const Inner* inner = static_cast<const Inner*>(node);
+            size_t i = 0;
+            while (i + 1 < inner->count && position >= inner->bits[i]) {
+                position -= inner->bits[i];
+                count += inner->ones[i];
+                i++;
+            }
+            node = inner->children[i];
+        }
+        return count + count_ones(static_cast<const Leaf*>(node)->words, position + 1);
+    }
+
+    size_t rank0(size_t position) const override {
+        return position + 1 - rank1(position);
+    }
+
+    size_t select0(size_t n) const override {
+        return select<false>(n);
+    }
+
+    size_t select1(size_t n) const override {
+        return select<true>(n);
+    }
+
+    void insert(size_t position, bool value) override {
+        Split split = insert(root, height, num_bits, position, value);
+        num_bits++;
+        num_ones += value ? 1 : 0;
+
+        if (split.node != nullptr) {
+            // The root was split, so the tree grows by one level
+            Inner* inner = new Inner();
+            inner->count = 2;
+            inner->children[0] = root;
+            inner->bits[0] = num_bits - split.bits;
+            inner->ones[0] = num_ones - split.ones;
+            inner->children[1] = split.node;
+            inner->bits[1] = split.bits;
+            inner->ones[1] = split.ones;
+            root = inner;
+            height++;
+        }
+    }
+
+    void remove(size_t position) override {
+        num_ones -= remove(root, height, position) ? 1 : 0;
+        num_bits--;
+
+        // Shrink the tree while the root has a single child
+        while (height > 0 && static_cast<Inner*>(root)->count <= 1) {
+            Inner* inner = static_cast<Inner*>(root);
+            if (inner->count == 0) {
+                delete inner;
+                root = new Leaf();
+                height = 0;
+                break;
+            }
+            root = inner->children[0];
+            delete inner;
+            height--;
+        }
+    }
+
+    void serialize(char* buffer, size_t* offset) override {
+        memcpy(buffer + *offset, &num_bits, sizeof(size_t));
+        *offset += sizeof(size_t);
+
+        std::vector<uint64_t> words((num_bits + 63) / 64 + 1, 0);
+        size_t position = 0;
+        collect(root, height, num_bits, words.data(), position);
+        memcpy(buffer + *offset, words.data(), (num_bits + 63) / 64 * sizeof(uint64_t));
+        *offset += (num_bits + 63) / 64 * sizeof(uint64_t);
+    }
+
+    void deserialize(const char* buffer, size_t* offset) override {
+        size_t size;
+        memcpy(&size, buffer + *offset, sizeof(size_t));
+        *offset += sizeof(size_t);
+
+        std::vector<uint64_t> words((size + 63) / 64 + 1, 0);
+        memcpy(words.data(), buffer + *offset, (size + 63) / 64 * sizeof(uint64_t));
+        *offset += (size + 63) / 64 * sizeof(uint64_t);
+
+        destroy(root, height);
+        build(words.data(), size);
+    }
+
+    size_t get_serialized_size() override {
+        return sizeof(size_t) + (num_bits + 63) / 64 * sizeof(size_t);
+    }
+};
+
+template <>
+BitVector* create_bitvector<BTreeBitVectorStrategy>(std::size_t n) {
+    return new BTreeBitVectorStrategy(n);
+}
@@ -7,27 +7,157 @@
 
 #include <vector>
 #include <stdexcept>
+#include <algorithm>
 #include "bitvector.hpp"
+#include "broadword.hpp"
 #include <cstring>
 
 /**
  * Improved implementation of the BitVector interface.
  * This implemenation stores bits in a vector of machine words and implements the BitVector operations using SIMD operations on these words.
+ * A rank directory with interleaved counters for superblocks of 512 bits answers rank queries in constant time and select queries with a binary search over the superblocks.
  */
 class WordBitVectorStrategy : public BitVector {
 private:
+    static constexpr size_t WORDS_PER_SUPERBLOCK = 8;
+    static constexpr size_t BITS_PER_SUPERBLOCK = WORDS_PER_SUPERBLOCK * 64;
+
     std::vector<size_t> words;
     std::size_t num_bits;
 
+    // Two counters per superblock: the number of 1-bits before the superblock and the packed 9 bit counts of 1-bits before each of the words 1 to 7 within the superblock.
+    // A final pair holds the total number of 1-bits.
+    std::vector<uint64_t> counters;
+
+    size_t num_superblocks() const {
+        return (words.size() + WORDS_PER_SUPERBLOCK - 1) / WORDS_PER_SUPERBLOCK;
+    }
+
+    /**
+     * Gets the number of 1-bits before the given word.
+     */
+    size_t rank_before_word(size_t word_index) const {
+        size_t superblock = word_index / WORDS_PER_SUPERBLOCK;
+        size_t word_in_superblock = word_index % WORDS_PER_SUPERBLOCK;
+        size_t count = counters[2 * superblock];
+        if (word_in_superblock > 0) {
+            count += (counters[2 * superblock + 1] >> (9 * (word_in_superblock - 1))) & 0x1FF;
+        }
+        return count;
+    }
+
+    /**
+     * Recomputes the relative counters of a superblock.
+     * 
+     * @return The number of 1-bits in the superblock.
+     */
+    size_t update_superblock(size_t superblock) {
+        uint64_t relative = 0;
+        size_t count = 0;
+        for (size_t i = 0; i < WORDS_PER_SUPERBLOCK; i++) {
+            size_t word_index = superblock * WORDS_PER_SUPERBLOCK + i;
+            if (i > 0) {
+                relative |= (uint64_t) count << (9 * (i - 1));
+            }
+            if (word_index < words.size()) {
+                count += __builtin_popcountll(words[word_index]);
+            }
+        }
+        counters[2 * superblock + 1] = relative;
+        return count;
+    }
+
+    /**
+     * Recomputes the rank directory from the given superblock on. The counters of earlier superblocks must be valid.
+     */
+    void rebuild(size_t first_superblock) {
+        uint64_t count = counters[2 * first_superblock];
+        counters.resize(2 * (num_superblocks() + 1));
+        for (size_t superblock = first_superblock; superblock < num_superblocks(); superblock++) {
+            counters[2 * superblock] = count;
+            count += update_superblock(superblock);
+        }
+        counters[2 * num_superblocks()] = count;
+        counters[2 * num_superblocks() + 1] = 0;
+    }
+
+    /**
+     * Finds the position of the n-th 1-bit or 0-bit with a binary search over the superblocks.
+     */
+    template <bool one> size_t select(size_t n) const {
+        size_t total = one ? counters[2 * num_superblocks()] : num_bits - counters[2 * num_superblocks()];
+        if (n == 0 || n > total) {
+            throw std::out_of_range(one ? "n exceeds number of 1-bits" : "n exceeds number of 0-bits");
+        }
+
+        auto count_before = [&](size_t superblock) -> size_t {
+            return one ? counters[2 * superblock] : superblock * BITS_PER_SUPERBLOCK - counters[2 * superblock];
+        };
+
+        // Find the last superblock with less than n matching bits before it
+        size_t low = 0;
+        size_t high = num_superblocks() - 1;
+        while (low < high) {
+            size_t middle = (low + high + 1) / 2;
+            if (count_before(middle) < n) {
+                low = middle;
+            } else {
+                high = middle - 1;
+            }
+        }
+
+        // Find the word within the superblock
+        size_t word_index = low * WORDS_PER_SUPERBLOCK;
+        size_t last_word = std::min(word_index + WORDS_PER_SUPERBLOCK, words.size()) - 1;
+        auto count_before_word = [&](size_t index) -> size_t {
+            return one ? rank_before_word(index) : index * 64 - rank_before_word(index);
+        };
+        while (word_index < last_word && count_before_word(word_index + 1) < n) {
+            word_index++;
+        }
+
+        uint64_t word = one ? words[word_index] : ~words[word_index];
+        return word_index * 64 + select_in_word(word, n - count_before_word(word_index) - 1);
+    }
+
 public:
-    WordBitVectorStrategy(size_t n) : num_bits(n), words((n + sizeof(size_t) * 8 - 1) / (sizeof(size_t) * 8), 0) {};
+    WordBitVectorStrategy(size_t n) : num_bits(n), words((n + sizeof(size_t) * 8 - 1) / (sizeof(size_t) * 8), 0), counters(2 * ((n + BITS_PER_SUPERBLOCK - 1) / BITS_PER_SUPERBLOCK + 1), 0) {};
     
     void set(size_t position, bool value) override {
+        size_t old_word = words[position / 64];
         if (value) {
             words[position / 64] |= (1ull << (position % 64));
         } else {
             words[position / 64] &= ~(1ull << (position % 64));
         }
+
+        if (old_word != words[position / 64]) {
+            size_t superblock = position / BITS_PER_SUPERBLOCK;
+            update_superblock(superblock);
+            for (size_t i = superblock + 1; i <= num_superblocks(); i++) {
+                counters[2 * i] += value ? 1 : -1;
+            }
+        }
+    }
+
+    void set_range(size_t position, size_t count, bool value) override {
+        if (count == 0) return;
+
+        size_t end = position + count;
+        for (size_t word_index = position / 64; word_index * 64 < end; word_index++) {
+            // Mask of the bits of the range within this word
+            size_t first = std::max(position, word_index * 64) - word_index * 64;
+            size_t last = std::min(end, word_index * 64 + 64) - word_index * 64;
+            uint64_t mask = (last - first == 64) ? ~0ull : ((1ull << (last - first)) - 1) << first;
+            if (value) {
+                words[word_index] |= mask;
+            } else {
+                words[word_index] &= ~mask;
+            }
+        }
+
+        // The directory is only updated once for the whole range
+        rebuild(position / BITS_PER_SUPERBLOCK);
     }
 
     bool access(size_t position) const override {
@@ -39,14 +169,10 @@ public:
     }
 
     size_t rank1(size_t position) const override {
-        size_t count = 0;
         size_t full_words = (position + 1) / 64;
         size_t remaining_bits = (position + 1) % 64;
 
-        for(size_t i = 0; i < full_words; i++) {
-            count += __builtin_popcountll(words[i]);
-        }
-
+        size_t count = rank_before_word(full_words);
         if (remaining_bits > 0) {
             count += __builtin_popcountll(words[full_words] & ((1ull << remaining_bits) - 1));
         }
@@ -59,69 +185,11 @@ public:
     }
 
     size_t select0(size_t n) const override {
-        size_t count = 0;
-        for(size_t i = 0; i < words.size(); i++) {
-            size_t bits_in_word = 64;
-            size_t masked_word = words[i];
-            if(i == words.size()-1) {
-                bits_in_word = num_bits % 64;
-                if(bits_in_word == 0) bits_in_word = 64;
-                if (bits_in_word < 64) {
-                    masked_word &= (1ull << bits_in_word) - 1;
-                }
-            }
-
-            size_t word_count = bits_in_word - __builtin_popcountll(masked_word);
-
-            if (count + word_count >= n) {
-                size_t remaining = n - count;
-                for(size_t j = 0; j < bits_in_word; j++) {
-                    if (((masked_word >> j) & 1) == 0) {
-                        remaining--;
-                        if (remaining == 0) {
-                            return i * 64 + j;
-                        }
-                    }
-                }
-            }
-
-            count += word_count;
-        }
-
-        throw std::out_of_range("n exceeds number of 1-bits");
+        return select<false>(n);
     }
 
     size_t select1(size_t n) const override {
-        size_t count = 0;
-        for(size_t i = 0; i < words.size(); i++) {
-            size_t bits_in_word = 64;
-            size_t masked_word = words[i];
-            if(i == words.size()-1) {
-                bits_in_word = num_bits % 64;
-                if(bits_in_word == 0) bits_in_word = 64;
-                if (bits_in_word < 64) {
-                    masked_word &= (1ull << bits_in_word) - 1;
-                }
-            }
-
-            size_t word_count = __builtin_popcountll(masked_word);
-
-            if (count + word_count >= n) {
-                size_t remaining = n - count;
-                for(size_t j = 0; j < bits_in_word; j++) {
-                    if (((masked_word >> j) & 1) == 1) {
-                        remaining--;
-                        if (remaining == 0) {
-                            return i * 64 + j;
-                        }
-                    }
-                }
-            }
-
-            count += word_count;
-        }
-
-        throw std::out_of_range("n exceeds number of 1-bits");
+        return select<true>(n);
     }
 
     void insert(size_t position, bool value) override {
@@ -147,6 +215,9 @@ public:
         } else {
             words[word_index] &= ~(1ull << bit_index);
         }
+
+        // All bits after the position were shifted, so the directory is rebuilt from its superblock on
+        rebuild(position / BITS_PER_SUPERBLOCK);
     }
 
     void remove(size_t position) override {
@@ -164,6 +235,8 @@ public:
         if (num_bits % 64 == 0 && num_bits > 0) {
             words.pop_back();
         }
+
+        rebuild(position / BITS_PER_SUPERBLOCK);
     }
 
     void serialize(char* buffer, size_t* offset) override {
@@ -187,6 +260,10 @@ public:
             memcpy(&words[i], buffer + *offset, sizeof(size_t));
             *offset += sizeof(size_t);
         }
+
+        // The rank directory is not serialized
+        counters.assign(2, 0);
+        rebuild(0);
     }
 
     size_t get_serialized_size() override {
@@ -10,6 +10,8 @@
 #include <unistd.h>
 #include <iostream>
 #include <filesystem>
+#include <cstring>
+#include <stdexcept>
 
 BlockDevice::BlockDevice(const std::string filename, size_t block_size) : block_size(block_size) {
     file = open(filename.c_str(), O_RDWR | O_CREAT, 0644);
@@ -28,11 +30,56 @@ BlockDevice::~BlockDevice() {
 }
 
 void BlockDevice::read_block(size_t block_index, char* buffer) {
-    lseek(file, block_index * block_size, SEEK_SET);
-    read(file, buffer, block_size);
+    BlockDevice::read_blocks(block_index, 1, buffer);
 }
 
 void BlockDevice::write_block(size_t block_index, const char* buffer) {
-    lseek(file, block_index * block_size, SEEK_SET);
-    write(file, buffer, block_size);
-}
\ No newline at end of file
+    BlockDevice::write_blocks(block_index, 1, buffer);
+}
+
+void BlockDevice::read_blocks(size_t block_index, size_t count, char* buffer) {
+    size_t length = count * block_size;
+    size_t done = 0;
+    while (done < length) {
+        ssize_t result = pread(file, buffer + done, length - done, block_index * block_size + done);
+        if (result <= 0) break;
+        done += result;
+    }
+
+    // Blocks behind the end of the file are empty
+    std::memset(buffer + done, 0, length - done);
+}
+
+void BlockDevice::write_blocks(size_t block_index, size_t count, const char* buffer) {
+    size_t length = count * block_size;
+    size_t done = 0;
+    while (done < length) {
+        ssize_t result = pwrite(file, buffer + done, length - done, block_index * block_size + done);
+        if (result <= 0) break;
+        done += result;
+    }
+}
+
+void BlockDevice::flush() {
+    // The size of the file is synchronized as well, as writes may have extended it
+    if (fdatasync(file) != 0) {
+        throw std::runtime_error("Could not synchronize file");
+    }
+}
+
+void BlockDevice::submit(const std::vector<BlockRequest>& requests) {
+    for (const BlockRequest& request : requests) {
+        if (request.count == 1) {
+            // Single blocks go through the block interface so that caching backends keep them
+            if (request.write) {
+                write_block(request.block_index, request.buffer);
+            } else {
+                read_block(request.block_index, request.buffer);
+            }
+        } else if (request.write) {
+            write_blocks(request.block_index, request.count, request.buffer);
+        } else {
+            read_blocks(request.block_index, request.count, request.buffer);
+        }
+    }
+}
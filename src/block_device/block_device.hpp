@@ -8,14 +8,27 @@
 #pragma once
 
 #include <string>
+#include <vector>
+
+/**
+ * A request to read or write a run of consecutive blocks as part of a batch.
+ */
+struct BlockRequest {
+    size_t block_index;
+    size_t count;
+    // Must be count * block_size bytes. Only read from for write requests.
+    char* buffer;
+    bool write;
+};
 
 /**
  * The BlockDevice class simulates a storage device that reads and writes blocks of data.
  * It creates a raw file on the original filesystem to store the data, and provides methods to interact with the data.
  */
 class BlockDevice {
-private:
+protected:
     int file;
+private:
     size_t block_size;
 public:
     /**
@@ -54,4 +67,50 @@ public:
      */
     virtual void write_block(size_t block_index, const char* buffer);
 
+    /**
+     * Reads a run of consecutive blocks into the provided buffer with a single request.
+     * 
+     * @param block_index The index of the first block to read. Blocks that do not exist are read as zeros.
+     * @param count The number of blocks to read.
+     * @param buffer The buffer to write the data into. Must be count * block_size bytes.
+     */
+    virtual void read_blocks(size_t block_index, size_t count, char* buffer);
+
+    /**
+     * Writes a run of consecutive blocks from the provided buffer with a single request.
+     * 
+     * @param block_index The index of the first block to write.
+     * @param count The number of blocks to write.
+     * @param buffer The buffer containing the data. Must be count * block_size bytes.
+     */
+    virtual void write_blocks(size_t block_index, size_t count, const char* buffer);
+
+    /**
+     * Executes a batch of independent requests and returns when all of them are completed.
+     * The requests are executed one after another by default. Backends with asynchronous I/O can have all of them in flight at once.
+     * 
+     * @param requests The requests to execute. Requests must not overlap each other.
+     */
+    virtual void submit(const std::vector<BlockRequest>& requests);
+
+    /**
+     * Gets a pointer to a run of consecutive blocks without copying them, if the device keeps them in memory.
+     * The pointer is only valid until the next write to the device.
+     * 
+     * @param block_index The index of the first block.
+     * @param count The number of blocks that must be accessible through the pointer.
+     * @return A pointer to the first block or nullptr if the blocks cannot be accessed directly.
+     */
+    virtual const char* map_blocks(size_t block_index, size_t count) {
+        return nullptr;
+    }
+
+    /**
+     * Writes all buffered blocks to the file and waits until the storage has persisted them. Blocks are written directly by default, so only the file is synchronized.
+     * Blocks written before a flush are durable before any block written after it.
+     * 
+     * @throws std::runtime_error if the file cannot be synchronized.
+     */
+    virtual void flush();
+
 };
\ No newline at end of file
@@ -0,0 +1,144 @@
+/**
+ * This file is part of the Succinct Filesystem project.
+ *
+ * Copyright (c) 2026 Sebastian Brunnert <mail@sebastianbrunnert.de>
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "cached_block_device.hpp"
+#include <algorithm>
+#include <cstring>
+
+CachedBlockDevice::CachedBlockDevice(const std::string filename, size_t capacity, size_t block_size)
+    : BlockDevice(filename, block_size), capacity(capacity), frames(capacity), data(capacity * block_size) {
+    frame_index.reserve(capacity);
+}
+
+CachedBlockDevice::~CachedBlockDevice() {
+    flush();
+}
+
+size_t CachedBlockDevice::evict(size_t block_index) {
+    while (true) {
+        size_t frame = clock_hand;
+        clock_hand = (clock_hand + 1) % capacity;
+
+        Frame& current = frames[frame];
+        if (current.valid && current.referenced) {
+            // Give recently used blocks a second chance
+            current.referenced = false;
+            continue;
+        }
+
+        if (current.valid) {
+            if (current.dirty) {
+                BlockDevice::write_block(current.block_index, frame_data(frame));
+            }
+            frame_index.erase(current.block_index);
+        }
+
+        current = Frame{block_index, true, false, true};
+        frame_index[block_index] = frame;
+        return frame;
+    }
+}
+
+void CachedBlockDevice::read_block(size_t block_index, char* buffer) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t block_size = get_block_size();
+
+    auto it = frame_index.find(block_index);
+    if (it != frame_index.end()) {
+        hits++;
+        frames[it->second].referenced = true;
+        std::memcpy(buffer, frame_data(it->second), block_size);
+        return;
+    }
+
+    misses++;
+    size_t frame = evict(block_index);
+    BlockDevice::read_block(block_index, frame_data(frame));
+    std::memcpy(buffer, frame_data(frame), block_size);
+}
+
+void CachedBlockDevice::write_block(size_t block_index, const char* buffer) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = frame_index.find(block_index);
+    size_t frame;
+    if (it != frame_index.end()) {
+        hits++;
+        frame = it->second;
+        frames[frame].referenced = true;
+    } else {
+        // The whole block is overwritten, so it does not have to be read first
+        misses++;
+        frame = evict(block_index);
+    }
+
+    std::memcpy(frame_data(frame), buffer, get_block_size());
+    frames[frame].dirty = true;
+}
+
+void CachedBlockDevice::read_blocks(size_t block_index, size_t count, char* buffer) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t block_size = get_block_size();
+
+    // Read the uncached parts of the run with one request each
+    size_t run_start = block_index;
+    for (size_t i = block_index; i <= block_index + count; i++) {
+        auto it = (i < block_index + count) ? frame_index.find(i) : frame_index.end();
+        if (i < block_index + count && it == frame_index.end()) {
+            misses++;
+            continue;
+        }
+
+        if (run_start < i) {
+            BlockDevice::read_blocks(run_start, i - run_start, buffer + (run_start - block_index) * block_size);
+        }
+        if (it != frame_index.end()) {
+            hits++;
+            frames[it->second].referenced = true;
+            std::memcpy(buffer + (i - block_index) * block_size, frame_data(it->second), block_size);
+        }
+        run_start = i + 1;
+    }
+}
+
+void CachedBlockDevice::write_blocks(size_t block_index, size_t count, const char* buffer) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t block_size = get_block_size();
+
+    BlockDevice::write_blocks(block_index, count, buffer);
+    for (size_t i = 0; i < count; i++) {
+        auto it = frame_index.find(block_index + i);
+        if (it != frame_index.end()) {
+            hits++;
+            std::memcpy(frame_data(it->second), buffer + i * block_size, block_size);
+            frames[it->second].dirty = false;
+        } else {
+            misses++;
+        }
+    }
+}
+
+void CachedBlockDevice::flush() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Write the dirty blocks in ascending order to keep the writes sequential
+    std::vector<size_t> dirty_frames;
+    for (size_t frame = 0; frame < capacity; frame++) {
+        if (frames[frame].valid && frames[frame].dirty) {
+            dirty_frames.push_back(frame);
+        }
+    }
+    std::sort(dirty_frames.begin(), dirty_frames.end(), [this](size_t a, size_t b) {
+        return frames[a].block_index < frames[b].block_index;
+    });
+
+    for (size_t frame : dirty_frames) {
+        BlockDevice::write_block(frames[frame].block_index, frame_data(frame));
+        frames[frame].dirty = false;
+    }
+    BlockDevice::flush();
+}
@@ -0,0 +1,104 @@
+/**
+ * This file is part of the Succinct Filesystem project.
+ *
+ * Copyright (c) 2026 Sebastian Brunnert <mail@sebastianbrunnert.de>
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "block_device.hpp"
+
+// Default number of blocks held by the block cache (0 disables the cache)
+#ifndef BLOCK_CACHE_BLOCKS
+#define BLOCK_CACHE_BLOCKS 1024
+#endif
+
+/**
+ * A block device with an in-process write-back cache in front of the file.
+ * Blocks are evicted with the CLOCK algorithm. Written blocks are only marked as dirty and are written to the file when they are evicted or the cache is flushed.
+ * Runs of blocks bypass the cache, only blocks that are already cached are kept consistent.
+ */
+class CachedBlockDevice : public BlockDevice {
+private:
+    struct Frame {
+        size_t block_index = 0;
+        bool valid = false;
+        bool dirty = false;
+        bool referenced = false;
+    };
+
+    size_t capacity;
+    std::vector<Frame> frames;
+    // Data of all frames, block_size bytes per frame
+    std::vector<char> data;
+    // Maps block indices to the frame that holds them
+    std::unordered_map<size_t, size_t> frame_index;
+    size_t clock_hand = 0;
+
+    size_t hits = 0;
+    size_t misses = 0;
+
+    std::mutex mutex;
+
+    /**
+     * Finds a frame for a new block, writing back the evicted block if it is dirty.
+     *
+     * @param block_index The index of the block that will be stored in the frame.
+     * @return The index of the frame.
+     */
+    size_t evict(size_t block_index);
+
+    char* frame_data(size_t frame) {
+        return data.data() + frame * get_block_size();
+    }
+
+public:
+    /**
+     * @param filename The path to the file that will be used to store the data. If the file does not exist, it will be created.
+     * @param capacity The number of blocks the cache can hold. Must be greater than zero.
+     * @param block_size The size of each block in bytes. Typically 4096 bytes.
+     * @throws std::runtime_error if the file cannot be opened or created.
+     */
+    CachedBlockDevice(const std::string filename, size_t capacity = BLOCK_CACHE_BLOCKS, size_t block_size = 4096);
+
+    /**
+     * Flushes all dirty blocks before closing the file.
+     */
+    ~CachedBlockDevice() override;
+
+    void read_block(size_t block_index, char* buffer) override;
+    void write_block(size_t block_index, const char* buffer) override;
+
+    /**
+     * Reads a run of blocks. Cached blocks are copied from the cache, the others are read directly from the file without being cached, so large sequential reads do not evict the working set.
+     */
+    void read_blocks(size_t block_index, size_t count, char* buffer) override;
+
+    /**
+     * Writes a run of blocks directly to the file. Cached copies of the blocks are updated and become clean.
+     */
+    void write_blocks(size_t block_index, size_t count, const char* buffer) override;
+
+    /**
+     * Writes all dirty blocks to the file and synchronizes it.
+     */
+    void flush() override;
+
+    /**
+     * @return The number of block reads and writes that were served from the cache.
+     */
+    size_t get_hits() const {
+        return hits;
+    }
+
+    /**
+     * @return The number of block reads and writes that were not in the cache.
+     */
+    size_t get_misses() const {
+        return misses;
+    }
+};
@@ -0,0 +1,288 @@
+/**
+ * This file is part of the Succinct Filesystem project.
+ *
+ * Copyright (c) 2026 Sebastian Brunnert <mail@sebastianbrunnert.de>
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "io_uring_block_device.hpp"
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+
+IoUringBlockDevice::IoUringBlockDevice(const std::string filename, bool direct, size_t queue_depth, size_t block_size)
+    : BlockDevice(filename, block_size), queue_depth(queue_depth), buffer_size(block_size * IO_URING_BUFFER_BLOCKS) {
+    ring_file = open(filename.c_str(), O_RDWR | (direct ? O_DIRECT : 0));
+    if (ring_file == -1) {
+        throw std::runtime_error("Could not open file for io_uring");
+    }
+
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    ring = syscall(__NR_io_uring_setup, queue_depth, &params);
+    if (ring < 0) {
+        close_ring();
+        throw std::runtime_error("Could not set up io_uring");
+    }
+
+    // Map the submission and completion rings, which share one mapping on newer kernels
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+    }
+    sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+    if (sq_ring == MAP_FAILED) {
+        sq_ring = nullptr;
+        close_ring();
+        throw std::runtime_error("Could not map io_uring submission queue");
+    }
+    if (single_mmap) {
+        cq_ring = sq_ring;
+    } else {
+        cq_ring = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+        if (cq_ring == MAP_FAILED) {
+            cq_ring = nullptr;
+            close_ring();
+            throw std::runtime_error("Could not map io_uring completion queue");
+        }
+    }
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes_mapping = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+    if (sqes_mapping == MAP_FAILED) {
+        close_ring();
+        throw std::runtime_error("Could not map io_uring submission queue entries");
+    }
+    sqes = static_cast<io_uring_sqe*>(sqes_mapping);
+
+    char* sq = static_cast<char*>(sq_ring);
+    sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    char* cq = static_cast<char*>(cq_ring);
+    cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    // The file is used as fixed file 0, so the kernel does not have to look it up for every request
+    if (syscall(__NR_io_uring_register, ring, IORING_REGISTER_FILES, &ring_file, 1) < 0) {
+        close_ring();
+        throw std::runtime_error("Could not register file with io_uring");
+    }
+
+    // Aligned buffers satisfy the alignment requirements of O_DIRECT
+    void* allocation;
+    if (posix_memalign(&allocation, 4096, queue_depth * buffer_size) != 0) {
+        close_ring();
+        throw std::runtime_error("Could not allocate io_uring buffers");
+    }
+    buffers = static_cast<char*>(allocation);
+
+    std::vector<iovec> iovecs(queue_depth);
+    for (size_t i = 0; i < queue_depth; i++) {
+        iovecs[i].iov_base = buffers + i * buffer_size;
+        iovecs[i].iov_len = buffer_size;
+        free_buffers.push_back(queue_depth - 1 - i);
+    }
+    if (syscall(__NR_io_uring_register, ring, IORING_REGISTER_BUFFERS, iovecs.data(), queue_depth) < 0) {
+        close_ring();
+        throw std::runtime_error("Could not register buffers with io_uring");
+    }
+}
+
+IoUringBlockDevice::~IoUringBlockDevice() {
+    close_ring();
+}
+
+void IoUringBlockDevice::close_ring() {
+    if (sqes != nullptr) munmap(sqes, sqes_size);
+    if (cq_ring != nullptr && cq_ring != sq_ring) munmap(cq_ring, cq_ring_size);
+    if (sq_ring != nullptr) munmap(sq_ring, sq_ring_size);
+    if (ring >= 0) close(ring);
+    if (ring_file >= 0) close(ring_file);
+    free(buffers);
+
+    sqes = nullptr;
+    cq_ring = sq_ring = nullptr;
+    ring = ring_file = -1;
+    buffers = nullptr;
+}
+
+void IoUringBlockDevice::read_block(size_t block_index, char* buffer) {
+    submit({{block_index, 1, buffer, false}});
+}
+
+void IoUringBlockDevice::write_block(size_t block_index, const char* buffer) {
+    submit({{block_index, 1, const_cast<char*>(buffer), true}});
+}
+
+void IoUringBlockDevice::read_blocks(size_t block_index, size_t count, char* buffer) {
+    submit({{block_index, count, buffer, false}});
+}
+
+void IoUringBlockDevice::write_blocks(size_t block_index, size_t count, const char* buffer) {
+    submit({{block_index, count, const_cast<char*>(buffer), true}});
+}
+
+void IoUringBlockDevice::submit(const std::vector<BlockRequest>& requests) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t block_size = get_block_size();
+
+    // Requests are split into chunks that fit into one registered buffer
+    struct Chunk {
+        size_t block_index;
+        size_t length;
+        char* buffer;
+        bool write;
+        size_t done;
+        unsigned buffer_index;
+    };
+    std::vector<Chunk> chunks;
+    for (const BlockRequest& request : requests) {
+        for (size_t i = 0; i < request.count; i += IO_URING_BUFFER_BLOCKS) {
+            size_t count = std::min<size_t>(IO_URING_BUFFER_BLOCKS, request.count - i);
+            chunks.push_back({request.block_index + i, count * block_size, request.buffer + i * block_size, request.write, 0, 0});
+        }
+    }
+
+    std::deque<size_t> pending;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        pending.push_back(i);
+    }
+    size_t in_flight = 0;
+    unsigned to_submit = 0;
+    bool failed = false;
+
+    auto queue = [&](size_t index) {
+        Chunk& chunk = chunks[index];
+        unsigned tail = *sq_tail;
+        unsigned slot = tail & *sq_mask;
+        io_uring_sqe* sqe = &sqes[slot];
+        std::memset(sqe, 0, sizeof(io_uring_sqe));
+        sqe->opcode = chunk.write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+        sqe->flags = IOSQE_FIXED_FILE;
+        sqe->fd = 0;
+        sqe->off = chunk.block_index * block_size + chunk.done;
+        sqe->addr = reinterpret_cast<uint64_t>(buffers + chunk.buffer_index * buffer_size + chunk.done);
+        sqe->len = chunk.length - chunk.done;
+        sqe->buf_index = chunk.buffer_index;
+        sqe->user_data = index;
+        sq_array[slot] = slot;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+        to_submit++;
+        in_flight++;
+    };
+
+    while ((!pending.empty() && !failed) || in_flight > 0) {
+        // Fill the queue with new chunks as long as there are free buffers
+        while (!pending.empty() && !failed && !free_buffers.empty()) {
+            Chunk& chunk = chunks[pending.front()];
+            chunk.buffer_index = free_buffers.back();
+            free_buffers.pop_back();
+            if (chunk.write) {
+                std::memcpy(buffers + chunk.buffer_index * buffer_size, chunk.buffer, chunk.length);
+            }
+            queue(pending.front());
+            pending.pop_front();
+        }
+
+        int result = syscall(__NR_io_uring_enter, ring, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            // Requests that are in flight still use the buffers, so the ring cannot be used any more
+            close_ring();
+            throw std::runtime_error("Could not submit requests to io_uring");
+        }
+        to_submit -= result;
+
+        unsigned head = *cq_head;
+        while (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+            io_uring_cqe* cqe = &cqes[head & *cq_mask];
+            head++;
+            in_flight--;
+
+            size_t index = cqe->user_data;
+            Chunk& chunk = chunks[index];
+            char* data = buffers + chunk.buffer_index * buffer_size;
+            if (cqe->res == -EINTR || cqe->res == -EAGAIN) {
+                queue(index);
+                continue;
+            }
+            if (cqe->res < 0 || (cqe->res == 0 && chunk.write)) {
+                failed = true;
+                free_buffers.push_back(chunk.buffer_index);
+                continue;
+            }
+
+            if (cqe->res == 0) {
+                // Blocks behind the end of the file are empty
+                std::memset(data + chunk.done, 0, chunk.length - chunk.done);
+                chunk.done = chunk.length;
+            } else {
+                chunk.done += cqe->res;
+            }
+
+            if (chunk.done < chunk.length) {
+                // Short transfer, request the remaining part
+                queue(index);
+                continue;
+            }
+            if (!chunk.write) {
+                std::memcpy(chunk.buffer, data, chunk.length);
+            }
+            free_buffers.push_back(chunk.buffer_index);
+        }
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    if (failed) {
+        throw std::runtime_error("io_uring request failed");
+    }
+}
+
+void IoUringBlockDevice::flush() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ring < 0) {
+        throw std::runtime_error("io_uring is not available");
+    }
+
+    unsigned tail = *sq_tail;
+    unsigned slot = tail & *sq_mask;
+    io_uring_sqe* sqe = &sqes[slot];
+    std::memset(sqe, 0, sizeof(io_uring_sqe));
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->fd = 0;
+    sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+    sq_array[slot] = slot;
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    unsigned to_submit = 1;
+    unsigned head = *cq_head;
+    while (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+        int result = syscall(__NR_io_uring_enter, ring, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            close_ring();
+            throw std::runtime_error("Could not submit requests to io_uring");
+        }
+        to_submit -= result;
+    }
+
+    int res = cqes[head & *cq_mask].res;
+    __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+    if (res < 0) {
+        throw std::runtime_error("Could not synchronize file through io_uring");
+    }
+}
@@ -0,0 +1,96 @@
+/**
+ * This file is part of the Succinct Filesystem project.
+ *
+ * Copyright (c) 2026 Sebastian Brunnert <mail@sebastianbrunnert.de>
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <mutex>
+#include <vector>
+#include "block_device.hpp"
+
+// Default number of requests that are in flight at the same time
+#ifndef IO_URING_QUEUE_DEPTH
+#define IO_URING_QUEUE_DEPTH 32
+#endif
+
+// Number of blocks per registered buffer. Larger runs are split into several requests.
+#ifndef IO_URING_BUFFER_BLOCKS
+#define IO_URING_BUFFER_BLOCKS 32
+#endif
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/**
+ * A block device that performs its I/O through an io_uring instance.
+ * The file is registered with the ring and all data goes through registered, block aligned buffers, so the file can optionally be opened with O_DIRECT to bypass the page cache.
+ * Batches of requests are kept in flight together up to the queue depth, which lets the device work on independent runs in parallel.
+ */
+class IoUringBlockDevice : public BlockDevice {
+private:
+    int ring = -1;
+    // File descriptor registered with the ring as fixed file 0
+    int ring_file = -1;
+    unsigned queue_depth;
+    size_t buffer_size;
+
+    // Registered buffers, buffer_size bytes each
+    char* buffers = nullptr;
+    std::vector<unsigned> free_buffers;
+
+    void* sq_ring = nullptr;
+    size_t sq_ring_size = 0;
+    void* cq_ring = nullptr;
+    size_t cq_ring_size = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqes_size = 0;
+
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    io_uring_cqe* cqes;
+
+    std::mutex mutex;
+
+    /**
+     * Releases the ring, the buffers and the registered file.
+     */
+    void close_ring();
+
+public:
+    /**
+     * @param filename The path to the file that will be used to store the data. If the file does not exist, it will be created.
+     * @param direct Whether the file is opened with O_DIRECT.
+     * @param queue_depth The number of requests that can be in flight at the same time.
+     * @param block_size The size of each block in bytes. Typically 4096 bytes. Must be a multiple of the logical block size of the underlying device if direct is set.
+     * @throws std::runtime_error if the file cannot be opened or the ring cannot be set up.
+     */
+    IoUringBlockDevice(const std::string filename, bool direct = false, size_t queue_depth = IO_URING_QUEUE_DEPTH, size_t block_size = 4096);
+
+    ~IoUringBlockDevice() override;
+
+    void read_block(size_t block_index, char* buffer) override;
+    void write_block(size_t block_index, const char* buffer) override;
+    void read_blocks(size_t block_index, size_t count, char* buffer) override;
+    void write_blocks(size_t block_index, size_t count, const char* buffer) override;
+
+    /**
+     * Splits the requests into chunks of at most IO_URING_BUFFER_BLOCKS blocks and keeps up to queue_depth of them in flight until all are completed.
+     *
+     * @throws std::runtime_error if a request fails.
+     */
+    void submit(const std::vector<BlockRequest>& requests) override;
+
+    /**
+     * Synchronizes the file through the ring. Writes are only submitted by submit, which waits for their completion, so all of them are covered.
+     *
+     * @throws std::runtime_error if the file cannot be synchronized.
+     */
+    void flush() override;
+};
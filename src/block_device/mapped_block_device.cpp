@@ -0,0 +1,132 @@
+/**
+ * This file is part of the Succinct Filesystem project.
+ *
+ * Copyright (c) 2026 Sebastian Brunnert <mail@sebastianbrunnert.de>
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "mapped_block_device.hpp"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+MappedBlockDevice::MappedBlockDevice(const std::string filename, size_t block_size) : BlockDevice(filename, block_size) {
+    // Reserve the address space up front, so the mapping never has to move when it grows
+    void* reservation = mmap(nullptr, MAPPED_RESERVATION_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (reservation == MAP_FAILED) {
+        throw std::runtime_error("Could not reserve address space for mapping");
+    }
+    mapping = static_cast<char*>(reservation);
+
+    size_t size = lseek(file, 0, SEEK_END);
+    try {
+        map_range(0, size);
+    } catch (...) {
+        munmap(mapping, MAPPED_RESERVATION_SIZE);
+        throw;
+    }
+}
+
+MappedBlockDevice::~MappedBlockDevice() {
+    flush();
+    munmap(mapping, MAPPED_RESERVATION_SIZE);
+}
+
+void MappedBlockDevice::map_range(size_t begin, size_t end) {
+    if (end > MAPPED_RESERVATION_SIZE) {
+        throw std::runtime_error("File does not fit into the reserved address space");
+    }
+    // mmap requires a page aligned offset, remapping the start of the page again is harmless
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    begin = begin / page_size * page_size;
+    void* result = mmap(mapping + begin, end - begin, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, file, begin);
+    if (result == MAP_FAILED) {
+        throw std::runtime_error("Could not map file");
+    }
+    mapping_size = end;
+}
+
+void MappedBlockDevice::grow(size_t size) {
+    size_t block_size = get_block_size();
+    size_t new_size = std::max(size, mapping_size * 2);
+    new_size = (new_size + block_size - 1) / block_size * block_size;
+    new_size = std::min<size_t>(std::max(new_size, size), MAPPED_RESERVATION_SIZE);
+
+    if (ftruncate(file, new_size) != 0) {
+        throw std::runtime_error("Could not grow file");
+    }
+    map_range(mapping_size, new_size);
+}
+
+void MappedBlockDevice::mark_dirty(size_t begin, size_t end) {
+    auto it = dirty.upper_bound(begin);
+    if (it != dirty.begin() && std::prev(it)->second >= begin) {
+        it--;
+        begin = it->first;
+        end = std::max(end, it->second);
+        it = dirty.erase(it);
+    }
+    while (it != dirty.end() && it->first <= end) {
+        end = std::max(end, it->second);
+        it = dirty.erase(it);
+    }
+    dirty[begin] = end;
+}
+
+void MappedBlockDevice::read_block(size_t block_index, char* buffer) {
+    read_blocks(block_index, 1, buffer);
+}
+
+void MappedBlockDevice::write_block(size_t block_index, const char* buffer) {
+    write_blocks(block_index, 1, buffer);
+}
+
+void MappedBlockDevice::read_blocks(size_t block_index, size_t count, char* buffer) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t block_size = get_block_size();
+    size_t start = block_index * block_size;
+    size_t length = count * block_size;
+
+    size_t available = start < mapping_size ? std::min(length, mapping_size - start) : 0;
+    std::memcpy(buffer, mapping + start, available);
+    // Blocks behind the end of the file are empty
+    std::memset(buffer + available, 0, length - available);
+}
+
+void MappedBlockDevice::write_blocks(size_t block_index, size_t count, const char* buffer) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t block_size = get_block_size();
+    size_t end = (block_index + count) * block_size;
+
+    if (end > mapping_size) {
+        grow(end);
+    }
+    std::memcpy(mapping + block_index * block_size, buffer, count * block_size);
+    mark_dirty(block_index, block_index + count);
+}
+
+void MappedBlockDevice::flush() {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t block_size = get_block_size();
+    size_t page_size = sysconf(_SC_PAGESIZE);
+
+    for (const auto& [begin, end] : dirty) {
+        // msync requires a page aligned address
+        size_t start = begin * block_size / page_size * page_size;
+        msync(mapping + start, end * block_size - start, MS_SYNC);
+    }
+    dirty.clear();
+    // Growing the mapping extended the file, which msync does not persist
+    BlockDevice::flush();
+}
+
+const char* MappedBlockDevice::map_blocks(size_t block_index, size_t count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t block_size = get_block_size();
+    if ((block_index + count) * block_size > mapping_size) {
+        return nullptr;
+    }
+    return mapping + block_index * block_size;
+}
@@ -0,0 +1,75 @@
+/**
+ * This file is part of the Succinct Filesystem project.
+ *
+ * Copyright (c) 2026 Sebastian Brunnert <mail@sebastianbrunnert.de>
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <map>
+#include <mutex>
+#include "block_device.hpp"
+
+// Address space reserved for the mapping. The file cannot grow beyond this size.
+#ifndef MAPPED_RESERVATION_SIZE
+#define MAPPED_RESERVATION_SIZE (1ULL << 40)
+#endif
+
+/**
+ * A block device that maps the whole file into memory, so reads and writes are plain memory copies instead of system calls.
+ * The file and the mapping grow geometrically when blocks behind the end are written. The mapping is placed in a reserved range of address space, so growing never moves it. Written blocks are tracked and only their ranges are synchronized with msync on flush.
+ * Blocks can be accessed without copying through map_blocks.
+ */
+class MappedBlockDevice : public BlockDevice {
+private:
+    char* mapping = nullptr;
+    size_t mapping_size = 0;
+    // Runs of written blocks that have not been synchronized yet, as first block -> block after the run
+    std::map<size_t, size_t> dirty;
+
+    std::mutex mutex;
+
+    /**
+     * Maps the bytes in [begin, end) of the file into the reserved range.
+     */
+    void map_range(size_t begin, size_t end);
+
+    /**
+     * Grows the file and the mapping so that it holds at least the given number of bytes.
+     */
+    void grow(size_t size);
+
+    /**
+     * Marks the blocks in [begin, end) as written, merging them with adjacent runs.
+     */
+    void mark_dirty(size_t begin, size_t end);
+
+public:
+    /**
+     * @param filename The path to the file that will be used to store the data. If the file does not exist, it will be created.
+     * @param block_size The size of each block in bytes. Typically 4096 bytes.
+     * @throws std::runtime_error if the file cannot be opened, created or mapped.
+     */
+    MappedBlockDevice(const std::string filename, size_t block_size = 4096);
+
+    /**
+     * Synchronizes all written blocks before unmapping the file.
+     */
+    ~MappedBlockDevice() override;
+
+    void read_block(size_t block_index, char* buffer) override;
+    void write_block(size_t block_index, const char* buffer) override;
+    void read_blocks(size_t block_index, size_t count, char* buffer) override;
+    void write_blocks(size_t block_index, size_t count, const char* buffer) override;
+
+    /**
+     * Synchronizes the ranges of all written blocks and the size of the file.
+     */
+    void flush() override;
+
+    /**
+     * The pointer points into the mapping and stays valid while the device exists, also when a write grows the mapping.
+     */
+    const char* map_blocks(size_t block_index, size_t count) override;
+};
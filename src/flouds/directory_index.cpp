@@ -0,0 +1,127 @@
+/**
+ * This file is part of the Succinct Filesystem project.
+ *
+ * Copyright (c) 2026 Sebastian Brunnert <mail@sebastianbrunnert.de>
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "directory_index.hpp"
+
+DirectoryIndex::DirectoryIndex(size_t capacity) {
+    slots.reserve(capacity);
+    tree.reserve(capacity + 1);
+    tree.push_back(0);
+}
+
+size_t DirectoryIndex::rank(size_t slot) const {
+    size_t count = 0;
+    for (size_t i = slot; i > 0; i -= i & -i) {
+        count += tree[i];
+    }
+    return count;
+}
+
+void DirectoryIndex::append(std::string_view name) {
+    // The new slot covers the range (slot - lowbit(slot), slot], which consists of the used slots in it and the new one
+    size_t slot = tree.size();
+    tree.push_back(rank(slot - 1) - rank(slot - (slot & -slot)) + 1);
+    slots.emplace(hash(name), slot);
+    children++;
+}
+
+void DirectoryIndex::remove(size_t index, std::string_view name) {
+    // Only the children with the same hash have to be compared
+    auto [begin, end] = slots.equal_range(hash(name));
+    for (auto it = begin; it != end; it++) {
+        if (rank(it->second - 1) == index) {
+            for (size_t i = it->second; i < tree.size(); i += i & -i) {
+                tree[i]--;
+            }
+            slots.erase(it);
+            children--;
+            return;
+        }
+    }
+}
+
+std::optional<size_t> DirectoryIndex::find(std::string_view name, const std::function<bool(size_t)>& matches) const {
+    auto [begin, end] = slots.equal_range(hash(name));
+    for (auto it = begin; it != end; it++) {
+        size_t index = rank(it->second - 1);
+        if (matches(index)) {
+            return index;
+        }
+    }
+    return std::nullopt;
+}
+
+size_t DirectoryIndexMap::node(size_t entry) const {
+    int64_t shift = 0;
+    for (size_t i = entry + 1; i > 0; i -= i & -i) {
+        shift += shifts[i];
+    }
+    return nodes[entry] + shift;
+}
+
+size_t DirectoryIndexMap::lower_bound(size_t node) const {
+    // The entries stay in the order of their node indexes
+    size_t low = 0;
+    size_t high = nodes.size();
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        if (this->node(middle) < node) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+void DirectoryIndexMap::apply_shifts() {
+    for (size_t entry = 0; entry < nodes.size(); entry++) {
+        nodes[entry] = node(entry);
+    }
+    shifts.assign(nodes.size() + 1, 0);
+}
+
+DirectoryIndex* DirectoryIndexMap::find(size_t node) const {
+    size_t entry = lower_bound(node);
+    if (entry == nodes.size() || this->node(entry) != node) {
+        return nullptr;
+    }
+    return indexes[entry].get();
+}
+
+DirectoryIndex* DirectoryIndexMap::insert(size_t node, std::unique_ptr<DirectoryIndex> index) {
+    apply_shifts();
+    size_t entry = lower_bound(node);
+    nodes.insert(nodes.begin() + entry, node);
+    indexes.insert(indexes.begin() + entry, std::move(index));
+    shifts.push_back(0);
+    return indexes[entry].get();
+}
+
+void DirectoryIndexMap::erase(size_t node) {
+    size_t entry = lower_bound(node);
+    if (entry == nodes.size() || this->node(entry) != node) {
+        return;
+    }
+    apply_shifts();
+    nodes.erase(nodes.begin() + entry);
+    indexes.erase(indexes.begin() + entry);
+    shifts.pop_back();
+}
+
+void DirectoryIndexMap::shift(size_t from, bool increment) {
+    size_t entry = lower_bound(from);
+    for (size_t i = entry + 1; i < shifts.size(); i += i & -i) {
+        shifts[i] += increment ? 1 : -1;
+    }
+}
+
+void DirectoryIndexMap::clear() {
+    nodes.clear();
+    shifts.clear();
+    indexes.clear();
+}
@@ -0,0 +1,156 @@
+/**
+ * This file is part of the Succinct Filesystem project.
+ *
+ * Copyright (c) 2026 Sebastian Brunnert <mail@sebastianbrunnert.de>
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * This class implements the name index of a large folder, which maps the names of its children to their 0-based index within the folder.
+ * Children are only appended, but they are removed from anywhere, which shifts the index of all following children. Each child therefore gets a slot in the order of the children that never changes.
+ * A Fenwick tree counts the used slots, so the index of a child is the number of used slots in front of its slot, which is computed in O(log n). Inserts and removes take O(log n) as well.
+ * Removed children leave an unused slot behind, so the index should be built again once most slots are unused (see is_sparse).
+ */
+class DirectoryIndex {
+private:
+    // Slots of the children by the hash of their names. Different names can share a hash.
+    std::unordered_multimap<size_t, size_t> slots;
+    // Fenwick tree over the slots (1-based), a used slot counts 1
+    std::vector<size_t> tree;
+    size_t children = 0;
+
+    /**
+     * @return The number of used slots in front of the slot.
+     */
+    size_t rank(size_t slot) const;
+
+    static size_t hash(std::string_view name) {
+        return std::hash<std::string_view>{}(name);
+    }
+
+public:
+    /**
+     * @param capacity The expected number of children.
+     */
+    DirectoryIndex(size_t capacity = 0);
+
+    /**
+     * Adds a child behind all other children of the folder.
+     *
+     * @param name The name of the child.
+     */
+    void append(std::string_view name);
+
+    /**
+     * Removes a child from the folder. The index of all following children decreases by one.
+     *
+     * @param index The 0-based index of the child within the folder.
+     * @param name The name of the child.
+     */
+    void remove(size_t index, std::string_view name);
+
+    /**
+     * Finds the child with the given name.
+     *
+     * @param name The name of the child.
+     * @param matches Checks whether the child at the given 0-based index has the name, as children with different names can share a hash.
+     * @return The 0-based index of the child or nothing if the folder has no child with the name.
+     */
+    std::optional<size_t> find(std::string_view name, const std::function<bool(size_t)>& matches) const;
+
+    /**
+     * @return The number of children in the index.
+     */
+    size_t size() const {
+        return children;
+    }
+
+    /**
+     * @return true if more than half of the slots are unused, so building the index again saves memory and time.
+     */
+    bool is_sparse() const {
+        return tree.size() > 2 * children + 1;
+    }
+};
+
+/**
+ * This class keeps the name indexes of the folders by the node indexes of the folders, which shift by one with every insert and remove in front of them.
+ * The indexes are kept in the order of their folders, which never changes. The node index of an entry is its node index when it was added plus the shifts since then, which are stored in a Fenwick tree over the entries.
+ * So moving all entries behind a position takes O(log^2 k) for k indexed folders, adding and erasing entries takes O(k), which only happens when large folders are looked up for the first time or are removed.
+ */
+class DirectoryIndexMap {
+private:
+    std::vector<size_t> nodes;
+    // Fenwick tree over the entries (1-based). A shift of all entries from an entry on is added at that entry.
+    std::vector<int64_t> shifts;
+    std::vector<std::unique_ptr<DirectoryIndex>> indexes;
+
+    /**
+     * @return The current node index of the entry.
+     */
+    size_t node(size_t entry) const;
+
+    /**
+     * @return The first entry whose node index is at least the given one.
+     */
+    size_t lower_bound(size_t node) const;
+
+    /**
+     * Adds all shifts to the node indexes and clears the Fenwick tree, so entries can be added or erased.
+     */
+    void apply_shifts();
+
+public:
+    /**
+     * @param node The node index of the folder.
+     * @return The name index of the folder or nullptr if it has none.
+     */
+    DirectoryIndex* find(size_t node) const;
+
+    /**
+     * Adds the name index of a folder.
+     *
+     * @param node The node index of the folder. Must not have a name index yet.
+     * @param index The name index.
+     * @return The added name index.
+     */
+    DirectoryIndex* insert(size_t node, std::unique_ptr<DirectoryIndex> index);
+
+    /**
+     * Removes the name index of a folder if it has one.
+     *
+     * @param node The node index of the folder.
+     */
+    void erase(size_t node);
+
+    /**
+     * Moves the name indexes of all folders with a node index of at least from by one position, as the node indexes shift after an insert or remove.
+     *
+     * @param from The first node index whose name index is moved.
+     * @param increment true to move the name indexes to the next node index, false to move them to the previous one.
+     */
+    void shift(size_t from, bool increment);
+
+    /**
+     * Removes all name indexes.
+     */
+    void clear();
+
+    /**
+     * @return The number of folders with a name index.
+     */
+    size_t size() const {
+        return indexes.size();
+    }
+};
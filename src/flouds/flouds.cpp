@@ -5,17 +5,18 @@
  * SPDX-License-Identifier: GPL-2.0-only
  */
 
+#include <vector>
 #include "flouds.hpp"
 
 Flouds* create_flouds() {
-    BitVector* bv = create_bitvector<WordBitVectorStrategy>(1);
+    BitVector* bv = create_bitvector<FloudsBitVectorStrategy>(1);
     bv->set(0, true);
 
     uint8_t* data = new uint8_t[1];
     data[0] = 2;
-    TwoBitWaveletTree<WordBitVectorStrategy>* wt = create_two_bit_wavelet_tree<WordBitVectorStrategy>(data, 1);
+    TwoBitWaveletTree<FloudsBitVectorStrategy>* wt = create_two_bit_wavelet_tree<FloudsBitVectorStrategy>(data, 1);
 
-    NameSequence* ns = create_name_sequence<ImmerNameSequenceStrategy>();
+    NameSequence* ns = create_name_sequence<FloudsNameSequenceStrategy>();
     ns->insert(0, "root");
 
     return new Flouds(bv, wt, ns);
@@ -61,8 +62,56 @@ size_t Flouds::child(size_t node_id, size_t child_index) {
     return structure->select1(folder_index) + child_index;
 }
 
-std::string Flouds::get_name(size_t node_id) {
-    return names->access(node_id);
+size_t Flouds::find_child(size_t node_id, std::string_view name) {
+    size_t children_count = this->children_count(node_id);
+    if (children_count == 0) {
+        throw std::out_of_range("child does not exist");
+    }
+    size_t first_child = this->child(node_id, 0);
+
+    if (children_count < DIRECTORY_INDEX_THRESHOLD) {
+        for (size_t i = first_child; i < first_child + children_count; i++) {
+            if (names->view(i) == name) {
+                return i;
+            }
+        }
+        throw std::out_of_range("child does not exist");
+    }
+
+    // Different names can share a hash, so the candidates are compared with the name
+    auto search = [&](const DirectoryIndex* index) {
+        auto found = index->find(name, [&](size_t child_index) {
+            return names->view(first_child + child_index) == name;
+        });
+        if (!found.has_value()) {
+            throw std::out_of_range("child does not exist");
+        }
+        return first_child + *found;
+    };
+
+    {
+        std::shared_lock<std::shared_mutex> lock(directory_index_mutex);
+        DirectoryIndex* index = directory_indexes.find(node_id);
+        if (index != nullptr) {
+            return search(index);
+        }
+    }
+
+    // Build the name index of the folder on its first lookup, unless another lookup was faster
+    std::unique_lock<std::shared_mutex> lock(directory_index_mutex);
+    DirectoryIndex* index = directory_indexes.find(node_id);
+    if (index == nullptr) {
+        auto built = std::make_unique<DirectoryIndex>(children_count);
+        for (size_t i = 0; i < children_count; i++) {
+            built->append(names->view(first_child + i));
+        }
+        index = directory_indexes.insert(node_id, std::move(built));
+    }
+    return search(index);
+}
+
+std::string_view Flouds::get_name(size_t node_id) {
+    return names->view(node_id);
 }
 
 bool Flouds::is_folder(size_t node_id) {
@@ -81,6 +130,7 @@ bool Flouds::is_empty_folder(size_t node_id) {
 }
 
 size_t Flouds::insert(size_t parent_id, const std::string& name, bool is_folder) {
+    version++;
     bool was_empty = is_empty_folder(parent_id);
 
     size_t children_count = 0;    
@@ -104,14 +154,33 @@ size_t Flouds::insert(size_t parent_id, const std::string& name, bool is_folder)
     names->insert(insert_pos, name);
     types->insert(insert_pos, is_folder ? 2 : 0);
 
+    // The parent is always before its children, so its name index is not moved
+    directory_indexes.shift(insert_pos, true);
+    DirectoryIndex* index = directory_indexes.find(parent_id);
+    if (index != nullptr) {
+        index->append(name);
+    }
+
     return insert_pos;
 }
 
 void Flouds::remove(size_t node_id) {
+    version++;
     size_t parent_index = parent(node_id);
     size_t parent_children_before = children_count(parent_index);
 
     bool was_first_child = structure->access(node_id);
+    size_t child_index = node_id - child(parent_index, 0);
+
+    // The name is only valid until the node is removed
+    DirectoryIndex* index = directory_indexes.find(parent_index);
+    if (index != nullptr) {
+        index->remove(child_index, names->view(node_id));
+        if (index->is_sparse()) {
+            // Most slots are unused, the index is built again on the next lookup
+            directory_indexes.erase(parent_index);
+        }
+    }
 
     structure->remove(node_id);
     names->remove(node_id);
@@ -124,6 +193,9 @@ void Flouds::remove(size_t node_id) {
         // If the removed node was the first child, we need to update the structure bit of the new first child
         structure->set(node_id, true);
     }
+
+    directory_indexes.erase(node_id);
+    directory_indexes.shift(node_id + 1, false);
 }
 
 size_t Flouds::path(std::string path) {
@@ -140,27 +212,7 @@ size_t Flouds::path(std::string path) {
         }
         
         std::string_view component(path.data() + start, end - start);
-        
-        int children_count = this->children_count(current);
-        if (children_count == 0) {
-            throw std::out_of_range("path does not exist");
-        }
-        int first_child = this->child(current, 0);
-        int last_child = this->child(current, children_count - 1);
-
-        bool found = false;
-        for (size_t i = first_child; i <= last_child; i++) {
-            std::string child_name = names->access(i);
-            if (child_name == component) {
-                current = i;
-                found = true;
-                break;
-            }
-        }
-        
-        if (!found) {
-            throw std::out_of_range("path does not exist");
-        }
+        current = find_child(current, component);
 
         start = end + 1;
     }
@@ -179,6 +231,8 @@ void Flouds::serialize(char* buffer, size_t* offset) {
 }
 
 void Flouds::deserialize(const char* buffer, size_t* offset) {
+    version++;
+    directory_indexes.clear();
     structure->deserialize(buffer, offset);
     types->deserialize(buffer, offset);
     names->deserialize(buffer, offset);
@@ -9,10 +9,33 @@
 
 #include <cstddef>
 #include <string>
+#include <string_view>
+#include <mutex>
+#include <shared_mutex>
 #include "../bitvector/bitvector.hpp"
 #include "../wavelet_tree/two_bit_wavelet_tree.hpp"
 #include "../name_sequence/name_sequence.hpp"
 #include "../serialization/serializable.hpp"
+#include "directory_index.hpp"
+
+// Bitvector strategy for the structure and the types of FLOUDS
+#ifdef BTREE_BITVECTOR
+using FloudsBitVectorStrategy = BTreeBitVectorStrategy;
+#else
+using FloudsBitVectorStrategy = WordBitVectorStrategy;
+#endif
+
+// Name sequence strategy for the names of FLOUDS
+#ifdef FRONT_CODED_NAME_SEQUENCE
+using FloudsNameSequenceStrategy = FrontCodedNameSequenceStrategy;
+#else
+using FloudsNameSequenceStrategy = ImmerNameSequenceStrategy;
+#endif
+
+// Number of children from which on a folder gets a name index for child lookups
+#ifndef DIRECTORY_INDEX_THRESHOLD
+#define DIRECTORY_INDEX_THRESHOLD 64
+#endif
 
 /**
  * This class represents the FLOUDS data structure.
@@ -28,14 +51,21 @@ class Flouds : public Serializable {
 private:
     BitVector* structure;
     // 2-bit wavelet tree to store the type of each node (0 = file, 1 = folder, 2 = empty folder, 3 = will be used for future extensions)
-    TwoBitWaveletTree<WordBitVectorStrategy>* types;
+    TwoBitWaveletTree<FloudsBitVectorStrategy>* types;
     NameSequence* names;
+    // Name indexes of large folders, mapping the name of a child to the 0-based index of the child.
+    // The indexes are built on the first lookup and kept consistent under insert and remove. They are keyed by the node index of the folder.
+    DirectoryIndexMap directory_indexes;
+    // Guards the lazy construction of name indexes, as lookups may run concurrently
+    std::shared_mutex directory_index_mutex;
+    // Number of modifications of the tree, so callers can tell whether node indexes they remember are still valid
+    size_t version = 0;
 
 public:
     /**
      * Parameterized constructor.
      */
-    Flouds(BitVector* structure, TwoBitWaveletTree<WordBitVectorStrategy>* types, NameSequence* names)
+    Flouds(BitVector* structure, TwoBitWaveletTree<FloudsBitVectorStrategy>* types, NameSequence* names)
         : structure(structure), types(types), names(names) {}
 
     /**
@@ -70,12 +100,42 @@ public:
     virtual size_t child(size_t node_id, size_t child_index);
 
     /**
-     * Gets the name of the node.
+     * Gets the number of nodes in the tree, including the root.
+     * 
+     * @return The number of nodes.
+     */
+    virtual size_t size() const {
+        return structure->size();
+    }
+
+    /**
+     * Gets the version of the tree. Node indexes stay valid as long as the version does not change.
+     * 
+     * @return The number of times the tree was modified.
+     */
+    size_t get_version() const {
+        return version;
+    }
+
+    /**
+     * Gets the index of the child of the node with the given name.
+     * Folders with at least DIRECTORY_INDEX_THRESHOLD children are looked up through a name index, smaller folders are scanned.
+     * Lookups may run concurrently with each other, but not with modifications of the tree.
+     * 
+     * @param node_id The index of the node for which to get the child. Must be a valid folder node.
+     * @param name The name of the child to get.
+     * @return The index of the child with the given name.
+     * @throws std::out_of_range if the node has no child with the given name.
+     */
+    virtual size_t find_child(size_t node_id, std::string_view name);
+
+    /**
+     * Gets the name of the node without copying it.
      * 
      * @param node_id The index of the node for which to get the name. Must be a valid node index.
-     * @return The name of the node.
+     * @return A view of the name of the node, which is only valid until the FLOUDS is modified.
      */
-    virtual std::string get_name(size_t node_id);
+    virtual std::string_view get_name(size_t node_id);
 
     /**
      * Checks if the node is a folder.
@@ -0,0 +1,99 @@
+/**
+ * This file is part of the Succinct Filesystem project.
+ * 
+ * Copyright (c) 2026 Sebastian Brunnert <mail@sebastianbrunnert.de>
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "allocation_manager.hpp"
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+namespace {
+
+/**
+ * A block that is only partially covered by a segment and has to go through a temporary block.
+ */
+struct PartialBlock {
+    size_t block_index;
+    size_t block_offset;
+    size_t size;
+    size_t buffer_offset;
+};
+
+/**
+ * Splits segments into requests for their full blocks and the partial blocks at their start and end.
+ */
+void split_segments(const std::vector<RunSegment>& segments, size_t block_size, char* buffer, bool write, std::vector<BlockRequest>& requests, std::vector<PartialBlock>& partial_blocks) {
+    for (const auto& segment : segments) {
+        size_t block_index = segment.start_block + segment.offset / block_size;
+        size_t block_offset = segment.offset % block_size;
+        size_t done = 0;
+
+        // Partial first block
+        if (segment.size > 0 && (block_offset != 0 || segment.size < block_size)) {
+            size_t length = std::min(segment.size, block_size - block_offset);
+            partial_blocks.push_back({block_index, block_offset, length, segment.buffer_offset});
+            done += length;
+            block_index++;
+        }
+
+        size_t full_blocks = (segment.size - done) / block_size;
+        if (full_blocks > 0) {
+            requests.push_back({block_index, full_blocks, buffer + segment.buffer_offset + done, write});
+            done += full_blocks * block_size;
+            block_index += full_blocks;
+        }
+
+        // Partial last block
+        if (done < segment.size) {
+            partial_blocks.push_back({block_index, 0, segment.size - done, segment.buffer_offset + done});
+        }
+    }
+}
+
+}
+
+void AllocationManager::read_runs(const std::vector<RunSegment>& segments, char* buffer) {
+    size_t block_size = block_device->get_block_size();
+    std::vector<BlockRequest> requests;
+    std::vector<PartialBlock> partial_blocks;
+    split_segments(segments, block_size, buffer, false, requests, partial_blocks);
+
+    std::vector<char> temp(partial_blocks.size() * block_size);
+    for (size_t i = 0; i < partial_blocks.size(); i++) {
+        requests.push_back({partial_blocks[i].block_index, 1, temp.data() + i * block_size, false});
+    }
+    block_device->submit(requests);
+
+    for (size_t i = 0; i < partial_blocks.size(); i++) {
+        const PartialBlock& block = partial_blocks[i];
+        memcpy(buffer + block.buffer_offset, temp.data() + i * block_size + block.block_offset, block.size);
+    }
+}
+
+void AllocationManager::write_runs(const std::vector<RunSegment>& segments, const char* buffer) {
+    size_t block_size = block_device->get_block_size();
+    std::vector<BlockRequest> requests;
+    std::vector<PartialBlock> partial_blocks;
+    // The buffer is only read from by write requests
+    split_segments(segments, block_size, const_cast<char*>(buffer), true, requests, partial_blocks);
+
+    // Read all partial blocks at once, then modify them and write them together with the full blocks
+    std::vector<char> temp(partial_blocks.size() * block_size);
+    if (!partial_blocks.empty()) {
+        std::vector<BlockRequest> reads;
+        for (size_t i = 0; i < partial_blocks.size(); i++) {
+            reads.push_back({partial_blocks[i].block_index, 1, temp.data() + i * block_size, false});
+        }
+        block_device->submit(reads);
+    }
+
+    for (size_t i = 0; i < partial_blocks.size(); i++) {
+        const PartialBlock& block = partial_blocks[i];
+        memcpy(temp.data() + i * block_size + block.block_offset, buffer + block.buffer_offset, block.size);
+        requests.push_back({block.block_index, 1, temp.data() + i * block_size, true});
+    }
+    block_device->submit(requests);
+}
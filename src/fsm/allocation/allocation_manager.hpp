@@ -9,6 +9,34 @@
 
 #include "../../block_device/block_device.hpp"
 #include "../../serialization/serializable.hpp"
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+
+// Upper limit of the space that is reserved behind a growing allocation
+#ifndef PREALLOCATION_MAX_BYTES
+#define PREALLOCATION_MAX_BYTES (64 * 1024 * 1024)
+#endif
+
+// Size of the chunks in which data is copied when an allocation is moved
+#ifndef RELOCATION_CHUNK_SIZE
+#define RELOCATION_CHUNK_SIZE (1024 * 1024)
+#endif
+
+/**
+ * A part of a read or write that lies within one run of consecutive blocks.
+ */
+struct RunSegment {
+    // The first block of the run
+    size_t start_block;
+    // The offset within the run
+    size_t offset;
+    size_t size;
+    // The offset of the data within the caller's buffer
+    size_t buffer_offset;
+};
 
 /**
  * This class defines the interface for different allocation strategies on a block device.
@@ -18,6 +46,75 @@
 class AllocationManager : public Serializable {
 protected:
     BlockDevice* block_device;
+
+    // Guards the allocation state. allocate, resize and free hold it exclusively, other methods hold it shared while they look up where data is stored.
+    // The data itself is transferred without the lock, so I/O on different allocations runs in parallel.
+    mutable std::shared_mutex allocation_mutex;
+
+    // Number of times and bytes that data had to be copied because an allocation was moved
+    std::atomic<size_t> relocations = 0;
+    std::atomic<size_t> relocated_bytes = 0;
+
+    // During journal replay, the data already lies where the replayed operations leave it, so it is neither copied nor zeroed
+    bool replaying = false;
+
+    /**
+     * Reads data from several runs of consecutive blocks. Partial blocks at the start and the end of each segment are read through temporary blocks, full blocks are read into the buffer directly.
+     * All requests are submitted to the block device as one batch.
+     * 
+     * @param segments The segments to read. Segments must not share blocks.
+     * @param buffer The buffer to write the data into.
+     */
+    void read_runs(const std::vector<RunSegment>& segments, char* buffer);
+
+    /**
+     * Writes data to several runs of consecutive blocks. Partial blocks at the start and the end of each segment are read in one batch, modified and written back together with the full blocks in a second batch.
+     * 
+     * @param segments The segments to write. Segments must not share blocks.
+     * @param buffer The buffer containing the data.
+     */
+    void write_runs(const std::vector<RunSegment>& segments, const char* buffer);
+
+    /**
+     * Reads data from a run of consecutive blocks.
+     * 
+     * @param start_block The first block of the run.
+     * @param buffer The buffer to write the data into. Must be at least size bytes.
+     * @param size The number of bytes to read.
+     * @param offset The offset within the run to start reading from.
+     */
+    void read_run(size_t start_block, char* buffer, size_t size, size_t offset) {
+        read_runs({{start_block, offset, size, 0}}, buffer);
+    }
+
+    /**
+     * Writes data to a run of consecutive blocks.
+     * 
+     * @param start_block The first block of the run.
+     * @param buffer The buffer containing the data. Must be at least size bytes.
+     * @param size The number of bytes to write.
+     * @param offset The offset within the run to start writing to.
+     */
+    void write_run(size_t start_block, const char* buffer, size_t size, size_t offset) {
+        write_runs({{start_block, offset, size, 0}}, buffer);
+    }
+
+    /**
+     * Gets a pointer to data within a run of consecutive blocks without copying it.
+     * 
+     * @param start_block The first block of the run.
+     * @param size The number of bytes that must be accessible through the pointer.
+     * @param offset The offset within the run.
+     * @return A pointer to the data or nullptr if the block device cannot map the blocks.
+     */
+    const char* map_run(size_t start_block, size_t size, size_t offset) {
+        size_t block_size = block_device->get_block_size();
+        size_t first_block = offset / block_size;
+        size_t end_block = (offset + size + block_size - 1) / block_size;
+        const char* data = block_device->map_blocks(start_block + first_block, std::max<size_t>(end_block - first_block, 1));
+        return data == nullptr ? nullptr : data + offset % block_size;
+    }
+
 public:
 
     /**
@@ -55,6 +152,19 @@ public:
      */
     virtual void read(size_t handle, char* buffer, size_t size, size_t offset) = 0;
 
+    /**
+     * Gets a pointer to data on the block device without copying it. This is only possible if the block device keeps its blocks in memory and the data is stored contiguously.
+     * The pointer is only valid until the next write to the block device.
+     * 
+     * @param handle The handle of the space to read from.
+     * @param size The number of bytes that must be accessible through the pointer.
+     * @param offset The offset within the allocated space.
+     * @return A pointer to the data or nullptr if the data has to be read with read.
+     */
+    virtual const char* view(size_t handle, size_t size, size_t offset) {
+        return nullptr;
+    }
+
     /**
      * Writes data to the block device.
      * 
@@ -75,6 +185,125 @@ public:
      */
     virtual size_t resize(size_t handle, size_t old_size, size_t new_size) = 0;
 
+    /**
+     * Grows the allocated space like resize, but may reserve additional space behind the new end that grows geometrically with the size.
+     * Following growth within the reserved space does not have to move the data. Shrinking with resize or trim releases the reserved space.
+     * 
+     * @param handle The handle of the space to grow.
+     * @param old_size The old size of the allocated space in bytes. Must be the correct size.
+     * @param new_size The new size of the allocated space in bytes. Must be larger than the old size.
+     * @return The new handle of the allocated space.
+     */
+    virtual size_t grow(size_t handle, size_t old_size, size_t new_size) {
+        return resize(handle, old_size, new_size);
+    }
+
+    /**
+     * Releases the space that is reserved behind an allocation.
+     * 
+     * @param handle The handle of the allocated space.
+     * @param size The size of the allocated space in bytes.
+     * @return true if reserved space was released.
+     */
+    virtual bool trim(size_t handle, size_t size) {
+        return false;
+    }
+
+    /**
+     * Releases the space that is reserved behind all allocations.
+     */
+    virtual void trim_all() {}
+
+    /**
+     * Whether the strategy can leave parts of an allocation without blocks (holes). Holes read as zeros and have to be filled before they are written.
+     * 
+     * @return true if the strategy supports holes.
+     */
+    virtual bool supports_holes() const {
+        return false;
+    }
+
+    /**
+     * Creates an allocation that is a hole entirely. Strategies without holes allocate the space like allocate.
+     * 
+     * @param size The size of the allocation in bytes.
+     * @return The handle of the allocated space.
+     */
+    virtual size_t allocate_sparse(size_t size) {
+        return allocate(size);
+    }
+
+    /**
+     * Grows the allocated space like resize, but the added space becomes a hole. Strategies without holes allocate it like resize.
+     * 
+     * @param handle The handle of the space to extend.
+     * @param old_size The old size of the allocated space in bytes. Must be the correct size.
+     * @param new_size The new size of the allocated space in bytes.
+     * @return The new handle of the allocated space.
+     */
+    virtual size_t extend(size_t handle, size_t old_size, size_t new_size) {
+        return resize(handle, old_size, new_size);
+    }
+
+    /**
+     * Checks whether a range of the allocated space contains holes.
+     * 
+     * @param handle The handle of the allocated space.
+     * @param size The size of the range in bytes.
+     * @param offset The offset of the range within the allocated space.
+     * @return true if blocks of the range are not allocated.
+     */
+    virtual bool has_holes(size_t handle, size_t size, size_t offset) {
+        return false;
+    }
+
+    /**
+     * Allocates blocks for the holes within a range of the allocated space, so the range can be written. The allocation keeps its size.
+     * 
+     * @param handle The handle of the allocated space.
+     * @param size The size of the range in bytes.
+     * @param offset The offset of the range within the allocated space.
+     * @param zero Whether the allocated blocks are overwritten with zeros, as they may contain data of freed allocations. Callers that write the blocks completely can skip this.
+     * @return true if blocks were allocated.
+     */
+    virtual bool fill(size_t handle, size_t size, size_t offset, bool zero) {
+        return false;
+    }
+
+    /**
+     * Frees the blocks that lie completely within a range of the allocated space, so they become a hole. Partial blocks keep their data.
+     * Strategies without holes do nothing.
+     * 
+     * @param handle The handle of the allocated space.
+     * @param size The size of the range in bytes.
+     * @param offset The offset of the range within the allocated space.
+     */
+    virtual void punch_hole(size_t handle, size_t size, size_t offset) {}
+
+    /**
+     * Sets whether journal records are replayed. The data of all allocations was written to their final position before, while the positions they are moved away from may hold data of other allocations by now.
+     * So moved allocations are not copied and added space is not zeroed during replay.
+     * 
+     * @param replaying Whether journal records are replayed.
+     */
+    virtual void set_replaying(bool replaying) {
+        this->replaying = replaying;
+    }
+
+    /**
+     * @return The number of times an allocation was moved and its data copied.
+     */
+    virtual size_t get_relocations() const {
+        return relocations;
+    }
+
+    /**
+     * @return The number of bytes that were copied because allocations were moved.
+     */
+    virtual size_t get_relocated_bytes() const {
+        return relocated_bytes;
+    }
+
     /**
      * Gets the total number of blocks available on the block device.
      * 
@@ -107,4 +336,9 @@ class BestFitAllocationStrategy;
 template <> AllocationManager* create_allocation_manager<BestFitAllocationStrategy>(BlockDevice* block_device);
 
 class ExtentAllocationStrategy;
-template <> AllocationManager* create_allocation_manager<ExtentAllocationStrategy>(BlockDevice* block_device);
\ No newline at end of file
+template <> AllocationManager* create_allocation_manager<ExtentAllocationStrategy>(BlockDevice* block_device);
+
+// Packs small allocations into shared blocks and leaves the others to the given strategy
+template <typename AllocationStrategy> class PackedAllocationStrategy;
+template <> AllocationManager* create_allocation_manager<PackedAllocationStrategy<BestFitAllocationStrategy>>(BlockDevice* block_device);
+template <> AllocationManager* create_allocation_manager<PackedAllocationStrategy<ExtentAllocationStrategy>>(BlockDevice* block_device);
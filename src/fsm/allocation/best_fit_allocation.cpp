@@ -10,162 +10,293 @@
 #include "../../block_device/block_device.hpp"
 #include <cstring>
 #include <cstdint>
+#include <map>
+#include <set>
 
 /**
  * This class implements a consecutive allocation strategy on a block device. It allocates a new block to the smallest possible space or at the end of the device.
+ * The free runs of the block bitmap are indexed by their start and their length, so finding the best fit takes logarithmic time in the number of free runs.
+ * Growing allocations reserve blocks behind their end, so appending to a file rarely has to move it. If it has to move, the data is copied in bounded chunks.
  */
 class BestFitAllocationStrategy : public AllocationManager {
 private:
     BitVector* block_bitmap;
 
-public:
-    BestFitAllocationStrategy(BlockDevice* block_device) : AllocationManager(block_device) {
-        block_bitmap = create_bitvector<WordBitVectorStrategy>(0);
-        block_bitmap->insert(0, true);  // Block 0 is reserved for the header
-    }
+    // Index of the free runs of the bitmap. Runs are ordered by their start and by their length, so the best fit is found with one lookup.
+    std::map<size_t, size_t> free_by_start;
+    std::set<std::pair<size_t, size_t>> free_by_length;
 
-    ~BestFitAllocationStrategy() override {
-        delete block_bitmap;
+    /**
+     * Blocks reserved behind the end of a growing allocation. They are marked as used in the bitmap.
+     */
+    struct Reservation {
+        size_t start_block;
+        size_t num_blocks;
+    };
+
+    // Reservations by the handle of their allocation. They are not serialized, so they are trimmed before the allocation manager is written.
+    std::map<size_t, Reservation> reservations;
+
+    void add_free_run(size_t start, size_t length) {
+        free_by_start.emplace(start, length);
+        free_by_length.emplace(length, start);
     }
 
-    size_t allocate(size_t size) override {
-        size_t best_start = SIZE_MAX;
-        size_t best_size = SIZE_MAX;
+    void remove_free_run(std::map<size_t, size_t>::iterator run) {
+        free_by_length.erase({run->second, run->first});
+        free_by_start.erase(run);
+    }
 
-        size_t current_start = SIZE_MAX;
-        size_t current_size = 0;
+    /**
+     * Rebuilds the index of free runs from the bitmap.
+     */
+    void index_free_runs() {
+        free_by_start.clear();
+        free_by_length.clear();
 
-        size_t required_blocks = (size + block_device->get_block_size() - 1) / block_device->get_block_size();
-        size_t num_blocks = block_bitmap->size();
-
-        // Skip block 0 as its reserved for the header
-        for (size_t i = 1; i < num_blocks; i++) {
-            if (!block_bitmap->access(i)) {
-                if (current_start == SIZE_MAX) {
-                    current_start = i;
-                }
-                current_size++;
-            } else {
-                if (current_size >= required_blocks && current_size < best_size) {
-                    best_start = current_start;
-                    best_size = current_size;
-                }
-                current_start = SIZE_MAX;
-                current_size = 0;
+        size_t run_start = SIZE_MAX;
+        for (size_t i = 1; i <= block_bitmap->size(); i++) {
+            bool free = i < block_bitmap->size() && !block_bitmap->access(i);
+            if (free && run_start == SIZE_MAX) {
+                run_start = i;
+            } else if (!free && run_start != SIZE_MAX) {
+                add_free_run(run_start, i - run_start);
+                run_start = SIZE_MAX;
             }
         }
+    }
 
-        if (current_size >= required_blocks && current_size < best_size) {
-            best_start = current_start;
-        }
+    /**
+     * Marks blocks as used that lie within a free run.
+     */
+    void claim_blocks(size_t start, size_t count) {
+        auto run = std::prev(free_by_start.upper_bound(start));
+        size_t run_start = run->first;
+        size_t run_length = run->second;
+        remove_free_run(run);
 
-        if (best_start == SIZE_MAX) {
-            // Allocate at the end
-            best_start = num_blocks;
-            for (size_t i = best_start; i < best_start + required_blocks; i++) {
-                block_bitmap->insert(i, true);
-            }
-        } else {
-            for (size_t i = best_start; i < best_start + required_blocks; i++) {
-                block_bitmap->set(i, true);
-            }
+        // Keep the free parts before and after the claimed blocks
+        if (start > run_start) {
+            add_free_run(run_start, start - run_start);
+        }
+        if (start + count < run_start + run_length) {
+            add_free_run(start + count, run_start + run_length - start - count);
         }
+        block_bitmap->set_range(start, count, true);
+    }
+
+    /**
+     * Marks used blocks as free and merges them with the neighbouring free runs.
+     */
+    void release_blocks(size_t start, size_t count) {
+        if (count == 0) return;
+        block_bitmap->set_range(start, count, false);
 
-        return best_start;
+        auto next = free_by_start.lower_bound(start);
+        if (next != free_by_start.end() && next->first == start + count) {
+            count += next->second;
+            remove_free_run(next);
+        }
+        auto previous = free_by_start.lower_bound(start);
+        if (previous != free_by_start.begin() && std::prev(previous)->first + std::prev(previous)->second == start) {
+            previous = std::prev(previous);
+            start = previous->first;
+            count += previous->second;
+            remove_free_run(previous);
+        }
+        add_free_run(start, count);
     }
 
-    void free(size_t handle, size_t size) override {
-        size_t start_block = handle;
-        size_t required_blocks = (size + block_device->get_block_size() - 1) / block_device->get_block_size();
-        for (size_t i = start_block; i < start_block + required_blocks; i++) {
-            block_bitmap->set(i, false);
+    /**
+     * Appends used blocks to the end of the bitmap.
+     */
+    void append_blocks(size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            block_bitmap->insert(block_bitmap->size(), true);
         }
     }
 
-    void read(size_t handle, char* buffer, size_t size, size_t offset) override {
-        size_t block_size = block_device->get_block_size();
-        size_t bytes_read = 0;
-        
-        while (bytes_read < size) {
-            size_t current_offset = offset + bytes_read;
-            size_t block_index = handle + (current_offset / block_size);
-            size_t block_offset = current_offset % block_size;
-            size_t to_read = std::min(size - bytes_read, block_size - block_offset);
-            
-            char* temp = new char[block_size];
-            block_device->read_block(block_index, temp);
-            memcpy(buffer + bytes_read, temp + block_offset, to_read);
-            delete[] temp;
-            
-            bytes_read += to_read;
+    /**
+     * Allocates the smallest free run that fits or new blocks at the end. The allocation lock must be held exclusively.
+     */
+    size_t allocate_blocks(size_t size) {
+        return allocate_run((size + block_device->get_block_size() - 1) / block_device->get_block_size());
+    }
+
+    /**
+     * Allocates the smallest free run with the given number of blocks or new blocks at the end. The allocation lock must be held exclusively.
+     */
+    size_t allocate_run(size_t required_blocks) {
+        // The smallest run that fits, the one with the lowest start if there are several
+        auto best = free_by_length.lower_bound({required_blocks, 0});
+        if (best == free_by_length.end()) {
+            // Allocate at the end
+            size_t start = block_bitmap->size();
+            append_blocks(required_blocks);
+            return start;
         }
+
+        size_t start = best->second;
+        claim_blocks(start, required_blocks);
+        return start;
     }
 
-    void write(size_t handle, const char* buffer, size_t size, size_t offset) override {
-        size_t block_size = block_device->get_block_size();
-        size_t bytes_written = 0;
-        
-        while (bytes_written < size) {
-            size_t current_offset = offset + bytes_written;
-            size_t block_index = handle + (current_offset / block_size);
-            size_t block_offset = current_offset % block_size;
-            size_t to_write = std::min(size - bytes_written, block_size - block_offset);
-            
-            char* temp = new char[block_size];
-            if (block_offset != 0 || to_write < block_size) {
-                block_device->read_block(block_index, temp);
-            }
-            memcpy(temp + block_offset, buffer + bytes_written, to_write);
-            block_device->write_block(block_index, temp);
-            delete[] temp;
-            
-            bytes_written += to_write;
+    /**
+     * Frees the blocks of an allocation. The allocation lock must be held exclusively.
+     */
+    void free_blocks(size_t handle, size_t size) {
+        size_t required_blocks = (size + block_device->get_block_size() - 1) / block_device->get_block_size();
+        release_blocks(handle, required_blocks);
+        take_reservation(handle);
+    }
+
+    /**
+     * Removes the reservation of an allocation and releases its blocks.
+     *
+     * @return The number of blocks that were reserved.
+     */
+    size_t take_reservation(size_t handle) {
+        auto it = reservations.find(handle);
+        if (it == reservations.end()) {
+            return 0;
         }
+        size_t num_blocks = it->second.num_blocks;
+        release_blocks(it->second.start_block, num_blocks);
+        reservations.erase(it);
+        return num_blocks;
     }
 
-    size_t resize(size_t handle, size_t old_size, size_t new_size) override {
+    /**
+     * Resizes an allocation. Growth first uses the reserved blocks, then the free blocks behind the allocation and only moves the data if neither is enough.
+     * The allocation lock must be held exclusively.
+     *
+     * @param preallocate Whether additional blocks are reserved when the allocation grows.
+     */
+    size_t resize_blocks(size_t handle, size_t old_size, size_t new_size, bool preallocate) {
         size_t block_size = block_device->get_block_size();
         size_t required_old_blocks = (old_size + block_size - 1) / block_size;
         size_t required_new_blocks = (new_size + block_size - 1) / block_size;
 
+        // The reserved blocks follow the allocation directly, so they are treated as free blocks behind it
+        size_t reserved_blocks = take_reservation(handle);
+
         if (required_new_blocks <= required_old_blocks) {
             // Shrinking: Free blocks from the end of the allocation
-            for (size_t i = handle + required_new_blocks; i < handle + required_old_blocks; i++) {
-                block_bitmap->set(i, false);
-            }
+            release_blocks(handle + required_new_blocks, required_old_blocks - required_new_blocks);
             return handle;
         }
 
-        // Check if the blocks after the current allocation are free and can be used for resizing
-        bool can_extend = true;
-        for (size_t i = handle + required_old_blocks; i < handle + required_new_blocks; i++) {
-            if (block_bitmap->access(i)) {
-                can_extend = false;
-                break;
-            }
+        // The reservation grows with the allocation, up to a fixed limit
+        size_t window_blocks = preallocate ? std::min(required_new_blocks, std::max<size_t>(PREALLOCATION_MAX_BYTES / block_size, 1)) : 0;
+        if (reserved_blocks > 0 && required_new_blocks <= required_old_blocks + reserved_blocks) {
+            // Growth within the reservation keeps the rest of it
+            window_blocks = std::min(window_blocks, required_old_blocks + reserved_blocks - required_new_blocks);
         }
-        if (can_extend) {
-            // Extend the allocation in place
-            for (size_t i = handle + required_old_blocks; i < handle + required_new_blocks; i++) {
-                block_bitmap->set(i, true);
+
+        // Check if the blocks after the current allocation are free and can be used for resizing. Blocks behind the end of the bitmap are free as well.
+        size_t old_end = handle + required_old_blocks;
+        size_t new_end = handle + required_new_blocks;
+        size_t target_end = new_end + window_blocks;
+        size_t free_end = old_end;
+        auto following = free_by_start.find(old_end);
+        if (following != free_by_start.end()) {
+            free_end += following->second;
+        }
+        if (free_end >= new_end || free_end == block_bitmap->size()) {
+            // Extend the allocation in place, the bitmap grows if the allocation reaches behind its end
+            size_t extended_end = (free_end == block_bitmap->size()) ? target_end : std::min(target_end, free_end);
+            size_t claimed = std::min(extended_end, free_end) - old_end;
+            if (claimed > 0) {
+                claim_blocks(old_end, claimed);
+            }
+            append_blocks(extended_end - old_end - claimed);
+            if (extended_end > new_end) {
+                reservations[handle] = Reservation{new_end, extended_end - new_end};
             }
             return handle;
         }
 
-        size_t new_handle = allocate(new_size);
-        char* buffer = new char[old_size];
-        read(handle, buffer, old_size, 0);
-        write(new_handle, buffer, old_size, 0);
-        free(handle, old_size);
-        delete[] buffer;
+        // Move the allocation and copy its data in bounded chunks. During replay, the data already lies at the new position.
+        size_t new_handle = allocate_run(required_new_blocks + window_blocks);
+        if (!replaying) {
+            std::vector<char> buffer(std::min<size_t>(old_size, RELOCATION_CHUNK_SIZE));
+            for (size_t offset = 0; offset < old_size; offset += buffer.size()) {
+                size_t length = std::min(buffer.size(), old_size - offset);
+                read_run(handle, buffer.data(), length, offset);
+                write_run(new_handle, buffer.data(), length, offset);
+            }
+        }
+        release_blocks(handle, required_old_blocks);
+        if (window_blocks > 0) {
+            reservations[new_handle] = Reservation{new_handle + required_new_blocks, window_blocks};
+        }
+        relocations++;
+        relocated_bytes += old_size;
         return new_handle;
     }
 
+public:
+    BestFitAllocationStrategy(BlockDevice* block_device) : AllocationManager(block_device) {
+        block_bitmap = create_bitvector<WordBitVectorStrategy>(0);
+        block_bitmap->insert(0, true);  // Block 0 is reserved for the header
+    }
+
+    ~BestFitAllocationStrategy() override {
+        delete block_bitmap;
+    }
+
+    size_t allocate(size_t size) override {
+        std::unique_lock<std::shared_mutex> lock(allocation_mutex);
+        return allocate_blocks(size);
+    }
+
+    void free(size_t handle, size_t size) override {
+        std::unique_lock<std::shared_mutex> lock(allocation_mutex);
+        free_blocks(handle, size);
+    }
+
+    void read(size_t handle, char* buffer, size_t size, size_t offset) override {
+        // The space of a handle is always contiguous
+        read_run(handle, buffer, size, offset);
+    }
+
+    const char* view(size_t handle, size_t size, size_t offset) override {
+        return map_run(handle, size, offset);
+    }
+
+    void write(size_t handle, const char* buffer, size_t size, size_t offset) override {
+        write_run(handle, buffer, size, offset);
+    }
+
+    size_t resize(size_t handle, size_t old_size, size_t new_size) override {
+        std::unique_lock<std::shared_mutex> lock(allocation_mutex);
+        return resize_blocks(handle, old_size, new_size, false);
+    }
+
+    size_t grow(size_t handle, size_t old_size, size_t new_size) override {
+        std::unique_lock<std::shared_mutex> lock(allocation_mutex);
+        return resize_blocks(handle, old_size, new_size, true);
+    }
+
+    bool trim(size_t handle, size_t size) override {
+        std::unique_lock<std::shared_mutex> lock(allocation_mutex);
+        return take_reservation(handle) > 0;
+    }
+
+    void trim_all() override {
+        std::unique_lock<std::shared_mutex> lock(allocation_mutex);
+        while (!reservations.empty()) {
+            take_reservation(reservations.begin()->first);
+        }
+    }
+
     size_t get_total_blocks() const override {
+        std::shared_lock<std::shared_mutex> lock(allocation_mutex);
         return block_bitmap->size();
     }
 
     size_t get_used_blocks() const override {
+        std::shared_lock<std::shared_mutex> lock(allocation_mutex);
         return block_bitmap->rank1(block_bitmap->size() - 1);
     }
 
@@ -175,6 +306,7 @@ public:
 
     void deserialize(const char* buffer, size_t* offset) override {
         block_bitmap->deserialize(buffer, offset);
+        index_free_runs();
     }
 
     size_t get_serialized_size() override {
@@ -8,6 +8,7 @@
 #include "allocation_manager.hpp"
 #include "../../bitvector/bitvector.hpp"
 #include "../../block_device/block_device.hpp"
+#include <cassert>
 #include <cstring>
 #include <cstdint>
 #include <map>
@@ -16,6 +17,8 @@
 
 /**
  * This class implements an extent-based allocation strategy. It maintains a bitmap to track allocated blocks and allocates multiple contiguous blocks (extents) for each allocation request. Each allocation can consist of multiple non-contiguous extents, eliminating the need for data copying during resize operations.
+ * The extents of an allocation are sorted by their position within the allocation, so the extent covering an offset is found by binary search. Physically adjacent extents are merged.
+ * Extents can be holes without blocks, so sparse files only use space for the data that was written. The block of the handle stays allocated as long as the allocation exists, even if it became a hole, so handles stay unique.
  */
 class ExtentAllocationStrategy : public AllocationManager {
 private:
@@ -27,12 +30,178 @@ private:
     struct Extent {
         size_t start_block;
         size_t num_blocks;
+        // The first block of the extent within the allocation. It is not serialized, but computed from the preceding extents.
+        size_t logical_block;
     };
 
+    // Extents with this start block are holes. Block 0 holds the header, so it never belongs to an allocation.
+    static constexpr size_t HOLE = 0;
+
     std::map<size_t, std::vector<Extent>> extent_map;
 
     /**
-     * Allocates the required number of block and returns the corresponding extents.
+     * Appends an extent to the end of an allocation. If it directly follows the last extent on the block device, the last extent is extended instead.
+     * 
+     * @param extents The extents of the allocation.
+     * @param start_block The first block of the new extent.
+     * @param num_blocks The number of blocks of the new extent.
+     */
+    static void append_extent(std::vector<Extent>& extents, size_t start_block, size_t num_blocks) {
+        if (num_blocks == 0) {
+            return;
+        }
+        if (!extents.empty()) {
+            Extent& last = extents.back();
+            bool holes = last.start_block == HOLE && start_block == HOLE;
+            bool adjacent = last.start_block != HOLE && start_block != HOLE && last.start_block + last.num_blocks == start_block;
+            if (holes || adjacent) {
+                last.num_blocks += num_blocks;
+                return;
+            }
+        }
+        size_t logical_block = extents.empty() ? 0 : extents.back().logical_block + extents.back().num_blocks;
+        extents.push_back({start_block, num_blocks, logical_block});
+    }
+
+    /**
+     * Finds the extent that contains a block of an allocation.
+     * 
+     * @param extents The extents of the allocation.
+     * @param block The block within the allocation.
+     * @return The index of the extent or the number of extents if the block lies behind the allocation.
+     */
+    static size_t find_extent(const std::vector<Extent>& extents, size_t block) {
+        // Most files consist of a single extent
+        if (extents.size() == 1) {
+            return block < extents[0].num_blocks ? 0 : 1;
+        }
+        auto it = std::upper_bound(extents.begin(), extents.end(), block, [](size_t block, const Extent& extent) {
+            return block < extent.logical_block;
+        });
+        if (it == extents.begin()) {
+            return extents.size();
+        }
+        --it;
+        return block < it->logical_block + it->num_blocks ? it - extents.begin() : extents.size();
+    }
+
+    /**
+     * @return The number of blocks of an allocation including its holes.
+     */
+    static size_t get_block_count(const std::vector<Extent>& extents) {
+        return extents.empty() ? 0 : extents.back().logical_block + extents.back().num_blocks;
+    }
+
+    /**
+     * Replaces the blocks [first_block, end_block) of an allocation. The parts of the extents within the range are passed to the given function, which appends their replacement.
+     * 
+     * @param extents The extents of the allocation.
+     * @param first_block The first block of the range within the allocation.
+     * @param end_block The end of the range within the allocation.
+     * @param replace Called with the extents of the result and the start block and number of blocks of each part within the range.
+     * @return The extents of the allocation after the replacement.
+     */
+    template <typename Replace>
+    static std::vector<Extent> replace_range(const std::vector<Extent>& extents, size_t first_block, size_t end_block, Replace replace) {
+        std::vector<Extent> result;
+        for (const Extent& extent : extents) {
+            size_t extent_end = extent.logical_block + extent.num_blocks;
+            size_t overlap_start = std::max(first_block, extent.logical_block);
+            size_t overlap_end = std::min(end_block, extent_end);
+            if (overlap_start >= overlap_end) {
+                append_extent(result, extent.start_block, extent.num_blocks);
+                continue;
+            }
+
+            auto start_of = [&](size_t logical_block) {
+                return extent.start_block == HOLE ? HOLE : extent.start_block + logical_block - extent.logical_block;
+            };
+            append_extent(result, extent.start_block, overlap_start - extent.logical_block);
+            replace(result, start_of(overlap_start), overlap_end - overlap_start);
+            append_extent(result, start_of(overlap_end), extent_end - overlap_end);
+        }
+        return result;
+    }
+
+    /**
+     * Checks whether the blocks [first_block, end_block) of an allocation contain holes.
+     */
+    static bool contains_holes(const std::vector<Extent>& extents, size_t first_block, size_t end_block) {
+        for (size_t i = find_extent(extents, first_block); i < extents.size() && extents[i].logical_block < end_block; i++) {
+            if (extents[i].start_block == HOLE) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Sets the allocation to the given number of blocks. Shrinking frees the blocks behind the new end, growing appends new blocks or a hole.
+     * The allocation lock must be held exclusively.
+     * 
+     * @param handle The handle of the allocation.
+     * @param extents The extents of the allocation.
+     * @param required_blocks The new number of blocks.
+     * @param sparse Whether added blocks become a hole.
+     */
+    void resize_extents(size_t handle, std::vector<Extent>& extents, size_t required_blocks, bool sparse) {
+        size_t current_blocks = get_block_count(extents);
+        if (required_blocks > current_blocks) {
+            if (sparse) {
+                append_extent(extents, HOLE, required_blocks - current_blocks);
+                return;
+            }
+            // Growing: Allocate additional blocks and add them as new extents
+            for (const auto& extent : allocate_extents(required_blocks - current_blocks)) {
+                append_extent(extents, extent.start_block, extent.num_blocks);
+            }
+            return;
+        }
+
+        // Shrinking: Only the extent containing the new end and the extents behind it change
+        size_t index = find_extent(extents, required_blocks);
+        if (index == extents.size()) {
+            return;
+        }
+        size_t blocks_to_keep = required_blocks - extents[index].logical_block;
+        if (extents[index].start_block != HOLE) {
+            block_bitmap->set_range(extents[index].start_block + blocks_to_keep, extents[index].num_blocks - blocks_to_keep, false);
+        }
+        extents[index].num_blocks = blocks_to_keep;
+        for (size_t i = index + 1; i < extents.size(); i++) {
+            if (extents[i].start_block != HOLE) {
+                block_bitmap->set_range(extents[i].start_block, extents[i].num_blocks, false);
+            }
+        }
+        extents.resize(blocks_to_keep > 0 ? index + 1 : index);
+        // The handle identifies the allocation, so its block is not freed
+        block_bitmap->set(handle, true);
+    }
+
+    /**
+     * Splits a range of an allocation into the parts that lie within its extents.
+     * 
+     * @param extents The extents of the allocation.
+     * @param size The size of the range in bytes.
+     * @param offset The offset of the range within the allocation.
+     * @return The segments covering the range.
+     */
+    std::vector<RunSegment> get_segments(const std::vector<Extent>& extents, size_t size, size_t offset) const {
+        std::vector<RunSegment> segments;
+        size_t block_size = block_device->get_block_size();
+        size_t done = 0;
+        for (size_t i = find_extent(extents, offset / block_size); i < extents.size() && done < size; i++) {
+            const Extent& extent = extents[i];
+            size_t extent_offset = offset + done - extent.logical_block * block_size;
+            size_t length = std::min(size - done, extent.num_blocks * block_size - extent_offset);
+            segments.push_back({extent.start_block, extent_offset, length, done});
+            done += length;
+        }
+        return segments;
+    }
+
+    /**
+     * Allocates exactly the required number of blocks and returns the corresponding extents.
      * 
      * @param required_blocks The number of blocks to allocate.
      * @return A vector of extents representing the allocated blocks.
@@ -52,40 +221,33 @@ private:
                     current_start = i;
                 }
                 current_size++;
-            } else if (current_size > (required_blocks - blocks_allocated) / 3) {
-                // Allocate the current extent if its large enough (at least 1/3 of the remaining blocks needed to avoid fragmentation)
-                extents.push_back({current_start, current_size});
-                for (size_t j = current_start; j < current_start + current_size; j++) {
-                    block_bitmap->set(j, true);
+                if (current_size < required_blocks - blocks_allocated) {
+                    continue;
                 }
-                blocks_allocated += current_size;
-
+                // The run covers all remaining blocks, so only the front of a larger run is taken
+            } else if (current_size == 0 || current_size <= (required_blocks - blocks_allocated) / 3) {
+                // The run is too short (it has to be more than 1/3 of the remaining blocks to avoid fragmentation), so the next run is counted from its start
                 current_start = SIZE_MAX;
                 current_size = 0;
+                continue;
             }
+            append_extent(extents, current_start, current_size);
+            block_bitmap->set_range(current_start, current_size, true);
+            blocks_allocated += current_size;
+
+            current_start = SIZE_MAX;
+            current_size = 0;
         }
         
         // Remaining blocks are allocated at the end
         if (blocks_allocated < required_blocks) {
             size_t remaining = required_blocks - blocks_allocated;
-            
-            if (current_size > 0) {
-                // The last blocks are free and can be extended
-                size_t start = num_blocks - current_size;
-                size_t total_size = current_size + remaining;
-                extents.push_back({start, total_size});
-                for (size_t j = start; j < num_blocks; j++) {
-                    block_bitmap->set(j, true);
-                }
-                for (size_t j = num_blocks; j < start + total_size; j++) {
-                    block_bitmap->insert(j, true);
-                }
-            } else {
-                // No free blocks at the end, just allocate new blocks
-                extents.push_back({num_blocks, remaining});
-                for (size_t j = num_blocks; j < num_blocks + remaining; j++) {
-                    block_bitmap->insert(j, true);
-                }
+            // A run that is still open ends at the last block and is shorter than the remaining blocks, so it is extended
+            size_t start = current_size > 0 ? current_start : num_blocks;
+            append_extent(extents, start, remaining);
+            block_bitmap->set_range(start, current_size, true);
+            for (size_t j = num_blocks; j < start + remaining; j++) {
+                block_bitmap->insert(j, true);
             }
         }
         
@@ -103,6 +265,7 @@ public:
     }
 
     size_t allocate(size_t size) override {
+        std::unique_lock<std::shared_mutex> lock(allocation_mutex);
         size_t required_blocks = (size + block_device->get_block_size() - 1) / block_device->get_block_size();
         std::vector<Extent> extents = allocate_extents(required_blocks);
         
@@ -114,180 +277,191 @@ public:
     }
 
     void free(size_t handle, size_t size) override {
+        std::unique_lock<std::shared_mutex> lock(allocation_mutex);
         auto it = extent_map.find(handle);
         if (it == extent_map.end()) {
             return;
         }
         
         for (const auto& extent : it->second) {
-            for (size_t i = extent.start_block; i < extent.start_block + extent.num_blocks; i++) {
-                block_bitmap->set(i, false);
+            if (extent.start_block != HOLE) {
+                block_bitmap->set_range(extent.start_block, extent.num_blocks, false);
             }
         }
+        // The block of the handle may not be part of the extents anymore
+        block_bitmap->set(handle, false);
         
         extent_map.erase(it);
     }
 
     void read(size_t handle, char* buffer, size_t size, size_t offset) override {
+        std::shared_lock<std::shared_mutex> lock(allocation_mutex);
         auto it = extent_map.find(handle);
         if (it == extent_map.end()){
             // Fallback: This is needed when loading own data before extent_map is initailized.
-            size_t block_size = block_device->get_block_size();
-            size_t bytes_read = 0;
-            
-            while (bytes_read < size) {
-                size_t current_offset = offset + bytes_read;
-                size_t block_index = handle + (current_offset / block_size);
-                size_t block_offset = current_offset % block_size;
-                size_t to_read = std::min(size - bytes_read, block_size - block_offset);
-                
-                char* temp = new char[block_size];
-                block_device->read_block(block_index, temp);
-                memcpy(buffer + bytes_read, temp + block_offset, to_read);
-                delete[] temp;
-                
-                bytes_read += to_read;
-            }
+            read_run(handle, buffer, size, offset);
             return;
         }
         
-        size_t block_size = block_device->get_block_size();
-        size_t bytes_read = 0;
-        size_t extent_offset = offset;
-        
-        // Iterate through the extents and read from the appropriate blocks
-        for (const auto& extent : it->second) {
-            size_t extent_size = extent.num_blocks * block_size;
-            
-            // Skip extents until we reach the offset
-            if (extent_offset >= extent_size) {
-                extent_offset -= extent_size;
-                continue;
-            }
-            
-            // Read from this extent
-            while (bytes_read < size && extent_offset < extent_size) {
-                size_t block_in_extent = extent_offset / block_size;
-                size_t block_offset = extent_offset % block_size;
-                size_t physical_block = extent.start_block + block_in_extent;
-                size_t to_read = std::min(size - bytes_read, block_size - block_offset);
-                
-                char* temp = new char[block_size];
-                block_device->read_block(physical_block, temp);
-                memcpy(buffer + bytes_read, temp + block_offset, to_read);
-                delete[] temp;
-                
-                bytes_read += to_read;
-                extent_offset += to_read;
-            }
-            
-            // Start from beginning of next extent
-            extent_offset = 0;
-            
-            if (bytes_read >= size) {
-                break;
+        // Collect the covered part of each extent and read all of them in one batch. Holes are not stored on the block device and read as zeros.
+        std::vector<RunSegment> segments;
+        for (const RunSegment& segment : get_segments(it->second, size, offset)) {
+            if (segment.start_block == HOLE) {
+                std::memset(buffer + segment.buffer_offset, 0, segment.size);
+            } else {
+                segments.push_back(segment);
             }
         }
+        // The extents of the allocation only change while its owner resizes it, so the data is read without the lock
+        lock.unlock();
+        read_runs(segments, buffer);
+    }
+
+    const char* view(size_t handle, size_t size, size_t offset) override {
+        std::shared_lock<std::shared_mutex> lock(allocation_mutex);
+        auto it = extent_map.find(handle);
+        if (it == extent_map.end()) {
+            return map_run(handle, size, offset);
+        }
+
+        // The data can only be accessed directly if it lies within one extent
+        size_t block_size = block_device->get_block_size();
+        size_t index = find_extent(it->second, offset / block_size);
+        if (index == it->second.size()) {
+            return nullptr;
+        }
+        const Extent& extent = it->second[index];
+        if (extent.start_block == HOLE) {
+            return nullptr;
+        }
+        size_t extent_offset = offset - extent.logical_block * block_size;
+        return extent_offset + size <= extent.num_blocks * block_size ? map_run(extent.start_block, size, extent_offset) : nullptr;
     }
 
     void write(size_t handle, const char* buffer, size_t size, size_t offset) override {
+        std::shared_lock<std::shared_mutex> lock(allocation_mutex);
         auto it = extent_map.find(handle);
         if (it == extent_map.end()) {
             return;
         }
         
-        size_t block_size = block_device->get_block_size();
-        size_t bytes_written = 0;
-        size_t extent_offset = offset;
-        
-        // Iterate through the extents and write to the appropriate blocks
-        for (const auto& extent : it->second) {
-            size_t extent_size = extent.num_blocks * block_size;
-            
-            if (extent_offset >= extent_size) {
-                extent_offset -= extent_size;
-                continue;
-            }
-            
-            // Write to this extent
-            while (bytes_written < size && extent_offset < extent_size) {
-                size_t block_in_extent = extent_offset / block_size;
-                size_t block_offset = extent_offset % block_size;
-                size_t physical_block = extent.start_block + block_in_extent;
-                size_t to_write = std::min(size - bytes_written, block_size - block_offset);
-                
-                char* temp = new char[block_size];
-                if (block_offset != 0 || to_write < block_size) {
-                    block_device->read_block(physical_block, temp);
-                }
-                memcpy(temp + block_offset, buffer + bytes_written, to_write);
-                block_device->write_block(physical_block, temp);
-                delete[] temp;
-                
-                bytes_written += to_write;
-                extent_offset += to_write;
-            }
-            
-            // Start from beginning of next extent
-            extent_offset = 0;
-            
-            if (bytes_written >= size) {
-                break;
+        // Collect the covered part of each extent and write all of them in one batch. Holes have to be filled before, so data for them is dropped.
+        std::vector<RunSegment> segments;
+        for (const RunSegment& segment : get_segments(it->second, size, offset)) {
+            if (segment.start_block != HOLE) {
+                segments.push_back(segment);
             }
         }
+        lock.unlock();
+        write_runs(segments, buffer);
     }
 
     size_t resize(size_t handle, size_t old_size, size_t new_size) override {
+        std::unique_lock<std::shared_mutex> lock(allocation_mutex);
+        auto it = extent_map.find(handle);
+        if (it != extent_map.end()) {
+            resize_extents(handle, it->second, (new_size + block_device->get_block_size() - 1) / block_device->get_block_size(), false);
+        }
+        return handle;
+    }
+
+    bool supports_holes() const override {
+        return true;
+    }
+
+    size_t allocate_sparse(size_t size) override {
+        std::unique_lock<std::shared_mutex> lock(allocation_mutex);
+        // Only the block of the handle is allocated
+        size_t handle = allocate_extents(1)[0].start_block;
+        std::vector<Extent> extents;
+        append_extent(extents, HOLE, (size + block_device->get_block_size() - 1) / block_device->get_block_size());
+        extent_map[handle] = extents;
+        return handle;
+    }
+
+    size_t extend(size_t handle, size_t old_size, size_t new_size) override {
+        std::unique_lock<std::shared_mutex> lock(allocation_mutex);
+        auto it = extent_map.find(handle);
+        if (it != extent_map.end()) {
+            resize_extents(handle, it->second, (new_size + block_device->get_block_size() - 1) / block_device->get_block_size(), true);
+        }
+        return handle;
+    }
+
+    bool has_holes(size_t handle, size_t size, size_t offset) override {
+        std::shared_lock<std::shared_mutex> lock(allocation_mutex);
+        auto it = extent_map.find(handle);
         size_t block_size = block_device->get_block_size();
-        size_t required_old_blocks = (old_size + block_size - 1) / block_size;
-        size_t required_new_blocks = (new_size + block_size - 1) / block_size;
-        
-        if (required_new_blocks <= required_old_blocks) {
-            // Shrinking: Free blocks from the end of the allocation
-            auto it = extent_map.find(handle);
-
-            size_t blocks_to_keep = required_new_blocks;
-            std::vector<Extent> new_extents;
-            
-            // Iterate through the extents and keep the necessary blocks, freeing the rest
-            for (const auto& extent : it->second) {
-                if (blocks_to_keep >= extent.num_blocks) {
-                    new_extents.push_back(extent);
-                    blocks_to_keep -= extent.num_blocks;
-                } else if (blocks_to_keep > 0) {
-                    new_extents.push_back({extent.start_block, blocks_to_keep});
-                    for (size_t i = extent.start_block + blocks_to_keep; i < extent.start_block + extent.num_blocks; i++) {
-                        block_bitmap->set(i, false);
-                    }
-                    blocks_to_keep = 0;
-                } else {
-                    for (size_t i = extent.start_block; i < extent.start_block + extent.num_blocks; i++) {
-                        block_bitmap->set(i, false);
-                    }
+        return it != extent_map.end() && size > 0 && contains_holes(it->second, offset / block_size, (offset + size + block_size - 1) / block_size);
+    }
+
+    bool fill(size_t handle, size_t size, size_t offset, bool zero) override {
+        std::unique_lock<std::shared_mutex> lock(allocation_mutex);
+        auto it = extent_map.find(handle);
+        size_t block_size = block_device->get_block_size();
+        size_t first_block = offset / block_size;
+        size_t end_block = (offset + size + block_size - 1) / block_size;
+        if (it == extent_map.end() || size == 0 || !contains_holes(it->second, first_block, end_block)) {
+            return false;
+        }
+
+        // Segments must not share blocks, so the chunks are whole blocks
+        size_t chunk_size = std::max<size_t>(RELOCATION_CHUNK_SIZE / block_size, 1) * block_size;
+        std::vector<RunSegment> filled;
+        it->second = replace_range(it->second, first_block, end_block, [&](std::vector<Extent>& result, size_t start_block, size_t num_blocks) {
+            if (start_block != HOLE) {
+                append_extent(result, start_block, num_blocks);
+                return;
+            }
+            [[maybe_unused]] size_t allocated = 0;
+            for (const auto& extent : allocate_extents(num_blocks)) {
+                append_extent(result, extent.start_block, extent.num_blocks);
+                allocated += extent.num_blocks;
+                // All runs are zeroed from the same buffer
+                for (size_t run_offset = 0; zero && !replaying && run_offset < extent.num_blocks * block_size; run_offset += chunk_size) {
+                    filled.push_back({extent.start_block, run_offset, std::min(chunk_size, extent.num_blocks * block_size - run_offset), 0});
                 }
             }
-            
-            it->second = new_extents;
-            return handle;
+            // Otherwise the following extents would move within the allocation
+            assert(allocated == num_blocks);
+        });
+        lock.unlock();
+
+        if (!filled.empty()) {
+            std::vector<char> zeros(std::min(chunk_size, (end_block - first_block) * block_size), 0);
+            write_runs(filled, zeros.data());
         }
-        
-        // Growing: Allocate additional blocks and add them as new extents
-        size_t additional_blocks = required_new_blocks - required_old_blocks;
-        std::vector<Extent> new_extents = allocate_extents(additional_blocks);
-        
+        return true;
+    }
+
+    void punch_hole(size_t handle, size_t size, size_t offset) override {
+        std::unique_lock<std::shared_mutex> lock(allocation_mutex);
         auto it = extent_map.find(handle);
-        if (it != extent_map.end()) {
-            it->second.insert(it->second.end(), new_extents.begin(), new_extents.end());
+        size_t block_size = block_device->get_block_size();
+        // Only blocks that lie completely within the range are freed
+        size_t first_block = (offset + block_size - 1) / block_size;
+        size_t end_block = (offset + size) / block_size;
+        if (it == extent_map.end() || first_block >= end_block) {
+            return;
         }
-        
-        return handle;
+
+        it->second = replace_range(it->second, first_block, end_block, [&](std::vector<Extent>& result, size_t start_block, size_t num_blocks) {
+            if (start_block != HOLE) {
+                block_bitmap->set_range(start_block, num_blocks, false);
+            }
+            append_extent(result, HOLE, num_blocks);
+        });
+        // The handle identifies the allocation, so its block is not freed
+        block_bitmap->set(handle, true);
     }
 
     size_t get_total_blocks() const override {
+        std::shared_lock<std::shared_mutex> lock(allocation_mutex);
         return block_bitmap->size();
     }
 
     size_t get_used_blocks() const override {
+        std::shared_lock<std::shared_mutex> lock(allocation_mutex);
         return block_bitmap->rank1(block_bitmap->size() - 1);
     }
 
@@ -331,6 +505,7 @@ public:
                 *offset += sizeof(size_t);
                 memcpy(&extent.num_blocks, buffer + *offset, sizeof(size_t));
                 *offset += sizeof(size_t);
+                extent.logical_block = extents.empty() ? 0 : extents.back().logical_block + extents.back().num_blocks;
                 extents.push_back(extent);
             }
             extent_map[handle] = extents;
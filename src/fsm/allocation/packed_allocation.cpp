@@ -0,0 +1,398 @@
+/**
+ * This file is part of the Succinct Filesystem project.
+ *
+ * Copyright (c) 2026 Sebastian Brunnert <mail@sebastianbrunnert.de>
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "allocation_manager.hpp"
+#include <array>
+#include <cstring>
+#include <map>
+#include <set>
+#include <vector>
+
+/**
+ * This class packs small allocations into shared blocks and leaves all other allocations to another strategy.
+ * A shared block is divided into 8 units. Small allocations occupy a run of consecutive units of one block, so they are sized in classes of 1 to 7 units.
+ * The occupied units of each shared block are tracked in a bitmap of 8 bits. Shared blocks are indexed by their longest free run, so the block with the smallest run that fits is found in logarithmic time.
+ * The handle of a small allocation contains its shared block and first unit, so its data is found without any lookup.
+ */
+template <typename AllocationStrategy>
+class PackedAllocationStrategy : public AllocationManager {
+private:
+    static constexpr size_t UNITS_PER_BLOCK = 8;
+
+    // Handles of small allocations have this bit set. The other strategies use block numbers as handles, which never reach it.
+    static constexpr size_t PACKED_HANDLE = size_t(1) << 63;
+
+    // Allocates the shared blocks and all allocations that are too large to be packed
+    AllocationManager* block_allocation_manager;
+
+    // The occupied units of each shared block by its handle in the block allocation manager
+    std::map<size_t, uint8_t> shared_blocks;
+
+    // Shared blocks by the length of their longest free run
+    std::set<std::pair<size_t, size_t>> shared_blocks_by_free_run;
+
+    // Small allocations of different files may share a block, so writes to the same block must not overlap
+    std::array<std::mutex, 64> block_locks;
+
+    /**
+     * @return Whether the handle belongs to a small allocation.
+     */
+    static bool is_packed(size_t handle) {
+        return (handle & PACKED_HANDLE) != 0;
+    }
+
+    /**
+     * @return The handle of the shared block of a small allocation.
+     */
+    static size_t get_block(size_t handle) {
+        return (handle & ~PACKED_HANDLE) / UNITS_PER_BLOCK;
+    }
+
+    /**
+     * @return The first unit of a small allocation within its shared block.
+     */
+    static size_t get_unit(size_t handle) {
+        return handle % UNITS_PER_BLOCK;
+    }
+
+    size_t get_unit_size() const {
+        return block_device->get_block_size() / UNITS_PER_BLOCK;
+    }
+
+    /**
+     * @return The number of units a small allocation of the given size occupies. Empty allocations occupy one unit, so their handle is unique.
+     */
+    size_t get_units(size_t size) const {
+        return std::max<size_t>((size + get_unit_size() - 1) / get_unit_size(), 1);
+    }
+
+    /**
+     * @return Whether an allocation of the given size is packed.
+     */
+    bool fits_packed(size_t size) const {
+        return get_units(size) < UNITS_PER_BLOCK;
+    }
+
+    /**
+     * @return The length of the longest run of free units in an occupancy bitmap.
+     */
+    static size_t get_longest_free_run(uint8_t occupancy) {
+        size_t longest = 0;
+        size_t current = 0;
+        for (size_t unit = 0; unit < UNITS_PER_BLOCK; unit++) {
+            current = (occupancy >> unit & 1) ? 0 : current + 1;
+            longest = std::max(longest, current);
+        }
+        return longest;
+    }
+
+    /**
+     * @return The bits of the units [unit, unit + count).
+     */
+    static uint8_t get_mask(size_t unit, size_t count) {
+        return (uint8_t) (((1u << count) - 1) << unit);
+    }
+
+    /**
+     * Sets the occupancy bitmap of a shared block and updates the index. The allocation lock must be held exclusively.
+     */
+    void set_occupancy(size_t block, uint8_t occupancy) {
+        auto it = shared_blocks.find(block);
+        if (it != shared_blocks.end()) {
+            shared_blocks_by_free_run.erase({get_longest_free_run(it->second), block});
+        }
+        if (occupancy == 0) {
+            // The block is empty, so it is returned
+            shared_blocks.erase(block);
+            block_allocation_manager->free(block, block_device->get_block_size());
+            return;
+        }
+        shared_blocks[block] = occupancy;
+        shared_blocks_by_free_run.insert({get_longest_free_run(occupancy), block});
+    }
+
+    /**
+     * Allocates a run of units in the shared block with the smallest free run that fits, or in a new shared block. The allocation lock must be held exclusively.
+     *
+     * @param units The number of units. Must be less than UNITS_PER_BLOCK.
+     * @return The handle of the small allocation.
+     */
+    size_t allocate_units(size_t units) {
+        auto it = shared_blocks_by_free_run.lower_bound({units, 0});
+        size_t block;
+        uint8_t occupancy = 0;
+        if (it == shared_blocks_by_free_run.end()) {
+            block = block_allocation_manager->allocate(block_device->get_block_size());
+        } else {
+            block = it->second;
+            occupancy = shared_blocks[block];
+        }
+
+        // The first run of free units that fits
+        for (size_t unit = 0; unit + units <= UNITS_PER_BLOCK; unit++) {
+            if ((occupancy & get_mask(unit, units)) == 0) {
+                set_occupancy(block, occupancy | get_mask(unit, units));
+                return PACKED_HANDLE | (block * UNITS_PER_BLOCK + unit);
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * Releases the units of a small allocation. The allocation lock must be held exclusively.
+     */
+    void free_units(size_t handle, size_t units) {
+        size_t block = get_block(handle);
+        set_occupancy(block, shared_blocks[block] & ~get_mask(get_unit(handle), units));
+    }
+
+    /**
+     * Writes zeros to a range of a small allocation.
+     */
+    void zero_packed(size_t handle, size_t size, size_t offset) {
+        if (replaying) {
+            return;
+        }
+        std::vector<char> zeros(size, 0);
+        write(handle, zeros.data(), size, offset);
+    }
+
+    /**
+     * Moves the data of an allocation to a new allocation.
+     */
+    void copy_allocation(size_t from, size_t to, size_t size) {
+        if (replaying) {
+            return;
+        }
+        std::vector<char> buffer(size);
+        read(from, buffer.data(), size, 0);
+        write(to, buffer.data(), size, 0);
+    }
+
+    /**
+     * Resizes a small allocation. It grows in place if the following units of its block are free and moves otherwise, to another shared block or to the block allocation manager if it does not fit anymore.
+     * The allocation lock must be held exclusively.
+     *
+     * @param sparse Whether the added space is left to the block allocation manager as a hole.
+     */
+    size_t resize_packed(size_t handle, size_t old_size, size_t new_size, bool sparse) {
+        size_t old_units = get_units(old_size);
+        size_t new_units = get_units(new_size);
+        size_t block = get_block(handle);
+        size_t unit = get_unit(handle);
+
+        if (new_units <= old_units) {
+            set_occupancy(block, shared_blocks[block] & ~get_mask(unit + new_units, old_units - new_units));
+            return handle;
+        }
+
+        uint8_t added = unit + new_units <= UNITS_PER_BLOCK ? get_mask(unit + old_units, new_units - old_units) : 0xFF;
+        if (new_units < UNITS_PER_BLOCK && (shared_blocks[block] & added) == 0) {
+            set_occupancy(block, shared_blocks[block] | added);
+            return handle;
+        }
+
+        size_t new_handle;
+        if (fits_packed(new_size)) {
+            new_handle = allocate_units(new_units);
+        } else if (sparse) {
+            new_handle = block_allocation_manager->allocate_sparse(new_size);
+            block_allocation_manager->fill(new_handle, old_size, 0, true);
+        } else {
+            new_handle = block_allocation_manager->allocate(new_size);
+        }
+        copy_allocation(handle, new_handle, old_size);
+        free_units(handle, old_units);
+        relocations++;
+        relocated_bytes += old_size;
+        return new_handle;
+    }
+
+public:
+    PackedAllocationStrategy(BlockDevice* block_device) : AllocationManager(block_device) {
+        block_allocation_manager = create_allocation_manager<AllocationStrategy>(block_device);
+    }
+
+    ~PackedAllocationStrategy() override {
+        delete block_allocation_manager;
+    }
+
+    size_t allocate(size_t size) override {
+        if (!fits_packed(size)) {
+            return block_allocation_manager->allocate(size);
+        }
+        std::unique_lock<std::shared_mutex> lock(allocation_mutex);
+        return allocate_units(get_units(size));
+    }
+
+    void free(size_t handle, size_t size) override {
+        if (!is_packed(handle)) {
+            block_allocation_manager->free(handle, size);
+            return;
+        }
+        std::unique_lock<std::shared_mutex> lock(allocation_mutex);
+        free_units(handle, get_units(size));
+    }
+
+    void read(size_t handle, char* buffer, size_t size, size_t offset) override {
+        if (!is_packed(handle)) {
+            block_allocation_manager->read(handle, buffer, size, offset);
+            return;
+        }
+        // The shared block stays allocated as long as the small allocation exists, so no lock is needed
+        block_allocation_manager->read(get_block(handle), buffer, size, get_unit(handle) * get_unit_size() + offset);
+    }
+
+    const char* view(size_t handle, size_t size, size_t offset) override {
+        if (!is_packed(handle)) {
+            return block_allocation_manager->view(handle, size, offset);
+        }
+        return block_allocation_manager->view(get_block(handle), size, get_unit(handle) * get_unit_size() + offset);
+    }
+
+    void write(size_t handle, const char* buffer, size_t size, size_t offset) override {
+        if (!is_packed(handle)) {
+            block_allocation_manager->write(handle, buffer, size, offset);
+            return;
+        }
+        // Partial blocks are read, modified and written back, so writes to other units of the block have to wait
+        std::lock_guard<std::mutex> lock(block_locks[get_block(handle) % block_locks.size()]);
+        block_allocation_manager->write(get_block(handle), buffer, size, get_unit(handle) * get_unit_size() + offset);
+    }
+
+    size_t resize(size_t handle, size_t old_size, size_t new_size) override {
+        if (!is_packed(handle)) {
+            return block_allocation_manager->resize(handle, old_size, new_size);
+        }
+        std::unique_lock<std::shared_mutex> lock(allocation_mutex);
+        return resize_packed(handle, old_size, new_size, false);
+    }
+
+    size_t grow(size_t handle, size_t old_size, size_t new_size) override {
+        if (!is_packed(handle)) {
+            return block_allocation_manager->grow(handle, old_size, new_size);
+        }
+        std::unique_lock<std::shared_mutex> lock(allocation_mutex);
+        return resize_packed(handle, old_size, new_size, false);
+    }
+
+    bool trim(size_t handle, size_t size) override {
+        return !is_packed(handle) && block_allocation_manager->trim(handle, size);
+    }
+
+    void trim_all() override {
+        block_allocation_manager->trim_all();
+    }
+
+    bool supports_holes() const override {
+        return block_allocation_manager->supports_holes();
+    }
+
+    void set_replaying(bool replaying) override {
+        this->replaying = replaying;
+        block_allocation_manager->set_replaying(replaying);
+    }
+
+    size_t allocate_sparse(size_t size) override {
+        if (!fits_packed(size)) {
+            return block_allocation_manager->allocate_sparse(size);
+        }
+        size_t handle = allocate(size);
+        // The units may contain data of a freed allocation
+        zero_packed(handle, size, 0);
+        return handle;
+    }
+
+    size_t extend(size_t handle, size_t old_size, size_t new_size) override {
+        if (!is_packed(handle)) {
+            return block_allocation_manager->extend(handle, old_size, new_size);
+        }
+        std::unique_lock<std::shared_mutex> lock(allocation_mutex);
+        size_t new_handle = resize_packed(handle, old_size, new_size, supports_holes());
+        if (is_packed(new_handle)) {
+            zero_packed(new_handle, new_size - old_size, old_size);
+        }
+        return new_handle;
+    }
+
+    bool has_holes(size_t handle, size_t size, size_t offset) override {
+        return !is_packed(handle) && block_allocation_manager->has_holes(handle, size, offset);
+    }
+
+    bool fill(size_t handle, size_t size, size_t offset, bool zero) override {
+        return !is_packed(handle) && block_allocation_manager->fill(handle, size, offset, zero);
+    }
+
+    void punch_hole(size_t handle, size_t size, size_t offset) override {
+        // Small allocations lie within one block, so they contain no whole block that could become a hole
+        if (!is_packed(handle)) {
+            block_allocation_manager->punch_hole(handle, size, offset);
+        }
+    }
+
+    size_t get_relocations() const override {
+        return relocations + block_allocation_manager->get_relocations();
+    }
+
+    size_t get_relocated_bytes() const override {
+        return relocated_bytes + block_allocation_manager->get_relocated_bytes();
+    }
+
+    size_t get_total_blocks() const override {
+        return block_allocation_manager->get_total_blocks();
+    }
+
+    size_t get_used_blocks() const override {
+        return block_allocation_manager->get_used_blocks();
+    }
+
+    void serialize(char* buffer, size_t* offset) override {
+        block_allocation_manager->serialize(buffer, offset);
+        size_t num_blocks = shared_blocks.size();
+        std::memcpy(buffer + *offset, &num_blocks, sizeof(size_t));
+        *offset += sizeof(size_t);
+        for (const auto& [block, occupancy] : shared_blocks) {
+            std::memcpy(buffer + *offset, &block, sizeof(size_t));
+            *offset += sizeof(size_t);
+            std::memcpy(buffer + *offset, &occupancy, sizeof(uint8_t));
+            *offset += sizeof(uint8_t);
+        }
+    }
+
+    void deserialize(const char* buffer, size_t* offset) override {
+        block_allocation_manager->deserialize(buffer, offset);
+        size_t num_blocks;
+        std::memcpy(&num_blocks, buffer + *offset, sizeof(size_t));
+        *offset += sizeof(size_t);
+        shared_blocks.clear();
+        shared_blocks_by_free_run.clear();
+        for (size_t i = 0; i < num_blocks; i++) {
+            size_t block;
+            uint8_t occupancy;
+            std::memcpy(&block, buffer + *offset, sizeof(size_t));
+            *offset += sizeof(size_t);
+            std::memcpy(&occupancy, buffer + *offset, sizeof(uint8_t));
+            *offset += sizeof(uint8_t);
+            shared_blocks[block] = occupancy;
+            shared_blocks_by_free_run.insert({get_longest_free_run(occupancy), block});
+        }
+    }
+
+    size_t get_serialized_size() override {
+        return block_allocation_manager->get_serialized_size() + sizeof(size_t) + shared_blocks.size() * (sizeof(size_t) + sizeof(uint8_t));
+    }
+};
+
+template <>
+AllocationManager* create_allocation_manager<PackedAllocationStrategy<BestFitAllocationStrategy>>(BlockDevice* block_device) {
+    return new PackedAllocationStrategy<BestFitAllocationStrategy>(block_device);
+}
+
+template <>
+AllocationManager* create_allocation_manager<PackedAllocationStrategy<ExtentAllocationStrategy>>(BlockDevice* block_device) {
+    return new PackedAllocationStrategy<ExtentAllocationStrategy>(block_device);
+}
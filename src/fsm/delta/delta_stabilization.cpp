@@ -0,0 +1,332 @@
+/**
+ * This file is part of the Succinct Filesystem project.
+ *
+ * Copyright (c) 2026 Sebastian Brunnert <mail@sebastianbrunnert.de>
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "delta_stabilization.hpp"
+#include <cstring>
+
+uint32_t DeltaStabilization::priority(uint32_t id) {
+    // Finalizer of MurmurHash3, which spreads consecutive ids over the whole range
+    id ^= id >> 16;
+    id *= 0x85ebca6bu;
+    id ^= id >> 13;
+    id *= 0xc2b2ae35u;
+    id ^= id >> 16;
+    return id;
+}
+
+void DeltaStabilization::update(uint32_t id) {
+    subtree_size[id] = get_size(left[id]) + get_size(right[id]) + 1;
+    if (left[id] != NONE) {
+        parent[left[id]] = id;
+    }
+    if (right[id] != NONE) {
+        parent[right[id]] = id;
+    }
+}
+
+void DeltaStabilization::split(uint32_t id, size_t count, uint32_t& first, uint32_t& second) {
+    if (id == NONE) {
+        first = NONE;
+        second = NONE;
+        return;
+    }
+
+    uint32_t child_first, child_second;
+    if (get_size(left[id]) < count) {
+        // The id and its left subtree belong to the first part
+        split(right[id], count - get_size(left[id]) - 1, child_first, child_second);
+        right[id] = child_first;
+        update(id);
+        first = id;
+        second = child_second;
+    } else {
+        split(left[id], count, child_first, child_second);
+        left[id] = child_second;
+        update(id);
+        first = child_first;
+        second = id;
+    }
+}
+
+uint32_t DeltaStabilization::merge(uint32_t first, uint32_t second) {
+    if (first == NONE) {
+        return second;
+    }
+    if (second == NONE) {
+        return first;
+    }
+
+    if (priority(first) > priority(second)) {
+        uint32_t child = merge(right[first], second);
+        right[first] = child;
+        update(first);
+        return first;
+    }
+    uint32_t child = merge(first, left[second]);
+    left[second] = child;
+    update(second);
+    return second;
+}
+
+void DeltaStabilization::build(const std::vector<uint32_t>& ids) {
+    // The ids on the right spine of the treap built so far, from the root downwards
+    std::vector<uint32_t> spine;
+    for (uint32_t id : ids) {
+        left[id] = NONE;
+        right[id] = NONE;
+        uint32_t last = NONE;
+        while (!spine.empty() && priority(spine.back()) < priority(id)) {
+            last = spine.back();
+            spine.pop_back();
+        }
+        left[id] = last;
+        if (!spine.empty()) {
+            right[spine.back()] = id;
+        }
+        spine.push_back(id);
+    }
+    root = spine.empty() ? NONE : spine.front();
+
+    // Every id comes after its children in the reverse order of a preorder traversal, so the subtree sizes are computed bottom up
+    std::vector<uint32_t> order;
+    order.reserve(ids.size());
+    std::vector<uint32_t> stack;
+    if (root != NONE) {
+        stack.push_back(root);
+        parent[root] = NONE;
+    }
+    while (!stack.empty()) {
+        uint32_t id = stack.back();
+        stack.pop_back();
+        order.push_back(id);
+        if (left[id] != NONE) {
+            stack.push_back(left[id]);
+        }
+        if (right[id] != NONE) {
+            stack.push_back(right[id]);
+        }
+    }
+    for (auto it = order.rbegin(); it != order.rend(); it++) {
+        update(*it);
+    }
+}
+
+uint32_t DeltaStabilization::allocate_id() {
+    std::lock_guard<std::mutex> lock(lookup_mutex);
+    trim_free_ids();
+    if (!free_ids.empty()) {
+        uint32_t id = *free_ids.begin();
+        free_ids.erase(free_ids.begin());
+        return id;
+    }
+
+    left.push_back(NONE);
+    right.push_back(NONE);
+    parent.push_back(NONE);
+    subtree_size.push_back(0);
+    generation.push_back(0);
+    return (uint32_t) (left.size() - 1);
+}
+
+void DeltaStabilization::trim_free_ids() {
+    while (!free_ids.empty() && *free_ids.rbegin() == generation.size() - 1) {
+        free_ids.erase(std::prev(free_ids.end()));
+        left.pop_back();
+        right.pop_back();
+        parent.pop_back();
+        subtree_size.pop_back();
+        generation.pop_back();
+    }
+}
+
+uint32_t DeltaStabilization::select(size_t flouds_inode) const {
+    uint32_t id = root;
+    while (true) {
+        size_t left_size = get_size(left[id]);
+        if (flouds_inode < left_size) {
+            id = left[id];
+        } else if (flouds_inode == left_size) {
+            return id;
+        } else {
+            flouds_inode -= left_size + 1;
+            id = right[id];
+        }
+    }
+}
+
+size_t DeltaStabilization::rank(uint32_t id) const {
+    size_t position = get_size(left[id]);
+    while (parent[id] != NONE) {
+        uint32_t parent_id = parent[id];
+        if (right[parent_id] == id) {
+            position += get_size(left[parent_id]) + 1;
+        }
+        id = parent_id;
+    }
+    return position;
+}
+
+void DeltaStabilization::reset(size_t nodes) {
+    left.assign(nodes, NONE);
+    right.assign(nodes, NONE);
+    parent.assign(nodes, NONE);
+    subtree_size.assign(nodes, 0);
+    generation.assign(nodes, 0);
+    free_ids.clear();
+    lookup_counts.clear();
+    retired_ids.clear();
+
+    std::vector<uint32_t> ids(nodes);
+    for (size_t i = 0; i < nodes; i++) {
+        ids[i] = (uint32_t) i;
+    }
+    build(ids);
+}
+
+void DeltaStabilization::record_insert(uint64_t inode) {
+    uint32_t id = allocate_id();
+    left[id] = NONE;
+    right[id] = NONE;
+    update(id);
+
+    uint32_t first, second;
+    split(root, inode, first, second);
+    root = merge(merge(first, id), second);
+    parent[root] = NONE;
+}
+
+void DeltaStabilization::record_remove(uint64_t inode) {
+    uint32_t first, rest, removed, second;
+    split(root, inode, first, rest);
+    split(rest, 1, removed, second);
+    root = merge(first, second);
+    if (root != NONE) {
+        parent[root] = NONE;
+    }
+
+    std::lock_guard<std::mutex> lock(lookup_mutex);
+    uint64_t stable_inode = ((uint64_t) generation[removed] << 32) | (removed + 1);
+    subtree_size[removed] = 0;
+    generation[removed]++;
+    if (lookup_counts.count(stable_inode) > 0) {
+        // The kernel may still ask for the stable inode, so the id must not belong to another node yet
+        retired_ids.insert(removed);
+    } else {
+        free_ids.insert(removed);
+        trim_free_ids();
+    }
+}
+
+void DeltaStabilization::record_lookup(uint64_t stable_inode, uint64_t count) {
+    std::lock_guard<std::mutex> lock(lookup_mutex);
+    lookup_counts[stable_inode] += count;
+}
+
+void DeltaStabilization::record_forget(uint64_t stable_inode, uint64_t count) {
+    std::lock_guard<std::mutex> lock(lookup_mutex);
+    auto it = lookup_counts.find(stable_inode);
+    if (it == lookup_counts.end()) {
+        return;
+    }
+    if (it->second > count) {
+        it->second -= count;
+        return;
+    }
+    lookup_counts.erase(it);
+
+    // The id of a removed node can be reused now. The treap is only shrunk by operations that hold exclusive access.
+    uint32_t id = (uint32_t) ((stable_inode & UINT32_MAX) - 1);
+    if (retired_ids.erase(id) > 0) {
+        free_ids.insert(id);
+    }
+}
+
+size_t DeltaStabilization::get_referenced_inodes() {
+    std::lock_guard<std::mutex> lock(lookup_mutex);
+    return lookup_counts.size();
+}
+
+std::optional<uint64_t> DeltaStabilization::stable_inode_to_flouds_inode(uint64_t stable_inode) const {
+    uint64_t id_number = stable_inode & UINT32_MAX;
+    if (id_number == 0 || id_number > left.size()) {
+        return std::nullopt;
+    }
+
+    uint32_t id = (uint32_t) (id_number - 1);
+    if (subtree_size[id] == 0 || generation[id] != stable_inode >> 32) {
+        // The node was removed, possibly the id belongs to another node by now
+        return std::nullopt;
+    }
+    return rank(id);
+}
+
+uint64_t DeltaStabilization::flouds_inode_to_stable_inode(uint64_t flouds_inode) const {
+    uint32_t id = select(flouds_inode);
+    return ((uint64_t) generation[id] << 32) | (id + 1);
+}
+
+void DeltaStabilization::serialize(char* buffer, size_t* offset) {
+    // The ids are stored in the order of their FLOUDS inodes, the treap is built again from them
+    size_t nodes = get_size(root);
+    std::memcpy(buffer + *offset, &nodes, sizeof(size_t));
+    *offset += sizeof(size_t);
+    std::vector<uint32_t> stack;
+    uint32_t id = root;
+    while (id != NONE || !stack.empty()) {
+        while (id != NONE) {
+            stack.push_back(id);
+            id = left[id];
+        }
+        id = stack.back();
+        stack.pop_back();
+        std::memcpy(buffer + *offset, &id, sizeof(uint32_t));
+        *offset += sizeof(uint32_t);
+        id = right[id];
+    }
+
+    size_t capacity = generation.size();
+    std::memcpy(buffer + *offset, &capacity, sizeof(size_t));
+    *offset += sizeof(size_t);
+    std::memcpy(buffer + *offset, generation.data(), capacity * sizeof(uint32_t));
+    *offset += capacity * sizeof(uint32_t);
+}
+
+void DeltaStabilization::deserialize(const char* buffer, size_t* offset) {
+    size_t nodes;
+    std::memcpy(&nodes, buffer + *offset, sizeof(size_t));
+    *offset += sizeof(size_t);
+    std::vector<uint32_t> ids(nodes);
+    std::memcpy(ids.data(), buffer + *offset, nodes * sizeof(uint32_t));
+    *offset += nodes * sizeof(uint32_t);
+
+    size_t capacity;
+    std::memcpy(&capacity, buffer + *offset, sizeof(size_t));
+    *offset += sizeof(size_t);
+    generation.resize(capacity);
+    std::memcpy(generation.data(), buffer + *offset, capacity * sizeof(uint32_t));
+    *offset += capacity * sizeof(uint32_t);
+
+    left.assign(capacity, NONE);
+    right.assign(capacity, NONE);
+    parent.assign(capacity, NONE);
+    subtree_size.assign(capacity, 0);
+    build(ids);
+
+    // All ids that are not in the treap can be reused, the kernel does not know any inodes after a mount
+    lookup_counts.clear();
+    retired_ids.clear();
+    free_ids.clear();
+    for (uint32_t id = 0; id < capacity; id++) {
+        if (subtree_size[id] == 0) {
+            free_ids.insert(id);
+        }
+    }
+}
+
+size_t DeltaStabilization::get_serialized_size() {
+    return 2 * sizeof(size_t) + (get_size(root) + generation.size()) * sizeof(uint32_t);
+}
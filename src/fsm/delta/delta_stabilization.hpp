@@ -1,128 +1,177 @@
 /**
  * This file is part of the Succinct Filesystem project.
- * 
+ *
  * Copyright (c) 2026 Sebastian Brunnert <mail@sebastianbrunnert.de>
  * SPDX-License-Identifier: GPL-2.0-only
  */
 
+#pragma once
+
+#include <cstddef>
 #include <cstdint>
+#include <mutex>
 #include <optional>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
+#include "../../serialization/serializable.hpp"
 
 /**
- * This class implements the delta stabilization mechanism for FLOUDS. 
- * It keeps track of all insert and remove operations. When converting between stable inodes (used by FUSE) and FLOUDS inodes, it uses the log of operation to adjust accordingly. 
- * It also encodes the position within the log.
+ * This class implements the delta stabilization mechanism for FLOUDS.
+ * Every FLOUDS node gets a permanent id when it is inserted. The ids are kept in the order of the FLOUDS nodes in a treap whose nodes are the ids themselves, so both directions are translated in O(log n) expected time:
+ * The FLOUDS inode of an id is the number of ids before it, which is summed up on the way to the root. The id of a FLOUDS inode is found by descending along the subtree sizes.
+ * Ids of removed nodes are reused, so each id has a generation that is part of the stable inode and makes inodes of removed nodes stale.
+ * The root always has the id 0 in generation 0, which is the stable inode 1 that FUSE expects.
+ * The kernel keeps inodes until it forgets them, so the ids of removed nodes that the kernel still knows are only reused after it forgot them.
  */
-class DeltaStabilization {
+class DeltaStabilization : public Serializable {
 private:
-    #ifdef DELTA_STABILIZATION
-    /**
-     * This struct represents an operation (insert or remove) that has been performed on the FLOUDS filesystem.
-     */
-    struct DeltaOperation {
-        bool is_insert;
-        // The inode in the FLOUDS structure
-        uint64_t inode;
-    };
-
-    // Log of operations
-    std::vector<DeltaOperation> operations;
-    uint64_t first_operation_index = 0;
-    uint64_t next_operation_index = 0;
-    #endif
-
-    void append_operation(bool is_insert, uint64_t inode) {
-        #ifdef DELTA_STABILIZATION
-        if (operations.size() >= 256) {
-            operations.erase(operations.begin());
-            first_operation_index++;
-        }
-
-        operations.push_back({is_insert, inode});
-        next_operation_index++;
-
-        // Handle overflow of operation index. Old inodes should be already be invalid at this point
-        if (next_operation_index > (1ULL << 16) - 1) {
-            first_operation_index = 0;
-            next_operation_index = 0;
-        }
-        #endif
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    // The treap, indexed by the id. Unused ids have a subtree size of 0.
+    std::vector<uint32_t> left;
+    std::vector<uint32_t> right;
+    std::vector<uint32_t> parent;
+    std::vector<uint32_t> subtree_size;
+    // Incremented when the id is released
+    std::vector<uint32_t> generation;
+    uint32_t root = NONE;
+
+    // Released ids. The smallest one is reused first, so replaying the journal assigns the same ids again.
+    std::set<uint32_t> free_ids;
+
+    // Number of times the kernel received each stable inode in an entry and did not forget it yet
+    std::unordered_map<uint64_t, uint64_t> lookup_counts;
+    // Ids of removed nodes that the kernel still knows
+    std::unordered_set<uint32_t> retired_ids;
+    // Guards the lookup counts and the free and retired ids, as the kernel forgets inodes concurrently to other requests
+    std::mutex lookup_mutex;
+
+    /**
+     * @return The priority of an id in the treap. It is derived from the id, so the shape of the treap does not have to be stored.
+     */
+    static uint32_t priority(uint32_t id);
+
+    uint32_t get_size(uint32_t id) const {
+        return id == NONE ? 0 : subtree_size[id];
     }
 
-public:
+    /**
+     * Recomputes the subtree size of an id and sets it as parent of its children.
+     */
+    void update(uint32_t id);
+
+    /**
+     * Splits a treap into the first count ids and the rest.
+     */
+    void split(uint32_t id, size_t count, uint32_t& first, uint32_t& second);
+
+    /**
+     * Concatenates two treaps.
+     *
+     * @return The root of the concatenated treap.
+     */
+    uint32_t merge(uint32_t first, uint32_t second);
+
+    /**
+     * Builds the treap from the ids in the order of their FLOUDS inodes in linear time.
+     */
+    void build(const std::vector<uint32_t>& ids);
+
+    /**
+     * @return An unused id.
+     */
+    uint32_t allocate_id();
+
+    /**
+     * Shrinks the treap by the free ids at its end. Their generations are dropped, which is safe as the kernel does not know them anymore. The lookup lock must be held.
+     */
+    void trim_free_ids();
+
+    /**
+     * @return The id of the FLOUDS inode.
+     */
+    uint32_t select(size_t flouds_inode) const;
+
+    /**
+     * @return The FLOUDS inode of the id.
+     */
+    size_t rank(uint32_t id) const;
 
+public:
     /**
-     * This function records an insert operation for a given FLOUDS inode.
+     * @param nodes The number of FLOUDS nodes, which get the ids 0 to nodes - 1 in their order.
      */
-    void record_insert(uint64_t inode) {
-        append_operation(true, inode);
+    DeltaStabilization(size_t nodes = 1) {
+        reset(nodes);
     }
 
     /**
-     * This function records a remove operation for a given FLOUDS inode.
+     * Forgets all ids and numbers the FLOUDS nodes in their order. Used for filesystems that did not store stable inodes yet.
+     *
+     * @param nodes The number of FLOUDS nodes.
+     */
+    void reset(size_t nodes);
+
+    /**
+     * This function records an insert operation for a given FLOUDS inode. The new node gets an unused id and the following nodes keep theirs.
+     */
+    void record_insert(uint64_t inode);
+
+    /**
+     * This function records a remove operation for a given FLOUDS inode. The stable inode of the node becomes stale.
+     */
+    void record_remove(uint64_t inode);
+
+    /**
+     * Counts that the kernel received a stable inode in an entry, e.g. from lookup, create or readdirplus.
+     * May be called concurrently with the conversions and record_forget.
+     * 
+     * @param stable_inode The stable inode number.
+     * @param count The number of lookups.
+     */
+    void record_lookup(uint64_t stable_inode, uint64_t count = 1);
+
+    /**
+     * Counts that the kernel forgot lookups of a stable inode. The id of a removed node is reused once the kernel forgot all its lookups.
+     * May be called concurrently with the conversions and record_lookup.
+     * 
+     * @param stable_inode The stable inode number.
+     * @param count The number of lookups that are forgotten.
+     */
+    void record_forget(uint64_t stable_inode, uint64_t count);
+
+    /**
+     * @return The number of stable inodes the kernel currently knows.
+     */
+    size_t get_referenced_inodes();
+
+    /**
+     * @return The number of ids, including the free ones.
      */
-    void record_remove(uint64_t inode) {
-        append_operation(false, inode);
+    size_t get_capacity() const {
+        return generation.size();
     }
 
     /**
      * This function converts a stable inode (used by FUSE) to a FLOUDS inode.
-     * 
+     *
      * @param stable_inode The stable inode number that FUSE uses.
-     * @return The corresponding FLOUDS inode number.
-     */
-    std::optional<uint64_t> stable_inode_to_flouds_inode(uint64_t stable_inode) {
-        #ifdef DELTA_STABILIZATION
-        if (stable_inode == 1) {
-            return 0;
-        }
-
-        uint64_t log_position = stable_inode >> 48;
-        uint64_t inode_number = stable_inode & ((1ULL << 48) - 1);
-
-        // Check if the log position is still valid
-        if (log_position < first_operation_index || log_position > next_operation_index) {
-            return std::nullopt;
-        }
-
-        uint64_t flouds_position = inode_number - 1;
-        size_t operation_offset = static_cast<size_t>(log_position - first_operation_index);
-
-        // Calculate what happened between log_position and now and adjust accordingly
-        for (size_t i = operation_offset; i < operations.size(); i++) {
-            if (operations[i].is_insert && operations[i].inode <= flouds_position) {
-                flouds_position++;
-            } else if (!operations[i].is_insert) {
-                if (operations[i].inode == flouds_position) {
-                    return std::nullopt;
-                }
-
-                if (operations[i].inode < flouds_position) {
-                    flouds_position--;
-                }
-            }
-        }
-
-        return flouds_position;
-        #else 
-        return stable_inode - 1;
-        #endif
-    }
+     * @return The corresponding FLOUDS inode number or nothing if the node was removed.
+     */
+    std::optional<uint64_t> stable_inode_to_flouds_inode(uint64_t stable_inode) const;
 
     /**
      * This function converts a FLOUDS inode to a stable inode.
-     * 
-     * @param flouds_inode The inode number used internally by FLOUDS.
+     *
+     * @param flouds_inode The inode number used internally by FLOUDS. Must be a valid node index.
      * @return The corresponding stable inode number that FUSE should use.
      */
-    uint64_t flouds_inode_to_stable_inode(uint64_t flouds_inode) {
-        #ifdef DELTA_STABILIZATION
-        uint64_t inode_number = flouds_inode + 1;
-        return (next_operation_index << 48) | inode_number;
-        #else 
-        return flouds_inode + 1;
-        #endif
-    }
+    uint64_t flouds_inode_to_stable_inode(uint64_t flouds_inode) const;
+
+    virtual void serialize(char* buffer, size_t* offset) override;
+    virtual void deserialize(const char* buffer, size_t* offset) override;
+    virtual size_t get_serialized_size() override;
 
-};
\ No newline at end of file
+};
@@ -6,28 +6,44 @@
  */
 
 #include "file_system_manager.hpp"
+#include <atomic>
 #include <cstring>
-#include <iostream>
+#include <stdexcept>
 
 FileSystemManager::FileSystemManager() 
-    : flouds(nullptr), block_device(nullptr), allocation_manager(nullptr) {
+    : flouds(nullptr), block_device(nullptr), allocation_manager(nullptr), inode_manager(nullptr), delta_stabilization(nullptr) {
     std::memset(&header, 0, sizeof(FloudsHeader));
 }
 
 FileSystemManager::~FileSystemManager() {
+    #ifdef DELAYED_ALLOCATION
+    delete page_cache;
+    #endif
+    delete journal;
+    delete delta_stabilization;
     delete flouds;
     delete allocation_manager;
     delete block_device;
 }
 
-void FileSystemManager::mount(std::string path) {
-    this->block_device = new BlockDevice(path);
-    this->allocation_manager = create_allocation_manager<BestFitAllocationStrategy>(block_device);
+void FileSystemManager::mount(std::string path, BlockDeviceBackend backend) {
+    if (backend == BlockDeviceBackend::MMAP) {
+        this->block_device = new MappedBlockDevice(path);
+    } else if (backend != BlockDeviceBackend::FILE) {
+        this->block_device = new IoUringBlockDevice(path, backend == BlockDeviceBackend::IO_URING_DIRECT);
+    } else if (BLOCK_CACHE_BLOCKS > 0) {
+        this->block_device = new CachedBlockDevice(path, BLOCK_CACHE_BLOCKS);
+    } else {
+        this->block_device = new BlockDevice(path);
+    }
+    this->allocation_manager = create_allocation_manager<FileSystemAllocationStrategy>(block_device);
     this->flouds = create_flouds();
     this->inode_manager = create_inode_manager<ArrayInodeManagerStrategy>(allocation_manager);
+    this->delta_stabilization = new DeltaStabilization();
 
-    this->delayed_write = new DelayedWrite{0, 0, 0};
-    this->delayed_write_buffer = new char[block_device->get_block_size() * 16]; // Buffer for delayed writes, can hold up to 16 blocks of data
+    #ifdef DELAYED_ALLOCATION
+    this->page_cache = new PageCache(block_device->get_block_size());
+    #endif
 
     char* buffer = new char[block_device->get_block_size()];
     block_device->read_block(0, buffer);
@@ -39,6 +55,7 @@ void FileSystemManager::mount(std::string path) {
         // Initialize new filesystem
         std::memset(&header, 0, sizeof(FloudsHeader));
         std::memcpy(header.magic, "FLOUDS", 6);
+        header.version = FLOUDS_VERSION;
         
         header.allocation_manager_size = 0;
         header.allocation_manager_handle = 0;
@@ -46,110 +63,538 @@ void FileSystemManager::mount(std::string path) {
         header.flouds_size = 0;
         header.inode_manager_handle = 0;
         header.inode_manager_size = 0;
-
+        header.delta_stabilization_handle = 0;
+        header.delta_stabilization_size = 0;
+        header.allocation_manager_shadow_handle = 0;
+        header.allocation_manager_shadow_size = 0;
+        header.flouds_shadow_handle = 0;
+        header.flouds_shadow_size = 0;
+        header.inode_manager_shadow_handle = 0;
+        header.inode_manager_shadow_size = 0;
+        header.delta_stabilization_shadow_handle = 0;
+        header.delta_stabilization_shadow_size = 0;
+
+        create_journal();
         this->save();
     } else {
         // Load existing filesystem
         std::memcpy(&header, buffer, sizeof(FloudsHeader));
+        if (header.version < 3) {
+            // Filesystems that overwrite their components in place get the second copies with their next checkpoint
+            header.allocation_manager_shadow_handle = 0;
+            header.allocation_manager_shadow_size = 0;
+            header.flouds_shadow_handle = 0;
+            header.flouds_shadow_size = 0;
+            header.inode_manager_shadow_handle = 0;
+            header.inode_manager_shadow_size = 0;
+            header.delta_stabilization_shadow_handle = 0;
+            header.delta_stabilization_shadow_size = 0;
+        }
 
-        // Load allocation manager
-        char* allocation_manager_buffer = new char[header.allocation_manager_size];
-        allocation_manager->read(header.allocation_manager_handle, allocation_manager_buffer, header.allocation_manager_size, 0);
-        size_t offset = 0;
-        allocation_manager->deserialize(allocation_manager_buffer, &offset);
-        delete[] allocation_manager_buffer;
-
-        // Load FLOUDS
-        char* flouds_buffer = new char[header.flouds_size];
-        allocation_manager->read(header.flouds_handle, flouds_buffer, header.flouds_size, 0);
-        offset = 0;
-        flouds->deserialize(flouds_buffer, &offset);
-        delete[] flouds_buffer;
+        // The allocation manager is loaded first, as the other components are read through it
+        read_component(allocation_manager, header.allocation_manager_handle, header.allocation_manager_size, allocation_manager_checkpoint);
+        read_component(flouds, header.flouds_handle, header.flouds_size, flouds_checkpoint);
+        read_component(inode_manager, header.inode_manager_handle, header.inode_manager_size, inode_manager_checkpoint);
+
+        if (header.version >= 2) {
+            // Load stable inode numbers
+            read_component(delta_stabilization, header.delta_stabilization_handle, header.delta_stabilization_size, delta_stabilization_checkpoint);
+        } else {
+            // Filesystems without stable inode numbers number their nodes in the current order
+            header.delta_stabilization_handle = 0;
+            header.delta_stabilization_size = 0;
+            delta_stabilization->reset(flouds->size());
+        }
 
-        // Load inode manager
-        char* inode_manager_buffer = new char[header.inode_manager_size];
-        allocation_manager->read(header.inode_manager_handle, inode_manager_buffer, header.inode_manager_size, 0);
-        offset = 0;
-        inode_manager->deserialize(inode_manager_buffer, &offset);
-        delete[] inode_manager_buffer;
+        if (header.version < 1) {
+            // Filesystems without a journal get one on their first mount
+            header.version = FLOUDS_VERSION;
+            create_journal();
+            this->save();
+        } else {
+            // Replay the operations that happened after the last checkpoint
+            journal = new Journal(allocation_manager, header.journal_handle, header.journal_size, header.journal_generation);
+            std::vector<JournalRecord> records = journal->read();
+            replaying = true;
+            allocation_manager->set_replaying(true);
+            for (const JournalRecord& record : records) {
+                replay(record);
+            }
+            allocation_manager->set_replaying(false);
+            replaying = false;
+
+            if (!records.empty() || header.version < FLOUDS_VERSION) {
+                header.version = FLOUDS_VERSION;
+                this->save();
+            }
+        }
     }
 
     delete[] buffer;
+    operations_since_checkpoint = 0;
+    last_checkpoint = std::chrono::steady_clock::now();
 }
 
 void FileSystemManager::unmount() {
+    this->save();
+}
+
+void FileSystemManager::save() {
     #ifdef DELAYED_ALLOCATION
-    flush_delayed_write();
+    // The checkpoint should contain the allocations of all written data
+    flush_page_cache();
     #endif
 
-    this->save();
+    // Reserved space is not part of the checkpoint, so it is released before the allocation manager is written
+    allocation_manager->trim_all();
+
+    operations_since_checkpoint = 0;
+    checkpoint_required = false;
+    last_checkpoint = std::chrono::steady_clock::now();
+
+    if (!flouds_checkpoint.dirty && !inode_manager_checkpoint.dirty && !allocation_manager_checkpoint.dirty && !delta_stabilization_checkpoint.dirty) {
+        return;
+    }
+
+    if (flouds_checkpoint.dirty) {
+        write_component(flouds, header.flouds_handle, header.flouds_size, header.flouds_shadow_handle, header.flouds_shadow_size, flouds_checkpoint);
+    }
+
+    if (inode_manager_checkpoint.dirty) {
+        write_component(inode_manager, header.inode_manager_handle, header.inode_manager_size, header.inode_manager_shadow_handle, header.inode_manager_shadow_size, inode_manager_checkpoint);
+    }
+
+    if (delta_stabilization_checkpoint.dirty) {
+        write_component(delta_stabilization, header.delta_stabilization_handle, header.delta_stabilization_size, header.delta_stabilization_shadow_handle, header.delta_stabilization_shadow_size, delta_stabilization_checkpoint);
+    }
+
+    // Writing the other components may have changed the allocations, so the allocation manager is always written last
+    write_component(allocation_manager, header.allocation_manager_handle, header.allocation_manager_size, header.allocation_manager_shadow_handle, header.allocation_manager_shadow_size, allocation_manager_checkpoint);
+
+    // All journaled operations are part of the checkpoint now
+    header.journal_generation++;
+    journal->reset(header.journal_generation);
+
+    // The components have to be on the block device before the header points to them. Until the header is written, it points to the copies of the last checkpoint, which match the journal.
+    block_device->flush();
+    write_header();
+    block_device->flush();
 }
 
-void FileSystemManager::save() {
-    // Write FLOUDS data
-    size_t flouds_size = flouds->get_serialized_size();
-    size_t flouds_handle = (header.flouds_handle == 0) ? allocation_manager->allocate(flouds_size) : allocation_manager->resize(header.flouds_handle, header.flouds_size, flouds_size);
-    char* flouds_buffer = new char[flouds_size];
+void FileSystemManager::write_header() {
+    char* buffer = new char[block_device->get_block_size()];
+    std::memset(buffer, 0, block_device->get_block_size());
+    std::memcpy(buffer, &header, sizeof(FloudsHeader));
+    block_device->write_block(0, buffer);
+    delete[] buffer;
+}
+
+void FileSystemManager::create_journal() {
+    header.journal_size = JOURNAL_SIZE;
+    header.journal_handle = allocation_manager->allocate(JOURNAL_SIZE);
+    header.journal_generation = 0;
+    journal = new Journal(allocation_manager, header.journal_handle, header.journal_size, header.journal_generation);
+    allocation_manager_checkpoint.dirty = true;
+}
+
+void FileSystemManager::log(const JournalRecord& record) {
+    if (replaying) return;
+
+    std::lock_guard<std::mutex> lock(journal_mutex);
+    if (!journal->append(record)) {
+        // The journal is full, so the operation and all following ones become part of the next checkpoint instead.
+        // Writes of other files may be running, so the checkpoint cannot be written here.
+        checkpoint_required = true;
+    }
+}
+
+void FileSystemManager::replay(const JournalRecord& record) {
+    switch (record.operation) {
+        case JournalOperation::INSERT_NODE: {
+            Inode* inode = inode_manager->get_inode(add_node(record.node, record.name, record.is_folder, record.mode));
+            inode->access_time = record.modification_time;
+            inode->creation_time = record.modification_time;
+            inode->modification_time = record.modification_time;
+            break;
+        }
+        case JournalOperation::REMOVE_NODE:
+            remove_node(record.node);
+            break;
+        case JournalOperation::SET_SIZE:
+        case JournalOperation::EXTEND_SIZE: {
+            Inode* inode = inode_manager->get_inode(record.node);
+            if (record.operation == JournalOperation::SET_SIZE) {
+                resize_allocation(record.node, inode, record.size);
+            } else {
+                extend_allocation(record.node, inode, record.size);
+            }
+            // The allocation strategies are deterministic, so the same space is allocated again. Otherwise the allocations do not match the data on the block device anymore.
+            if (inode->allocation_handle != record.allocation_handle) {
+                throw std::runtime_error("Journal replay allocated a different handle for node " + std::to_string(record.node));
+            }
+            break;
+        }
+        case JournalOperation::FILL_RANGE:
+            fill_allocation(record.node, inode_manager->get_inode(record.node), record.size, record.offset);
+            break;
+        case JournalOperation::PUNCH_HOLE:
+            // The partial blocks at the edges were zeroed before the crash and may have been written since
+            punch_allocation(record.node, inode_manager->get_inode(record.node), record.size, record.offset);
+            break;
+        case JournalOperation::WRITE_INLINE:
+            write_data(record.node, inode_manager->get_inode(record.node), record.data.data(), record.data.size(), record.offset);
+            break;
+        case JournalOperation::SET_MODE:
+            set_mode(record.node, record.mode);
+            break;
+        case JournalOperation::SET_TIMES:
+            set_times(record.node, record.access_time, record.modification_time);
+            break;
+    }
+}
+
+void FileSystemManager::resize_allocation(size_t inode, Inode* node, size_t size) {
+    std::lock_guard<std::mutex> lock(resize_mutex);
+    bool moved_inline = false;
+    if (node->allocation_handle == 0 && size <= INLINE_DATA_SIZE) {
+        // Small files keep their data inline with the inode
+        inode_manager->get_inline_data(inode).resize(size, '\0');
+    } else if (node->allocation_handle == 0) {
+        // The file outgrows its inode, so its data moves to allocated blocks
+        node->allocation_handle = allocation_manager->allocate(size);
+        move_inline_data(inode, node);
+    } else if (size == 0 || (size < node->size && size <= INLINE_DATA_SIZE)) {
+        // A file that shrinks into its inode does not need blocks anymore and stores its data inline again
+        std::string& data = inode_manager->get_inline_data(inode);
+        data.resize(size);
+        if (size > 0) {
+            allocation_manager->read(node->allocation_handle, data.data(), size, 0);
+        }
+        allocation_manager->free(node->allocation_handle, node->size);
+        node->allocation_handle = 0;
+        moved_inline = size > 0;
+    } else if (size > node->size) {
+        // Files usually grow by appending, so space is reserved for the following writes
+        node->allocation_handle = allocation_manager->grow(node->allocation_handle, node->size, size);
+    } else {
+        node->allocation_handle = allocation_manager->resize(node->allocation_handle, node->size, size);
+    }
+    node->size = size;
+    inode_manager_checkpoint.dirty = true;
+    allocation_manager_checkpoint.dirty = true;
+
+    JournalRecord record{JournalOperation::SET_SIZE};
+    record.node = inode;
+    record.size = size;
+    record.allocation_handle = node->allocation_handle;
+    log(record);
+
+    if (moved_inline) {
+        // The freed blocks may be reused before the next checkpoint, so replaying the resize cannot read the data from them
+        JournalRecord data_record{JournalOperation::WRITE_INLINE};
+        data_record.node = inode;
+        data_record.offset = 0;
+        data_record.data = inode_manager->get_inline_data(inode);
+        log(data_record);
+    }
+}
+
+void FileSystemManager::extend_allocation(size_t inode, Inode* node, size_t size) {
+    std::lock_guard<std::mutex> lock(resize_mutex);
+    size_t old_size = node->size;
+    if (node->allocation_handle == 0 && size <= INLINE_DATA_SIZE) {
+        inode_manager->get_inline_data(inode).resize(size, '\0');
+    } else if (node->allocation_handle == 0) {
+        // Only the inline data is allocated, the rest of the file becomes a hole
+        node->allocation_handle = allocation_manager->allocate_sparse(size);
+        allocation_manager->fill(node->allocation_handle, node->size, 0, false);
+        move_inline_data(inode, node);
+    } else {
+        node->allocation_handle = allocation_manager->extend(node->allocation_handle, node->size, size);
+    }
+    if (node->allocation_handle != 0) {
+        // The last block keeps the bytes behind the old end, added blocks may contain data of freed allocations unless they are holes
+        size_t block_size = block_device->get_block_size();
+        size_t end = allocation_manager->supports_holes() ? std::min(size, (old_size + block_size - 1) / block_size * block_size) : size;
+        zero_allocation(node, end - std::min(end, old_size), old_size);
+    }
+    node->size = size;
+    inode_manager_checkpoint.dirty = true;
+    allocation_manager_checkpoint.dirty = true;
+
+    JournalRecord record{JournalOperation::EXTEND_SIZE};
+    record.node = inode;
+    record.size = size;
+    record.allocation_handle = node->allocation_handle;
+    log(record);
+}
+
+void FileSystemManager::move_inline_data(size_t inode, Inode* node) {
+    std::string& data = inode_manager->get_inline_data(inode);
+    if (!replaying && !data.empty()) {
+        // During replay, the blocks already contain the data and possibly newer writes
+        allocation_manager->write(node->allocation_handle, data.data(), data.size(), 0);
+    }
+    std::string().swap(data);
+}
+
+void FileSystemManager::read_data(size_t inode, Inode* node, char* buffer, size_t size, size_t offset) {
+    if (node->allocation_handle != 0) {
+        allocation_manager->read(node->allocation_handle, buffer, size, offset);
+        return;
+    }
+
+    const std::string& data = inode_manager->get_inline_data(inode);
+    size_t stored = offset < data.size() ? std::min(size, data.size() - offset) : 0;
+    std::memcpy(buffer, data.data() + offset, stored);
+    std::memset(buffer + stored, 0, size - stored);
+}
+
+void FileSystemManager::write_data(size_t inode, Inode* node, const char* buffer, size_t size, size_t offset) {
+    if (node->allocation_handle != 0) {
+        allocation_manager->write(node->allocation_handle, buffer, size, offset);
+        return;
+    }
+
+    // The inline data is only written with the inode table, so it is part of the journal until the next checkpoint
+    std::memcpy(inode_manager->get_inline_data(inode).data() + offset, buffer, size);
+    inode_manager_checkpoint.dirty = true;
+
+    JournalRecord record{JournalOperation::WRITE_INLINE};
+    record.node = inode;
+    record.offset = offset;
+    record.data.assign(buffer, size);
+    log(record);
+}
+
+void FileSystemManager::zero_allocation(Inode* node, size_t size, size_t offset) {
+    // During replay, the blocks may contain newer data already
+    if (replaying || size == 0) {
+        return;
+    }
+    std::vector<char> zeros(std::min<size_t>(size, RELOCATION_CHUNK_SIZE), 0);
+    for (size_t done = 0; done < size; done += zeros.size()) {
+        allocation_manager->write(node->allocation_handle, zeros.data(), std::min(zeros.size(), size - done), offset + done);
+    }
+}
+
+void FileSystemManager::fill_allocation(size_t inode, Inode* node, size_t size, size_t offset) {
+    std::lock_guard<std::mutex> lock(resize_mutex);
+    if (node->allocation_handle == 0 || !allocation_manager->fill(node->allocation_handle, size, offset, true)) {
+        return;
+    }
+    allocation_manager_checkpoint.dirty = true;
+
+    JournalRecord record{JournalOperation::FILL_RANGE};
+    record.node = inode;
+    record.size = size;
+    record.offset = offset;
+    log(record);
+}
+
+void FileSystemManager::punch_allocation(size_t inode, Inode* node, size_t size, size_t offset) {
+    std::lock_guard<std::mutex> lock(resize_mutex);
+    allocation_manager->punch_hole(node->allocation_handle, size, offset);
+    allocation_manager_checkpoint.dirty = true;
+
+    JournalRecord record{JournalOperation::PUNCH_HOLE};
+    record.node = inode;
+    record.size = size;
+    record.offset = offset;
+    log(record);
+}
+
+void FileSystemManager::allocate_range(size_t inode, Inode* node, size_t size, size_t offset) {
+    if (offset > node->size && allocation_manager->supports_holes()) {
+        // The space in front of the range is not written, so it stays a hole
+        extend_allocation(inode, node, offset);
+    }
+    if (offset + size > node->size) {
+        size_t old_size = node->size;
+        resize_allocation(inode, node, offset + size);
+        // Only the range is written, the space in front of it may contain data of freed allocations
+        if (offset > old_size && node->allocation_handle != 0) {
+            zero_allocation(node, offset - old_size, old_size);
+        }
+    }
+    if (node->allocation_handle != 0 && allocation_manager->has_holes(node->allocation_handle, size, offset)) {
+        fill_allocation(inode, node, size, offset);
+    }
+}
+
+void FileSystemManager::trim_file(size_t inode) {
+    std::lock_guard<std::mutex> lock(resize_mutex);
+    Inode* node = inode_manager->get_inode(inode);
+    if (node->allocation_handle == 0 || !allocation_manager->trim(node->allocation_handle, node->size)) {
+        return;
+    }
+    allocation_manager_checkpoint.dirty = true;
+
+    // Resizing to the same size releases the reserved space during replay as well
+    JournalRecord record{JournalOperation::SET_SIZE};
+    record.node = inode;
+    record.size = node->size;
+    record.allocation_handle = node->allocation_handle;
+    log(record);
+}
+
+void FileSystemManager::write_component(Serializable* component, size_t& handle, size_t& size, size_t& shadow_handle, size_t& shadow_size, ComponentCheckpoint& checkpoint) {
+    // The copy of the last checkpoint stays allocated, so the other copy never overlaps it
+    size_t new_size = component->get_serialized_size();
+    size_t new_handle = shadow_handle;
+    if (shadow_handle == 0) {
+        new_handle = allocation_manager->allocate(new_size);
+    } else if (new_size != shadow_size) {
+        new_handle = allocation_manager->resize(shadow_handle, shadow_size, new_size);
+    }
+
+    // As the allocation manager has to manage itself too, it might change its own size when allocating space for itself, so we need to resize again until the size stabilizes.
+    size_t stable_size = component->get_serialized_size();
+    while (stable_size != new_size) {
+        new_handle = allocation_manager->resize(new_handle, new_size, stable_size);
+        new_size = stable_size;
+        stable_size = component->get_serialized_size();
+    }
+
+    std::vector<char> buffer(new_size, 0);
     size_t offset = 0;
-    flouds->serialize(flouds_buffer, &offset);
-    allocation_manager->write(flouds_handle, flouds_buffer, flouds_size, 0);
-    delete[] flouds_buffer;
-
-    // Write inode manager data
-    size_t inode_manager_size = inode_manager->get_serialized_size();
-    size_t inode_manager_handle = (header.inode_manager_handle == 0) ? allocation_manager->allocate(inode_manager_size) : allocation_manager->resize(header.inode_manager_handle, header.inode_manager_size, inode_manager_size);
-    char* inode_manager_buffer = new char[inode_manager_size];
-    offset = 0;
-    inode_manager->serialize(inode_manager_buffer, &offset);
-    allocation_manager->write(inode_manager_handle, inode_manager_buffer, inode_manager_size, 0);
-    delete[] inode_manager_buffer;
-
-    // Write allocation manager data
-    size_t allocation_manager_size = allocation_manager->get_serialized_size();
-    size_t allocation_manager_handle = (header.allocation_manager_handle == 0) ? allocation_manager->allocate(allocation_manager_size) : allocation_manager->resize(header.allocation_manager_handle, header.allocation_manager_size, allocation_manager_size);
-    // As the allocation manager has no manage itself too, it might change its own size when allocation new space for itself, so we need to check if the size changed after serialization and if so, serialize again until the size stabilizes.
-    size_t allocation_manager_new_size = allocation_manager->get_serialized_size();
-    while (allocation_manager_size != allocation_manager_new_size) {
-        allocation_manager_size = allocation_manager_new_size;
-        allocation_manager_handle = allocation_manager->resize(allocation_manager_handle, allocation_manager_size, allocation_manager_new_size);
-        allocation_manager_new_size = allocation_manager->get_serialized_size();
-    }
-    char* allocation_manager_buffer = new char[allocation_manager_size];
-    offset = 0;
-    allocation_manager->serialize(allocation_manager_buffer, &offset);
-    allocation_manager->write(allocation_manager_handle, allocation_manager_buffer, allocation_manager_size, 0);
-    delete[] allocation_manager_buffer;
-
-    // Write header
-    header.flouds_handle = flouds_handle;
-    header.flouds_size = flouds_size;
-    header.allocation_manager_handle = allocation_manager_handle;
-    header.allocation_manager_size = allocation_manager_size;
-    header.inode_manager_handle = inode_manager_handle;
-    header.inode_manager_size = inode_manager_size;
-    block_device->write_block(0, (char*) &header);    
+    component->serialize(buffer.data(), &offset);
+
+    // Blocks that were moved to a new place have to be written completely
+    const std::vector<char>& written = checkpoint.shadow_written;
+    size_t known_size = (new_handle == shadow_handle) ? written.size() : 0;
+    size_t block_size = block_device->get_block_size();
+    size_t num_blocks = (new_size + block_size - 1) / block_size;
+
+    // Write consecutive runs of changed blocks at once
+    size_t run_start = SIZE_MAX;
+    for (size_t i = 0; i <= num_blocks; i++) {
+        bool changed = false;
+        if (i < num_blocks) {
+            size_t block_offset = i * block_size;
+            size_t length = std::min(block_size, new_size - block_offset);
+            changed = block_offset + length > known_size || std::memcmp(buffer.data() + block_offset, written.data() + block_offset, length) != 0;
+        }
+
+        if (changed && run_start == SIZE_MAX) {
+            run_start = i;
+        } else if (!changed && run_start != SIZE_MAX) {
+            size_t run_offset = run_start * block_size;
+            size_t run_length = std::min(i * block_size, new_size) - run_offset;
+            allocation_manager->write(new_handle, buffer.data() + run_offset, run_length, run_offset);
+            run_start = SIZE_MAX;
+        }
+    }
+
+    // The header points to the written copy from now on, the copy of the last checkpoint is overwritten by the next one
+    shadow_handle = handle;
+    shadow_size = size;
+    handle = new_handle;
+    size = new_size;
+    checkpoint.shadow_written = std::move(checkpoint.written);
+    checkpoint.written = std::move(buffer);
+    checkpoint.dirty = false;
 }
 
-size_t FileSystemManager::add_node(size_t parent_inode, std::string name, bool is_folder, uint32_t mode) {
+void FileSystemManager::read_component(Serializable* component, size_t handle, size_t size, ComponentCheckpoint& checkpoint) {
+    std::vector<char> buffer(size);
+    allocation_manager->read(handle, buffer.data(), size, 0);
+    size_t offset = 0;
+    component->deserialize(buffer.data(), &offset);
+    checkpoint.written = std::move(buffer);
+    checkpoint.dirty = false;
+}
+
+void FileSystemManager::checkpoint() {
+    if (count_operation()) {
+        checkpoint_if_due();
+    }
+}
+
+bool FileSystemManager::checkpoint_due() const {
+    bool operations_reached = checkpoint_policy.operations != 0 && operations_since_checkpoint >= checkpoint_policy.operations;
+    bool time_reached = checkpoint_policy.milliseconds != 0 && std::chrono::steady_clock::now() - last_checkpoint >= std::chrono::milliseconds(checkpoint_policy.milliseconds);
+    return checkpoint_required || operations_reached || time_reached;
+}
+
+bool FileSystemManager::count_operation() {
+    operations_since_checkpoint++;
+    if (checkpoint_due()) {
+        return true;
+    }
+
+    #ifdef DELAYED_ALLOCATION
+    if (page_cache->over_capacity()) {
+        return true;
+    }
+    #endif
+
+    std::lock_guard<std::mutex> lock(journal_mutex);
+    return journal->commit_due();
+}
+
+void FileSystemManager::checkpoint_if_due() {
+    #ifdef DELAYED_ALLOCATION
+    if (page_cache->over_capacity()) {
+        flush_page_cache();
+    }
+    #endif
+
+    if (checkpoint_due()) {
+        save();
+    } else if (journal->commit_due()) {
+        journal->commit();
+        block_device->flush();
+    }
+}
+
+void FileSystemManager::sync() {
+    if (!checkpoint_policy.on_fsync) {
+        return;
+    }
+
     #ifdef DELAYED_ALLOCATION
-    // Flush any pending delayed write to ensure consistency
-    flush_delayed_write();
+    flush_page_cache();
     #endif
 
+    journal->commit();
+    block_device->flush();
+}
+
+size_t FileSystemManager::add_node(size_t parent_inode, std::string name, bool is_folder, uint32_t mode) {
     size_t inode_number = flouds->insert(parent_inode, name, is_folder);
     Inode* inode = inode_manager->insert_inode(inode_number);
+    delta_stabilization->record_insert(inode_number);
+    #ifdef DELAYED_ALLOCATION
+    // The buffered data moves with the inode numbers
+    page_cache->insert_inode(inode_number);
+    #endif
 
+    time_t now = std::time(nullptr);
     inode->mode = mode;
-    inode->access_time = std::time(nullptr);
-    inode->creation_time = std::time(nullptr);
-    inode->modification_time = std::time(nullptr);
+    inode->access_time = now;
+    inode->creation_time = now;
+    inode->modification_time = now;
+
+    flouds_checkpoint.dirty = true;
+    inode_manager_checkpoint.dirty = true;
+    allocation_manager_checkpoint.dirty = true;
+    delta_stabilization_checkpoint.dirty = true;
+
+    JournalRecord record{JournalOperation::INSERT_NODE};
+    record.node = parent_inode;
+    record.name = std::move(name);
+    record.is_folder = is_folder;
+    record.mode = mode;
+    record.modification_time = now;
+    log(record);
     return inode_number;
 }
 
 void FileSystemManager::remove_node(size_t inode_number) {
     #ifdef DELAYED_ALLOCATION
-    // Flush any pending delayed write to ensure consistency
-    flush_delayed_write();
+    // The buffered data of the node is not needed anymore
+    page_cache->remove_inode(inode_number);
     #endif
 
     Inode* inode = inode_manager->get_inode(inode_number);
@@ -159,91 +604,218 @@ void FileSystemManager::remove_node(size_t inode_number) {
     
     flouds->remove(inode_number);
     inode_manager->remove_inode(inode_number);
+    delta_stabilization->record_remove(inode_number);
+
+    flouds_checkpoint.dirty = true;
+    inode_manager_checkpoint.dirty = true;
+    delta_stabilization_checkpoint.dirty = true;
+    allocation_manager_checkpoint.dirty = true;
+
+    JournalRecord record{JournalOperation::REMOVE_NODE};
+    record.node = inode_number;
+    log(record);
 }
 
 void FileSystemManager::read_file(size_t inode, char* buffer, size_t size, size_t offset) {
+    Inode* node = inode_manager->get_inode(inode);
+
     #ifdef DELAYED_ALLOCATION
-    if (delayed_write->size > 0 && delayed_write->inode == inode && offset >= delayed_write->offset && offset < delayed_write->offset + delayed_write->size) {
-        // If the read overlaps with the delayed write, we need to read from the delayed buffer
-        size_t delayed_write_offset = offset - delayed_write->offset;
-        size_t bytes_from_delayed_write = std::min(size, delayed_write->size - delayed_write_offset);
-        std::memcpy(buffer, delayed_write_buffer + delayed_write_offset, bytes_from_delayed_write);
-
-        if (bytes_from_delayed_write == size) {
-            return;
+    if (page_cache->contains(inode)) {
+        // Only the allocated part of the file is read from the block device, buffered data is copied over it
+        size_t stored = offset < node->size ? std::min(size, node->size - offset) : 0;
+        if (stored > 0) {
+            read_data(inode, node, buffer, stored, offset);
         }
+        std::memset(buffer + stored, 0, size - stored);
+        page_cache->read(inode, buffer, size, offset);
+        touch(node);
+        return;
+    }
+    #endif
+
+    read_data(inode, node, buffer, size, offset);
+    touch(node);
+}
 
-        // Otherwise we need to read the remaining part from the block device
-        buffer += bytes_from_delayed_write;
-        size -= bytes_from_delayed_write;
-        offset += bytes_from_delayed_write;
+const char* FileSystemManager::view_file(size_t inode, size_t size, size_t offset) {
+    #ifdef DELAYED_ALLOCATION
+    if (page_cache->contains(inode)) {
+        // The newest data of the file may only be in the page cache
+        return nullptr;
     }
-    #endif DELAYED_ALLOCATION
+    #endif
 
     Inode* node = inode_manager->get_inode(inode);
-    allocation_manager->read(node->allocation_handle, buffer, size, offset);
-    node->access_time = std::time(nullptr);
+    if (node->allocation_handle == 0) {
+        // Inline data may move when the file is written
+        return nullptr;
+    }
+    const char* data = allocation_manager->view(node->allocation_handle, size, offset);
+    if (data != nullptr) {
+        touch(node);
+    }
+    return data;
+}
+
+void FileSystemManager::touch(Inode* node) {
+    std::atomic_ref<time_t>(node->access_time).store(std::time(nullptr), std::memory_order_relaxed);
+    inode_manager_checkpoint.dirty.store(true, std::memory_order_relaxed);
 }
 
 void FileSystemManager::write_file(size_t inode, const char* buffer, size_t size, size_t offset) {
     Inode* node = inode_manager->get_inode(inode);
+    inode_manager_checkpoint.dirty = true;
+    allocation_manager_checkpoint.dirty = true;
+    node->modification_time = std::time(nullptr);
 
     #ifdef DELAYED_ALLOCATION
-    if (delayed_write->size > 0) {
-        // If there is already a delayed write, check if the new write can be merged with this because they are contigous to the same file.
-        if (delayed_write->inode == inode && delayed_write->offset + delayed_write->size == offset && delayed_write->size + size <= block_device->get_block_size() * 16) {
-            std::memcpy(delayed_write_buffer + delayed_write->size, buffer, size);
-            delayed_write->size += size;
-            return;
+    // Writes that are larger than the page cache are written directly
+    if (size < page_cache->get_capacity_bytes()) {
+        if (!page_cache->write(inode, buffer, size, offset)) {
+            // The write would leave a gap in a buffered page, so the buffered data is written first
+            flush_file(inode);
+            page_cache->write(inode, buffer, size, offset);
         }
 
-        // Otherwise flush the delayed write
-        flush_delayed_write();
-    }
-
-    if (size >= block_device->get_block_size() * 16) {
-        // If the write is larger than the delayed write buffer, write it directly to the block device
-        node->allocation_handle = (node->allocation_handle == 0) ? allocation_manager->allocate(offset + size) : allocation_manager->resize(node->allocation_handle, node->size, offset + size);
-        node->size = offset + size;
-        allocation_manager->write(node->allocation_handle, buffer, size, offset);
-        node->modification_time = std::time(nullptr);
-        return;
-    } else {
-        // Otherwise, store it in the delayed write buffer
-        delayed_write = new DelayedWrite{inode, size, offset};
-        std::memcpy(delayed_write_buffer, buffer, size);
+        // Only the own file can be written back here, others may be written concurrently. If that is not enough, checkpoint_if_due writes back the rest.
+        if (page_cache->over_capacity()) {
+            flush_file(inode);
+        }
         return;
     }
-    #else
-    // If the file is not large enough to write at the given offset, we need to resize it first.
-    if (offset + size > node->size) {
-        node->allocation_handle = (node->allocation_handle == 0) ? allocation_manager->allocate(offset + size) : allocation_manager->resize(node->allocation_handle, node->size, offset + size);
-        node->size = offset + size;
-    }
 
-    allocation_manager->write(node->allocation_handle, buffer, size, offset);
+    // Buffered data must not overwrite the newer data later
+    flush_file(inode);
     #endif
 
-    node->modification_time = std::time(nullptr);
+    // If the file is not large enough to write at the given offset, we need to resize it first.
+    allocate_range(inode, node, size, offset);
+
+    write_data(inode, node, buffer, size, offset);
 }
 
 #ifdef DELAYED_ALLOCATION
-void FileSystemManager::flush_delayed_write() {
-    if (delayed_write->size == 0) return;
+void FileSystemManager::flush_file(size_t inode) {
+    std::vector<DirtyRun> runs = page_cache->take(inode);
+    if (runs.empty()) return;
+
+    // The space for all buffered writes is allocated at once
+    Inode* node = inode_manager->get_inode(inode);
+    size_t end = runs.back().offset + runs.back().data.size();
+    size_t zeroed = node->size;
+    if (end > node->size && !allocation_manager->supports_holes()) {
+        resize_allocation(inode, node, end);
+    }
 
-    Inode* node = inode_manager->get_inode(delayed_write->inode);
-    node->allocation_handle = (node->allocation_handle == 0) ? allocation_manager->allocate(delayed_write->size) : allocation_manager->resize(node->allocation_handle, node->size, delayed_write->size);
-    node->size = delayed_write->size;
-    allocation_manager->write(node->allocation_handle, delayed_write_buffer, delayed_write->size, delayed_write->offset);
+    for (const DirtyRun& run : runs) {
+        // Gaps between the runs stay holes if possible, otherwise they are zeroed
+        if (run.offset > zeroed && node->allocation_handle != 0 && !allocation_manager->supports_holes()) {
+            zero_allocation(node, run.offset - zeroed, zeroed);
+        }
+        zeroed = std::max(zeroed, run.offset + run.data.size());
+        allocate_range(inode, node, run.data.size(), run.offset);
+        write_data(inode, node, run.data.data(), run.data.size(), run.offset);
+    }
+}
 
-    delayed_write->size = 0;
+void FileSystemManager::flush_page_cache() {
+    for (size_t inode : page_cache->get_inodes()) {
+        flush_file(inode);
+    }
 }
 #endif
 
+size_t FileSystemManager::get_file_size(size_t inode) {
+    size_t size = inode_manager->get_inode(inode)->size;
+    #ifdef DELAYED_ALLOCATION
+    size = std::max(size, page_cache->get_end(inode));
+    #endif
+    return size;
+}
+
 void FileSystemManager::set_file_size(size_t inode, size_t size) {
+    #ifdef DELAYED_ALLOCATION
+    flush_file(inode);
+    #endif
     Inode* node = inode_manager->get_inode(inode);
-    node->allocation_handle = (node->allocation_handle == 0) ? allocation_manager->allocate(size) : allocation_manager->resize(node->allocation_handle, node->size, size);
-    node->size = size;
+    if (size > node->size) {
+        // The added space is not written, so it becomes a hole if possible
+        extend_allocation(inode, node, size);
+    } else {
+        resize_allocation(inode, node, size);
+    }
+}
+
+void FileSystemManager::allocate_file(size_t inode, size_t size, size_t offset, bool keep_size) {
+    #ifdef DELAYED_ALLOCATION
+    flush_file(inode);
+    #endif
+    Inode* node = inode_manager->get_inode(inode);
+    if (keep_size) {
+        size = offset < node->size ? std::min(size, node->size - offset) : 0;
+    }
+    if (size > 0) {
+        size_t old_size = node->size;
+        allocate_range(inode, node, size, offset);
+        // The range is not written, so the space added behind the old end is zeroed
+        size_t start = std::max(offset, old_size);
+        if (offset + size > start && node->allocation_handle != 0) {
+            zero_allocation(node, offset + size - start, start);
+        }
+    }
+}
+
+void FileSystemManager::punch_hole(size_t inode, size_t size, size_t offset) {
+    #ifdef DELAYED_ALLOCATION
+    flush_file(inode);
+    #endif
+    Inode* node = inode_manager->get_inode(inode);
+    size = offset < node->size ? std::min(size, node->size - offset) : 0;
+    if (size == 0) {
+        return;
+    }
+    node->modification_time = std::time(nullptr);
+    inode_manager_checkpoint.dirty = true;
+
+    // Whole blocks are freed, the rest of the range is overwritten with zeros
+    size_t block_size = block_device->get_block_size();
+    size_t first_block = (offset + block_size - 1) / block_size;
+    size_t end_block = (offset + size) / block_size;
+    if (node->allocation_handle != 0 && allocation_manager->supports_holes() && first_block < end_block) {
+        punch_allocation(inode, node, size, offset);
+        std::vector<char> zeros(block_size, 0);
+        allocation_manager->write(node->allocation_handle, zeros.data(), first_block * block_size - offset, offset);
+        allocation_manager->write(node->allocation_handle, zeros.data(), offset + size - end_block * block_size, end_block * block_size);
+        return;
+    }
+
+    std::vector<char> zeros(std::min<size_t>(size, RELOCATION_CHUNK_SIZE), 0);
+    for (size_t done = 0; done < size; done += zeros.size()) {
+        write_data(inode, node, zeros.data(), std::min(zeros.size(), size - done), offset + done);
+    }
+}
+
+void FileSystemManager::set_mode(size_t inode, uint32_t mode) {
+    inode_manager->get_inode(inode)->mode = mode;
+    inode_manager_checkpoint.dirty = true;
+
+    JournalRecord record{JournalOperation::SET_MODE};
+    record.node = inode;
+    record.mode = mode;
+    log(record);
+}
+
+void FileSystemManager::set_times(size_t inode, time_t access_time, time_t modification_time) {
+    Inode* node = inode_manager->get_inode(inode);
+    node->access_time = access_time;
+    node->modification_time = modification_time;
+    inode_manager_checkpoint.dirty = true;
+
+    JournalRecord record{JournalOperation::SET_TIMES};
+    record.node = inode;
+    record.access_time = access_time;
+    record.modification_time = modification_time;
+    log(record);
 }
 
 Inode* FileSystemManager::get_inode(size_t inode) {
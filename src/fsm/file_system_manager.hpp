@@ -8,16 +8,62 @@
 #pragma once
 
 #include "../block_device/block_device.hpp"
+#include "../block_device/cached_block_device.hpp"
+#include "../block_device/io_uring_block_device.hpp"
+#include "../block_device/mapped_block_device.hpp"
 #include "../flouds/flouds.hpp"
 #include "allocation/allocation_manager.hpp"
+#include "delta/delta_stabilization.hpp"
 #include "inode/inode.hpp"
+#include "journal/journal.hpp"
+#include "page_cache/page_cache.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+// Default number of operations after which a checkpoint is written (0 disables the limit)
+#ifndef CHECKPOINT_OPERATIONS
+#define CHECKPOINT_OPERATIONS 16384
+#endif
+
+// Default number of milliseconds after which a checkpoint is written (0 disables the limit)
+#ifndef CHECKPOINT_MILLISECONDS
+#define CHECKPOINT_MILLISECONDS 30000
+#endif
+
+// Number of locks the inodes are distributed over. Inodes with the same lock cannot be written in parallel.
+#ifndef INODE_LOCK_STRIPES
+#define INODE_LOCK_STRIPES 64
+#endif
+
+// Allocation strategy for the files and components. Only the extent strategy can store sparse files with holes.
+// With PACKED_ALLOCATION, small files share blocks instead of occupying one block each.
+#ifdef SPARSE_FILES
+using BlockAllocationStrategy = ExtentAllocationStrategy;
+#else
+using BlockAllocationStrategy = BestFitAllocationStrategy;
+#endif
+#ifdef PACKED_ALLOCATION
+using FileSystemAllocationStrategy = PackedAllocationStrategy<BlockAllocationStrategy>;
+#else
+using FileSystemAllocationStrategy = BlockAllocationStrategy;
+#endif
+
+// Version of the on-disk format. Version 0 filesystems do not have a journal yet, version 1 filesystems do not store stable inode numbers, version 2 filesystems overwrite their components in place.
+#define FLOUDS_VERSION 3
 
 /**
  * This structure defines the first block of the filesystem, which contains a magic string to identify the filesystem and allocation handles for all relevant components.
+ * Every component has two copies and a checkpoint only writes the copy the header does not point to. The header fits into one sector, so writing it switches to the new checkpoint atomically.
  */
 struct FloudsHeader {
     // "FLOUDS"
     char magic[6];
+    // Stored in the padding after the magic string, which is zero in filesystems without a version
+    uint16_t version;
     
     size_t allocation_manager_handle;
     size_t allocation_manager_size;
@@ -27,19 +73,70 @@ struct FloudsHeader {
 
     size_t inode_manager_handle;
     size_t inode_manager_size;
+
+    size_t journal_handle;
+    size_t journal_size;
+    // Generation of the last checkpoint. Only journal records of this generation are replayed.
+    size_t journal_generation;
+
+    size_t delta_stabilization_handle;
+    size_t delta_stabilization_size;
+
+    // The copies of the components that belong to the previous checkpoint and are overwritten by the next one
+    size_t allocation_manager_shadow_handle;
+    size_t allocation_manager_shadow_size;
+    size_t flouds_shadow_handle;
+    size_t flouds_shadow_size;
+    size_t inode_manager_shadow_handle;
+    size_t inode_manager_shadow_size;
+    size_t delta_stabilization_shadow_handle;
+    size_t delta_stabilization_shadow_size;
 };
 
-#ifdef DELAYED_ALLOCATION
-struct DelayedWrite {
-    size_t inode;
-    size_t size;
-    size_t offset;
+/**
+ * This structure defines when the metadata of the filesystem is written to the block device.
+ * A checkpoint is written as soon as one of the enabled limits is reached. In between, metadata operations are made durable by the journal.
+ */
+struct CheckpointPolicy {
+    // Number of operations after which a checkpoint is written. 0 disables this limit, 1 writes a checkpoint after every operation.
+    size_t operations = CHECKPOINT_OPERATIONS;
+    // Number of milliseconds since the last checkpoint after which a checkpoint is written. 0 disables this limit.
+    size_t milliseconds = CHECKPOINT_MILLISECONDS;
+    // Whether a fsync of the user commits the journal.
+    bool on_fsync = true;
+};
+
+/**
+ * The block device backends that can be selected at mount time.
+ */
+enum class BlockDeviceBackend {
+    // Synchronous reads and writes on the file, with the block cache in front if it is enabled
+    FILE,
+    // Batches of requests are submitted through io_uring
+    IO_URING,
+    // Like IO_URING, but the file is opened with O_DIRECT to bypass the page cache
+    IO_URING_DIRECT,
+    // The whole file is memory mapped, reads of contiguous data do not need to be copied
+    MMAP
+};
+
+/**
+ * This structure tracks the state of a serialized component on the block device since the last checkpoint.
+ * Only components that are dirty are serialized again and only blocks whose content changed are written.
+ */
+struct ComponentCheckpoint {
+    // Set concurrently by reads and writes of files
+    std::atomic<bool> dirty{true};
+    // The serialized component as it was written to the copy of the last checkpoint and to the other copy, which a new serialization is compared with block by block. Empty if unknown.
+    std::vector<char> written;
+    std::vector<char> shadow_written;
 };
-#endif
 
 /**
  * This class syncs the FLOUDS data structure with the block device and allows reading and writing of files and folders.
  * It works with inode numbers and these are translated to FLOUDS node indices internally. Inode numbers stay stable even if the FLOUDS structure changes.
+ * Methods that only read (getters, lookups, read_file and view_file) may be called concurrently. read_file, view_file and write_file of different files may also run concurrently, as long as the caller holds the lock of the inode (see get_inode_lock), shared for reads and exclusively for writes.
+ * All other methods require exclusive access, as they may change the inode numbers.
  */
 class FileSystemManager {
 private:
@@ -48,10 +145,177 @@ private:
     BlockDevice* block_device;
     AllocationManager* allocation_manager;
     InodeManager* inode_manager;
+    DeltaStabilization* delta_stabilization;
+
+    CheckpointPolicy checkpoint_policy;
+    ComponentCheckpoint flouds_checkpoint;
+    ComponentCheckpoint inode_manager_checkpoint;
+    ComponentCheckpoint allocation_manager_checkpoint;
+    ComponentCheckpoint delta_stabilization_checkpoint;
+    std::atomic<size_t> operations_since_checkpoint = 0;
+    std::chrono::steady_clock::time_point last_checkpoint = std::chrono::steady_clock::now();
+    // Set if a record did not fit into the journal, the next checkpoint_if_due writes a checkpoint then
+    std::atomic<bool> checkpoint_required = false;
+
+    Journal* journal = nullptr;
+    // Guards the journal against concurrent writes of different files
+    std::mutex journal_mutex;
+    // Keeps allocations of different files in the same order as their journal records, so replaying allocates the same space
+    std::mutex resize_mutex;
+    bool replaying = false;
+
+    std::array<std::shared_mutex, INODE_LOCK_STRIPES> inode_locks;
+
+    /**
+     * Writes a serialized component to the copy the header does not point to, so the last checkpoint stays intact until the header is written. Space is allocated or resized as needed and only blocks that differ from the content of that copy are written.
+     * Afterwards the copies are swapped in the header.
+     * 
+     * @param component The component to write.
+     * @param handle The allocation handle of the copy of the last checkpoint. Will be updated to the written copy.
+     * @param size The serialized size of the component at the last checkpoint. Will be updated to the new size.
+     * @param shadow_handle The allocation handle of the other copy or 0 if it does not exist yet. Will be updated to the copy of the last checkpoint.
+     * @param shadow_size The serialized size of the other copy. Will be updated to the size at the last checkpoint.
+     * @param checkpoint The checkpoint state of the component.
+     */
+    void write_component(Serializable* component, size_t& handle, size_t& size, size_t& shadow_handle, size_t& shadow_size, ComponentCheckpoint& checkpoint);
+
+    /**
+     * Reads a serialized component from the block device and remembers its content, so the next checkpoint only writes the blocks that changed.
+     * 
+     * @param component The component to deserialize.
+     * @param handle The allocation handle of the component.
+     * @param size The serialized size of the component.
+     * @param checkpoint The checkpoint state of the component.
+     */
+    void read_component(Serializable* component, size_t handle, size_t size, ComponentCheckpoint& checkpoint);
+
+    /**
+     * Checks whether the checkpoint policy demands a checkpoint.
+     */
+    bool checkpoint_due() const;
+
+    /**
+     * Writes the header to the first block of the block device.
+     */
+    void write_header();
+
+    /**
+     * Allocates the journal region on the block device.
+     */
+    void create_journal();
+
+    /**
+     * Appends a record to the journal. If the journal is full, it refuses all following records and the next call of checkpoint_if_due writes a checkpoint instead.
+     * 
+     * @param record The record to append.
+     */
+    void log(const JournalRecord& record);
+
+    /**
+     * Applies a record of the journal during mount.
+     * 
+     * @param record The record to apply.
+     * @throws std::runtime_error if replaying a size change allocates different space than the recorded one.
+     */
+    void replay(const JournalRecord& record);
+
+    /**
+     * Allocates or resizes the space of a file and records the change in the journal.
+     * 
+     * @param inode The inode number of the file.
+     * @param node The inode structure of the file.
+     * @param size The new size of the file in bytes.
+     */
+    void resize_allocation(size_t inode, Inode* node, size_t size);
+
+    /**
+     * Moves the inline data of a file into its new allocation. The resize lock must be held.
+     * 
+     * @param inode The inode number of the file.
+     * @param node The inode structure of the file. Its allocation handle must be set already.
+     */
+    void move_inline_data(size_t inode, Inode* node);
+
+    /**
+     * Reads data of a file from its blocks or from its inline data.
+     * 
+     * @param inode The inode number of the file.
+     * @param node The inode structure of the file.
+     * @param buffer The buffer to write the data into. Must be at least size bytes.
+     * @param size The number of bytes to read.
+     * @param offset The offset within the file.
+     */
+    void read_data(size_t inode, Inode* node, char* buffer, size_t size, size_t offset);
+
+    /**
+     * Writes data of a file to its blocks or to its inline data, which is recorded in the journal. The range must be allocated.
+     * 
+     * @param inode The inode number of the file.
+     * @param node The inode structure of the file.
+     * @param buffer The buffer containing the data. Must be at least size bytes.
+     * @param size The number of bytes to write.
+     * @param offset The offset within the file.
+     */
+    void write_data(size_t inode, Inode* node, const char* buffer, size_t size, size_t offset);
+
+    /**
+     * Grows the space of a file without allocating the added space, if the allocation strategy supports holes, and records the change in the journal.
+     * 
+     * @param inode The inode number of the file.
+     * @param node The inode structure of the file.
+     * @param size The new size of the file in bytes. Must be larger than the current size.
+     */
+    void extend_allocation(size_t inode, Inode* node, size_t size);
+
+    /**
+     * Overwrites a range of the blocks of a file with zeros. Holes within the range are skipped. Nothing is written during replay.
+     * 
+     * @param node The inode structure of the file. It must have an allocation.
+     * @param size The size of the range in bytes.
+     * @param offset The offset of the range within the file.
+     */
+    void zero_allocation(Inode* node, size_t size, size_t offset);
+
+    /**
+     * Allocates the holes within a range of a file and records the change in the journal.
+     * 
+     * @param inode The inode number of the file.
+     * @param node The inode structure of the file.
+     * @param size The size of the range in bytes.
+     * @param offset The offset of the range within the file.
+     */
+    void fill_allocation(size_t inode, Inode* node, size_t size, size_t offset);
+
+    /**
+     * Frees the blocks that lie completely within a range of a file and records the change in the journal.
+     * 
+     * @param inode The inode number of the file.
+     * @param node The inode structure of the file.
+     * @param size The size of the range in bytes.
+     * @param offset The offset of the range within the file.
+     */
+    void punch_allocation(size_t inode, Inode* node, size_t size, size_t offset);
+
+    /**
+     * Makes sure that a range of a file is allocated before it is written. Space between the end of the file and the range stays a hole if possible.
+     * 
+     * @param inode The inode number of the file.
+     * @param node The inode structure of the file.
+     * @param size The size of the range in bytes.
+     * @param offset The offset of the range within the file.
+     */
+    void allocate_range(size_t inode, Inode* node, size_t size, size_t offset);
+
+    /**
+     * Updates the access time of a file after it was read. Reads may run concurrently, so the fields are updated atomically.
+     * 
+     * @param node The inode structure of the file.
+     */
+    void touch(Inode* node);
 
     #ifdef DELAYED_ALLOCATION
-    DelayedWrite* delayed_write;
-    char* delayed_write_buffer;
+    // Written data that is not allocated yet
+    PageCache* page_cache = nullptr;
     #endif
 
 public:
@@ -68,11 +332,13 @@ public:
 
     /**
      * Loads the filesystem the block device at the specified path. If path does not exist, a new filesystem will be created.
+     * Operations in the journal that happened after the last checkpoint are replayed.
      * 
      * @param path The path to the block device file.
-     * @throws std::runtime_error if the block device file is invalid.
+     * @param backend The backend that performs the I/O on the block device file.
+     * @throws std::runtime_error if the block device file is invalid or the journal cannot be replayed consistently.
      */
-    virtual void mount(std::string path);
+    virtual void mount(std::string path, BlockDeviceBackend backend = BlockDeviceBackend::FILE);
 
     /**
      * Unloads the filesystem.
@@ -80,10 +346,42 @@ public:
     virtual void unmount();
 
     /**
-     * Saves the current state of the filesystem to the block device.
+     * Saves the current state of the filesystem to the block device. Buffered file data is written back first. Only components that changed since the last checkpoint are written.
+     * Afterwards the journal starts a new generation.
      */
     virtual void save();
 
+    /**
+     * Notifies the filesystem that an operation was completed. Writes a checkpoint if the checkpoint policy demands it, otherwise commits the journal if enough records are pending.
+     */
+    virtual void checkpoint();
+
+    /**
+     * Counts a completed operation without writing anything. Unlike checkpoint, this may be called concurrently with writes of other files.
+     * 
+     * @return true if a checkpoint, a commit of the journal or a write back of buffered data is due and checkpoint_if_due should be called with exclusive access.
+     */
+    bool count_operation();
+
+    /**
+     * Writes a checkpoint or commits the journal if the checkpoint policy demands it. Buffered file data is written back if it exceeds the capacity of the page cache.
+     */
+    void checkpoint_if_due();
+
+    /**
+     * Writes all pending data and commits the journal if the checkpoint policy allows fsync-triggered commits.
+     */
+    virtual void sync();
+
+    /**
+     * Sets the policy that defines when checkpoints are written.
+     * 
+     * @param policy The new checkpoint policy.
+     */
+    void set_checkpoint_policy(CheckpointPolicy policy) {
+        checkpoint_policy = policy;
+    }
+
     /**
      * Gets the FLOUDS data structure of the filesystem.
      */
@@ -91,6 +389,13 @@ public:
         return flouds;
     }
 
+    /**
+     * Gets the translation between the stable inode numbers that FUSE uses and the FLOUDS node indices. It is kept up to date by add_node and remove_node.
+     */
+    virtual DeltaStabilization* get_delta_stabilization() {
+        return delta_stabilization;
+    }
+
     /**
      * Adds a node to the filesystem as a child of the specified parent node.
      * 
@@ -119,6 +424,17 @@ public:
      */
     virtual void read_file(size_t inode, char* buffer, size_t size, size_t offset);
 
+    /**
+     * Gets a pointer to data of a file without copying it. This is only possible if the block device is memory mapped and the data is stored contiguously.
+     * The pointer is only valid until the next write to the filesystem.
+     * 
+     * @param inode The inode number of the file to read from. Must be a valid inode representing a file.
+     * @param size The number of bytes that must be accessible through the pointer.
+     * @param offset The offset within the file.
+     * @return A pointer to the data or nullptr if the data has to be read with read_file.
+     */
+    virtual const char* view_file(size_t inode, size_t size, size_t offset);
+
     /**
      * Writes data to a file represented by the inode number.
      * 
@@ -137,12 +453,83 @@ public:
      */
     virtual void set_file_size(size_t inode, size_t size);
 
+    /**
+     * Allocates the space of a range of a file, so writing it later cannot fail for lack of space.
+     * 
+     * @param inode The inode number of the file. Must be a valid inode.
+     * @param size The size of the range in bytes.
+     * @param offset The offset of the range within the file.
+     * @param keep_size Whether the size of the file stays the same if the range reaches behind its end. Only the part within the file is allocated then.
+     */
+    virtual void allocate_file(size_t inode, size_t size, size_t offset, bool keep_size);
+
+    /**
+     * Deallocates a range of a file, which reads as zeros afterwards. The size of the file stays the same.
+     * 
+     * @param inode The inode number of the file. Must be a valid inode.
+     * @param size The size of the range in bytes.
+     * @param offset The offset of the range within the file.
+     */
+    virtual void punch_hole(size_t inode, size_t size, size_t offset);
+
+    /**
+     * Sets the permissions of the node represented by the inode.
+     * 
+     * @param inode The inode number of the node. Must be a valid inode.
+     * @param mode The new permissions of the node.
+     */
+    virtual void set_mode(size_t inode, uint32_t mode);
+
+    /**
+     * Sets the access and modification time of the node represented by the inode.
+     * 
+     * @param inode The inode number of the node. Must be a valid inode.
+     * @param access_time The new access time.
+     * @param modification_time The new modification time.
+     */
+    virtual void set_times(size_t inode, time_t access_time, time_t modification_time);
+
     #ifdef DELAYED_ALLOCATION
     /**
-     * Flushes a delayed write to the block device. This is needed if delayed allocation is used. Consecutive writes to the same file may be buffered and written the block device.
+     * Writes the buffered data of a file to the block device. The space of the file is allocated once for all buffered writes.
+     * The caller must hold the lock of the inode exclusively.
+     * 
+     * @param inode The inode number of the file.
+     */
+    virtual void flush_file(size_t inode);
+
+    /**
+     * Writes the buffered data of all files to the block device. Requires exclusive access.
+     */
+    virtual void flush_page_cache();
+    #endif
+
+    /**
+     * Releases the space that is reserved behind the allocation of a file, e.g. when the file is closed.
+     * The caller must hold the lock of the inode exclusively.
+     * 
+     * @param inode The inode number of the file. Must be a valid inode.
      */
-    virtual void flush_delayed_write();
-    #endif DELAYED_ALLOCATION
+    virtual void trim_file(size_t inode);
+
+    /**
+     * Gets the size of a file including data that is buffered and not allocated yet.
+     * 
+     * @param inode The inode number of the file. Must be a valid inode.
+     * @return The size of the file in bytes.
+     */
+    size_t get_file_size(size_t inode);
+
+    /**
+     * Gets the lock that guards the data and the inode structure of a file while files are read and written concurrently.
+     * Several inodes share a lock. Inode numbers only change with exclusive access, so the lock of an inode number stays the same while it is held.
+     * 
+     * @param inode The inode number.
+     * @return The lock of the inode.
+     */
+    std::shared_mutex& get_inode_lock(size_t inode) {
+        return inode_locks[inode % INODE_LOCK_STRIPES];
+    }
 
     /**
      * Gets the inode structure for the given inode number.
@@ -7,6 +7,7 @@
 
 #include "inode.hpp"
 #include <vector>
+#include <algorithm>
 #include <cstring>
 #include <sys/stat.h>
 
@@ -16,6 +17,8 @@
 class ArrayInodeManagerStrategy : public InodeManager {
 private:
     std::vector<Inode> inodes;
+    // The inline data of each inode, most of them are empty
+    std::vector<std::string> inline_data;
 public:
     ArrayInodeManagerStrategy(AllocationManager* allocation_manager) : InodeManager(allocation_manager) {}
 
@@ -25,18 +28,25 @@ public:
 
     Inode* insert_inode(size_t inode) override {
         inodes.insert(inodes.begin() + inode, Inode{});
+        inline_data.insert(inline_data.begin() + inode, std::string());
         return &inodes[inode];
     }
 
     void remove_inode(size_t inode) override {
         inodes.erase(inodes.begin() + inode);
+        inline_data.erase(inline_data.begin() + inode);
+    }
+
+    std::string& get_inline_data(size_t inode) override {
+        return inline_data[inode];
     }
 
     void serialize(char* buffer, size_t* offset) override {
         size_t num_inodes = inodes.size();
         std::memcpy(buffer + *offset, &num_inodes, sizeof(size_t));
         *offset += sizeof(size_t);
-        for (const Inode& inode : inodes) {
+        for (size_t i = 0; i < inodes.size(); i++) {
+            const Inode& inode = inodes[i];
             // Write each inode manually (because folders dont need allocation_handle and size)
             std::memcpy(buffer + *offset, &inode.mode, sizeof(uint32_t));
             *offset += sizeof(uint32_t);
@@ -51,6 +61,13 @@ public:
                 *offset += sizeof(size_t);
                 std::memcpy(buffer + *offset, &inode.size, sizeof(size_t));
                 *offset += sizeof(size_t);
+                if (inode.allocation_handle == 0) {
+                    // The data of the file follows its inode
+                    size_t stored = std::min(inode.size, inline_data[i].size());
+                    std::memcpy(buffer + *offset, inline_data[i].data(), stored);
+                    std::memset(buffer + *offset + stored, 0, inode.size - stored);
+                    *offset += inode.size;
+                }
             }
         }
     }
@@ -60,6 +77,7 @@ public:
         std::memcpy(&num_inodes, buffer + *offset, sizeof(size_t));
         *offset += sizeof(size_t);
         inodes.resize(num_inodes);
+        inline_data.assign(num_inodes, std::string());
         for (size_t i = 0; i < num_inodes; i++) {
             Inode& inode = inodes[i];
             std::memcpy(&inode.mode, buffer + *offset, sizeof(uint32_t));
@@ -75,6 +93,10 @@ public:
                 *offset += sizeof(size_t);
                 std::memcpy(&inode.size, buffer + *offset, sizeof(size_t));
                 *offset += sizeof(size_t);
+                if (inode.allocation_handle == 0) {
+                    inline_data[i].assign(buffer + *offset, inode.size);
+                    *offset += inode.size;
+                }
             }
         }
     }
@@ -85,6 +107,9 @@ public:
             size += sizeof(uint32_t) + 3 * sizeof(time_t);
             if (S_ISREG(inode.mode)) {
                 size += 2 * sizeof(size_t);
+                if (inode.allocation_handle == 0) {
+                    size += inode.size;
+                }
             }
         }
         return size;
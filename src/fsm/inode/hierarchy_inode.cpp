@@ -3,9 +3,11 @@
 #include <algorithm>
 #include <cstring>
 #include <optional>
+#include <sys/stat.h>
 
 /**
  * This class implements an inode manager strategy that stores inodes in multiple chunks of a fixed size. Each chunk is allocated sepateley on the block device. We always cache one chunk in memory, so we can read or write inodes of the current context without additional accesses.
+ * The inline data of the inodes of a chunk is stored in a second allocation of the chunk.
  */
 class HierarchyInodeManagerStrategy : public InodeManager {
 private:
@@ -19,6 +21,9 @@ private:
         size_t handle;
         size_t start_inode;
         size_t num_inodes;
+        // The inline data of all inodes of the chunk, in the order of the inodes
+        size_t inline_handle;
+        size_t inline_size;
     };
 
     // All chunks sorted by start_inode are stored here and loaded initially from the block device. The actual inodes are loaded on demand and cached.
@@ -27,6 +32,7 @@ private:
     // Cache for currently loaded chunk
     std::optional<size_t> cache_handle = std::nullopt;
     std::vector<Inode> cached_inodes;
+    std::vector<std::string> cached_inline_data;
     bool cache_dirty = false;
 
     /**
@@ -44,6 +50,38 @@ private:
         return nullptr;
     }
 
+    /**
+     * Writes the inline data of a chunk to its own allocation.
+     * 
+     * @param chunk The chunk the inline data belongs to.
+     * @param inodes The inodes of the chunk.
+     * @param inline_data The inline data of the inodes of the chunk.
+     */
+    void write_inline_data(InodeChunk& chunk, const std::vector<Inode>& inodes, const std::vector<std::string>& inline_data) {
+        std::string data;
+        for (size_t i = 0; i < inodes.size(); i++) {
+            if (S_ISREG(inodes[i].mode) && inodes[i].allocation_handle == 0) {
+                data.append(inline_data[i]);
+                data.resize(data.size() + inodes[i].size - std::min(inodes[i].size, inline_data[i].size()), '\0');
+            }
+        }
+
+        if (data.empty()) {
+            if (chunk.inline_handle != 0) {
+                allocation_manager->free(chunk.inline_handle, chunk.inline_size);
+            }
+            chunk.inline_handle = 0;
+        } else if (chunk.inline_handle == 0) {
+            chunk.inline_handle = allocation_manager->allocate(data.size());
+        } else if (data.size() != chunk.inline_size) {
+            chunk.inline_handle = allocation_manager->resize(chunk.inline_handle, chunk.inline_size, data.size());
+        }
+        chunk.inline_size = data.size();
+        if (!data.empty()) {
+            allocation_manager->write(chunk.inline_handle, data.data(), data.size(), 0);
+        }
+    }
+
     /**
      * Flushes the currently cached chunk to the block device if it is dirty.
      */
@@ -51,6 +89,11 @@ private:
         if (!cache_handle || !cache_dirty) return;
 
         allocation_manager->write(*cache_handle, (char*)cached_inodes.data(), cached_inodes.size() * sizeof(Inode), 0);
+        for (InodeChunk& chunk : chunks) {
+            if (chunk.handle == *cache_handle) {
+                write_inline_data(chunk, cached_inodes, cached_inline_data);
+            }
+        }
         cache_dirty = false;
     }
 
@@ -64,6 +107,19 @@ private:
         flush_cache();
         cached_inodes.resize(chunk.num_inodes);
         allocation_manager->read(chunk.handle, (char*)cached_inodes.data(), chunk.num_inodes * sizeof(Inode), 0);
+
+        std::string data(chunk.inline_size, '\0');
+        if (chunk.inline_handle != 0) {
+            allocation_manager->read(chunk.inline_handle, data.data(), data.size(), 0);
+        }
+        cached_inline_data.assign(chunk.num_inodes, std::string());
+        size_t position = 0;
+        for (size_t i = 0; i < cached_inodes.size(); i++) {
+            if (S_ISREG(cached_inodes[i].mode) && cached_inodes[i].allocation_handle == 0) {
+                cached_inline_data[i] = data.substr(position, cached_inodes[i].size);
+                position += cached_inodes[i].size;
+            }
+        }
         cache_handle = chunk.handle;
         cache_dirty = false;
     }
@@ -94,9 +150,10 @@ public:
     Inode* insert_inode(size_t inode) override {
         if (chunks.empty()) {
             // First inode, create first chunk
-            InodeChunk chunk{0, 0, 1};
+            InodeChunk chunk{0, 0, 1, 0, 0};
             chunk.handle = allocation_manager->allocate(CHUNK_SIZE * sizeof(Inode));
             cached_inodes = {Inode{}};
+            cached_inline_data = {std::string()};
             allocation_manager->write(chunk.handle, (char*)cached_inodes.data(), sizeof(Inode), 0);
             chunks.push_back(chunk);
             cache_handle = chunk.handle;
@@ -114,6 +171,7 @@ public:
         // Insert the chunk
         size_t local_index = inode - chunk->start_inode;
         cached_inodes.insert(cached_inodes.begin() + local_index, Inode{});
+        cached_inline_data.insert(cached_inline_data.begin() + local_index, std::string());
         chunk->num_inodes++;
         cache_dirty = true;
 
@@ -128,13 +186,17 @@ public:
 
         // Split
         std::vector<Inode> right_data(cached_inodes.begin() + CHUNK_SIZE, cached_inodes.end());
+        std::vector<std::string> right_inline_data(cached_inline_data.begin() + CHUNK_SIZE, cached_inline_data.end());
         cached_inodes.resize(CHUNK_SIZE);
+        cached_inline_data.resize(CHUNK_SIZE);
         chunk->num_inodes = CHUNK_SIZE;
         allocation_manager->write(chunk->handle, (char*)cached_inodes.data(), CHUNK_SIZE * sizeof(Inode), 0);
+        write_inline_data(*chunk, cached_inodes, cached_inline_data);
 
-        InodeChunk new_chunk{0, chunk->start_inode + CHUNK_SIZE, right_data.size()};
+        InodeChunk new_chunk{0, chunk->start_inode + CHUNK_SIZE, right_data.size(), 0, 0};
         new_chunk.handle = allocation_manager->allocate(CHUNK_SIZE * sizeof(Inode));
         allocation_manager->write(new_chunk.handle, (char*)right_data.data(), right_data.size() * sizeof(Inode), 0);
+        write_inline_data(new_chunk, right_data, right_inline_data);
         chunks.insert(chunks.begin() + chunk_index + 1, new_chunk);
 
         cache_dirty = false;
@@ -146,6 +208,7 @@ public:
 
         // inode is in right chunk, update cache to point there
         cached_inodes = std::move(right_data);
+        cached_inline_data = std::move(right_inline_data);
         cache_handle = new_chunk.handle;
         return &cached_inodes[local_index - CHUNK_SIZE];
     }
@@ -161,15 +224,20 @@ public:
         size_t local_index = inode - chunk->start_inode;
         size_t old_num = chunk->num_inodes;
         cached_inodes.erase(cached_inodes.begin() + local_index);
+        cached_inline_data.erase(cached_inline_data.begin() + local_index);
         chunk->num_inodes--;
         cache_dirty = true;
 
         // If the chunk is empty, remove it
         if (chunk->num_inodes == 0) {
             allocation_manager->free(chunk->handle, old_num * sizeof(Inode));
+            if (chunk->inline_handle != 0) {
+                allocation_manager->free(chunk->inline_handle, chunk->inline_size);
+            }
             chunks.erase(chunks.begin() + chunk_index);
             cache_handle = std::nullopt;
             cached_inodes.clear();
+            cached_inline_data.clear();
             cache_dirty = false;
             shift_starts(chunk_index, -1);
             return;
@@ -178,6 +246,14 @@ public:
         shift_starts(chunk_index + 1, -1);
     }
 
+    std::string& get_inline_data(size_t inode) override {
+        InodeChunk* chunk = find_chunk(inode);
+        load_chunk(*chunk);
+        // The caller may change the data
+        cache_dirty = true;
+        return cached_inline_data[inode - chunk->start_inode];
+    }
+
     void serialize(char* buffer, size_t* offset) override {
         flush_cache();
         size_t n = chunks.size();
@@ -200,6 +276,7 @@ public:
         }
         cache_handle = std::nullopt;
         cached_inodes.clear();
+        cached_inline_data.clear();
         cache_dirty = false;
     }
 
@@ -10,10 +10,17 @@
 #include <cstddef>
 #include <cstdint>
 #include <ctime>
+#include <string>
 #include "../allocation/allocation_manager.hpp"
 
+// Maximum size of file data that is stored inline with the inode instead of in allocated blocks
+#ifndef INLINE_DATA_SIZE
+#define INLINE_DATA_SIZE 256
+#endif
+
 /**
  * This structure represents an inode in the filesystem. It contains its metadata, such as size, permissions, timestamps, reference to FLOUDS node and allocation handle.
+ * Files without allocation handle store their data inline with the inode (see InodeManager::get_inline_data).
  */
 struct Inode {
     size_t allocation_handle;
@@ -63,6 +70,14 @@ public:
      */
     virtual void remove_inode(size_t inode) = 0;
 
+    /**
+     * Gets the data of a file that is stored inline with its inode. It is serialized together with the inode if the inode is a regular file without allocation handle.
+     * 
+     * @param inode The inode number. Must be a valid inode number.
+     * @return The inline data. The reference is valid as long as the inode pointer of get_inode.
+     */
+    virtual std::string& get_inline_data(size_t inode) = 0;
+
     virtual void serialize(char* buffer, size_t* offset) override = 0;
     virtual void deserialize(const char* buffer, size_t* offset) override = 0;
     virtual size_t get_serialized_size() override = 0;
@@ -0,0 +1,222 @@
+/**
+ * This file is part of the Succinct Filesystem project.
+ * 
+ * Copyright (c) 2026 Sebastian Brunnert <mail@sebastianbrunnert.de>
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "journal.hpp"
+#include <cstring>
+
+/**
+ * Each record is stored as [length (4 bytes)][generation (8 bytes)][operation (1 byte)][payload][checksum (4 bytes)].
+ * The length covers the whole record and the checksum covers everything between length and checksum.
+ */
+static constexpr size_t RECORD_HEADER_SIZE = sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint8_t);
+static constexpr size_t RECORD_CHECKSUM_SIZE = sizeof(uint32_t);
+
+/**
+ * Computes the 32 bit FNV-1a hash of the given data.
+ */
+static uint32_t checksum(const char* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (uint8_t) data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+template <typename T> static void put(std::vector<char>& buffer, T value) {
+    size_t offset = buffer.size();
+    buffer.resize(offset + sizeof(T));
+    std::memcpy(buffer.data() + offset, &value, sizeof(T));
+}
+
+template <typename T> static bool get(const char* buffer, size_t end, size_t& offset, T& value) {
+    if (offset + sizeof(T) > end) return false;
+    std::memcpy(&value, buffer + offset, sizeof(T));
+    offset += sizeof(T);
+    return true;
+}
+
+void Journal::encode(const JournalRecord& record, std::vector<char>& buffer) const {
+    size_t start = buffer.size();
+    put<uint32_t>(buffer, 0);
+    put<uint64_t>(buffer, generation);
+    put<uint8_t>(buffer, (uint8_t) record.operation);
+
+    switch (record.operation) {
+        case JournalOperation::INSERT_NODE:
+            put<uint64_t>(buffer, record.node);
+            put<uint8_t>(buffer, record.is_folder ? 1 : 0);
+            put<uint32_t>(buffer, record.mode);
+            put<int64_t>(buffer, record.modification_time);
+            put<uint32_t>(buffer, (uint32_t) record.name.size());
+            buffer.insert(buffer.end(), record.name.begin(), record.name.end());
+            break;
+        case JournalOperation::REMOVE_NODE:
+            put<uint64_t>(buffer, record.node);
+            break;
+        case JournalOperation::SET_SIZE:
+        case JournalOperation::EXTEND_SIZE:
+            put<uint64_t>(buffer, record.node);
+            put<uint64_t>(buffer, record.size);
+            put<uint64_t>(buffer, record.allocation_handle);
+            break;
+        case JournalOperation::FILL_RANGE:
+        case JournalOperation::PUNCH_HOLE:
+            put<uint64_t>(buffer, record.node);
+            put<uint64_t>(buffer, record.size);
+            put<uint64_t>(buffer, record.offset);
+            break;
+        case JournalOperation::WRITE_INLINE:
+            put<uint64_t>(buffer, record.node);
+            put<uint64_t>(buffer, record.offset);
+            put<uint32_t>(buffer, (uint32_t) record.data.size());
+            buffer.insert(buffer.end(), record.data.begin(), record.data.end());
+            break;
+        case JournalOperation::SET_MODE:
+            put<uint64_t>(buffer, record.node);
+            put<uint32_t>(buffer, record.mode);
+            break;
+        case JournalOperation::SET_TIMES:
+            put<uint64_t>(buffer, record.node);
+            put<int64_t>(buffer, record.access_time);
+            put<int64_t>(buffer, record.modification_time);
+            break;
+    }
+
+    uint32_t length = (uint32_t) (buffer.size() - start + RECORD_CHECKSUM_SIZE);
+    std::memcpy(buffer.data() + start, &length, sizeof(uint32_t));
+    put<uint32_t>(buffer, checksum(buffer.data() + start + sizeof(uint32_t), buffer.size() - start - sizeof(uint32_t)));
+}
+
+size_t Journal::decode(const char* buffer, size_t available, JournalRecord& record) const {
+    uint32_t length;
+    size_t offset = 0;
+    if (!get(buffer, available, offset, length) || length < RECORD_HEADER_SIZE + RECORD_CHECKSUM_SIZE || length > available) {
+        return 0;
+    }
+
+    // Records of older generations and partially written records are not valid
+    size_t end = length - RECORD_CHECKSUM_SIZE;
+    uint32_t stored_checksum;
+    std::memcpy(&stored_checksum, buffer + end, sizeof(uint32_t));
+    if (stored_checksum != checksum(buffer + sizeof(uint32_t), end - sizeof(uint32_t))) {
+        return 0;
+    }
+
+    uint64_t record_generation;
+    uint8_t operation;
+    get(buffer, end, offset, record_generation);
+    get(buffer, end, offset, operation);
+    if (record_generation != generation) {
+        return 0;
+    }
+
+    record = JournalRecord{(JournalOperation) operation};
+    bool valid = get(buffer, end, offset, record.node);
+    switch (record.operation) {
+        case JournalOperation::INSERT_NODE: {
+            uint8_t is_folder;
+            uint32_t name_length;
+            valid = valid && get(buffer, end, offset, is_folder) && get(buffer, end, offset, record.mode) && get(buffer, end, offset, record.modification_time) && get(buffer, end, offset, name_length);
+            valid = valid && offset + name_length <= end;
+            if (valid) {
+                record.is_folder = is_folder != 0;
+                record.name.assign(buffer + offset, name_length);
+            }
+            break;
+        }
+        case JournalOperation::REMOVE_NODE:
+            break;
+        case JournalOperation::SET_SIZE:
+        case JournalOperation::EXTEND_SIZE:
+            valid = valid && get(buffer, end, offset, record.size) && get(buffer, end, offset, record.allocation_handle);
+            break;
+        case JournalOperation::FILL_RANGE:
+        case JournalOperation::PUNCH_HOLE:
+            valid = valid && get(buffer, end, offset, record.size) && get(buffer, end, offset, record.offset);
+            break;
+        case JournalOperation::WRITE_INLINE: {
+            uint32_t data_length;
+            valid = valid && get(buffer, end, offset, record.offset) && get(buffer, end, offset, data_length);
+            valid = valid && offset + data_length <= end;
+            if (valid) {
+                record.data.assign(buffer + offset, data_length);
+            }
+            break;
+        }
+        case JournalOperation::SET_MODE:
+            valid = valid && get(buffer, end, offset, record.mode);
+            break;
+        case JournalOperation::SET_TIMES:
+            valid = valid && get(buffer, end, offset, record.access_time) && get(buffer, end, offset, record.modification_time);
+            break;
+        default:
+            valid = false;
+    }
+
+    return valid ? length : 0;
+}
+
+bool Journal::append(const JournalRecord& record) {
+    if (full) {
+        // Replaying a later record without the refused one would apply it to the wrong nodes
+        return false;
+    }
+
+    size_t before = pending.size();
+    encode(record, pending);
+
+    if (tail + pending.size() > capacity) {
+        pending.resize(before);
+        full = true;
+        return false;
+    }
+
+    if (pending_records == 0) {
+        first_pending = std::chrono::steady_clock::now();
+    }
+    pending_records++;
+    return true;
+}
+
+void Journal::commit() {
+    if (pending_records == 0) return;
+
+    allocation_manager->write(handle, pending.data(), pending.size(), tail);
+    tail += pending.size();
+    pending.clear();
+    pending_records = 0;
+}
+
+bool Journal::commit_due() const {
+    if (pending_records == 0) return false;
+    return pending_records >= JOURNAL_COMMIT_RECORDS || std::chrono::steady_clock::now() - first_pending >= std::chrono::milliseconds(JOURNAL_COMMIT_MILLISECONDS);
+}
+
+std::vector<JournalRecord> Journal::read() {
+    std::vector<char> buffer(capacity);
+    allocation_manager->read(handle, buffer.data(), capacity, 0);
+
+    std::vector<JournalRecord> records;
+    size_t offset = 0;
+    JournalRecord record;
+    while (size_t length = decode(buffer.data() + offset, capacity - offset, record)) {
+        records.push_back(std::move(record));
+        offset += length;
+    }
+
+    tail = offset;
+    return records;
+}
+
+void Journal::reset(uint64_t new_generation) {
+    generation = new_generation;
+    tail = 0;
+    full = false;
+    pending.clear();
+    pending_records = 0;
+}
@@ -0,0 +1,167 @@
+/**
+ * This file is part of the Succinct Filesystem project.
+ * 
+ * Copyright (c) 2026 Sebastian Brunnert <mail@sebastianbrunnert.de>
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "../allocation/allocation_manager.hpp"
+
+// Default size of the journal region in bytes
+#ifndef JOURNAL_SIZE
+#define JOURNAL_SIZE (1024 * 1024)
+#endif
+
+// Number of pending records after which a group is committed
+#ifndef JOURNAL_COMMIT_RECORDS
+#define JOURNAL_COMMIT_RECORDS 64
+#endif
+
+// Number of milliseconds after which pending records are committed
+#ifndef JOURNAL_COMMIT_MILLISECONDS
+#define JOURNAL_COMMIT_MILLISECONDS 100
+#endif
+
+/**
+ * The logical metadata operations that are recorded in the journal.
+ */
+enum class JournalOperation : uint8_t {
+    INSERT_NODE = 1,
+    REMOVE_NODE = 2,
+    SET_SIZE = 3,
+    SET_MODE = 4,
+    SET_TIMES = 5,
+    EXTEND_SIZE = 6,
+    FILL_RANGE = 7,
+    PUNCH_HOLE = 8,
+    WRITE_INLINE = 9
+};
+
+/**
+ * This structure represents a single logical metadata operation. Only the fields of the respective operation are stored in the journal.
+ */
+struct JournalRecord {
+    JournalOperation operation;
+    // The node the operation refers to, or the parent node for INSERT_NODE
+    uint64_t node = 0;
+    // INSERT_NODE
+    bool is_folder = false;
+    std::string name;
+    // INSERT_NODE and SET_MODE
+    uint32_t mode = 0;
+    // SET_SIZE and EXTEND_SIZE, including the resulting allocation handle (the extent change). FILL_RANGE and PUNCH_HOLE store the size of the range.
+    uint64_t size = 0;
+    uint64_t allocation_handle = 0;
+    // FILL_RANGE, PUNCH_HOLE and WRITE_INLINE
+    uint64_t offset = 0;
+    // WRITE_INLINE, the data of files that are stored inline is not written to blocks, so it is part of the journal
+    std::string data;
+    // SET_TIMES, the modification time is also stored for INSERT_NODE as creation time
+    int64_t access_time = 0;
+    int64_t modification_time = 0;
+
+    /**
+     * Creates a record of an operation with all fields cleared. Decoding overwrites the operation of a default constructed record.
+     * 
+     * @param operation The operation of the record.
+     */
+    explicit JournalRecord(JournalOperation operation = JournalOperation{}) : operation(operation) {}
+};
+
+/**
+ * This class implements a write-ahead journal for metadata operations in a dedicated region of the block device.
+ * Records are buffered in memory and committed in groups with one sequential write. Each checkpoint starts a new generation, so records of older generations are ignored when the journal is read.
+ */
+class Journal {
+private:
+    AllocationManager* allocation_manager;
+    size_t handle;
+    size_t capacity;
+    uint64_t generation;
+
+    // Number of bytes that are already committed in the current generation
+    size_t tail = 0;
+    // Set when a record did not fit. Later records are refused as well, so the journal never skips an operation.
+    bool full = false;
+
+    // Encoded records that are not committed yet
+    std::vector<char> pending;
+    size_t pending_records = 0;
+    std::chrono::steady_clock::time_point first_pending;
+
+    /**
+     * Encodes a record with the current generation.
+     * 
+     * @param record The record to encode.
+     * @param buffer The buffer to append the encoded record to.
+     */
+    void encode(const JournalRecord& record, std::vector<char>& buffer) const;
+
+    /**
+     * Decodes a record of the current generation.
+     * 
+     * @param buffer The buffer containing the encoded record.
+     * @param available The number of bytes available in the buffer.
+     * @param record The record to decode into.
+     * @return The length of the decoded record in bytes or 0 if there is no valid record of the current generation.
+     */
+    size_t decode(const char* buffer, size_t available, JournalRecord& record) const;
+
+public:
+    /**
+     * @param allocation_manager The allocation manager to write the journal region with.
+     * @param handle The allocation handle of the journal region.
+     * @param capacity The size of the journal region in bytes.
+     * @param generation The generation of the current checkpoint.
+     */
+    Journal(AllocationManager* allocation_manager, size_t handle, size_t capacity, uint64_t generation)
+        : allocation_manager(allocation_manager), handle(handle), capacity(capacity), generation(generation) {}
+
+    /**
+     * Appends a record to the pending group.
+     * 
+     * @param record The record to append.
+     * @return true if the record was appended, false if the journal is full and a checkpoint has to be written. Once a record was refused, all records are refused until the next reset.
+     */
+    bool append(const JournalRecord& record);
+
+    /**
+     * Writes all pending records to the journal region with one sequential write.
+     */
+    void commit();
+
+    /**
+     * Checks if the pending group should be committed because it is large or old enough.
+     * 
+     * @return true if the pending records should be committed.
+     */
+    bool commit_due() const;
+
+    /**
+     * Reads all committed records of the current generation from the journal region.
+     * 
+     * @return The records in the order they were appended.
+     */
+    std::vector<JournalRecord> read();
+
+    /**
+     * Starts a new generation after a checkpoint was written. All previous records become invalid.
+     * 
+     * @param new_generation The generation of the new checkpoint.
+     */
+    void reset(uint64_t new_generation);
+
+    /**
+     * @return The generation of the current checkpoint.
+     */
+    uint64_t get_generation() const {
+        return generation;
+    }
+};
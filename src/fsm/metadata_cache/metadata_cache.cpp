@@ -0,0 +1,48 @@
+/**
+ * This file is part of the Succinct Filesystem project.
+ *
+ * Copyright (c) 2026 Sebastian Brunnert <mail@sebastianbrunnert.de>
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "metadata_cache.hpp"
+
+std::optional<uint64_t> MetadataCache::find_entry(uint64_t parent, std::string_view name) {
+    std::lock_guard<std::mutex> lock(entries_mutex);
+    return entries.find({parent, std::string(name)});
+}
+
+void MetadataCache::put_entry(uint64_t parent, std::string_view name, uint64_t inode) {
+    std::lock_guard<std::mutex> lock(entries_mutex);
+    entries.put({parent, std::string(name)}, inode);
+}
+
+void MetadataCache::invalidate_entry(uint64_t parent, std::string_view name) {
+    std::lock_guard<std::mutex> lock(entries_mutex);
+    entries.erase({parent, std::string(name)});
+}
+
+std::optional<struct stat> MetadataCache::find_attributes(uint64_t inode) {
+    std::lock_guard<std::mutex> lock(attributes_mutex);
+    return attributes.find(inode);
+}
+
+void MetadataCache::put_attributes(uint64_t inode, const struct stat& stbuf) {
+    std::lock_guard<std::mutex> lock(attributes_mutex);
+    attributes.put(inode, stbuf);
+}
+
+void MetadataCache::invalidate_attributes(uint64_t inode) {
+    std::lock_guard<std::mutex> lock(attributes_mutex);
+    attributes.erase(inode);
+}
+
+size_t MetadataCache::get_entry_count() {
+    std::lock_guard<std::mutex> lock(entries_mutex);
+    return entries.size();
+}
+
+size_t MetadataCache::get_attribute_count() {
+    std::lock_guard<std::mutex> lock(attributes_mutex);
+    return attributes.size();
+}
@@ -0,0 +1,174 @@
+/**
+ * This file is part of the Succinct Filesystem project.
+ *
+ * Copyright (c) 2026 Sebastian Brunnert <mail@sebastianbrunnert.de>
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <sys/stat.h>
+
+// Default number of lookups and of attributes that are cached each
+#ifndef METADATA_CACHE_ENTRIES
+#define METADATA_CACHE_ENTRIES 65536
+#endif
+
+/**
+ * This class caches the results of lookups and the attributes of files and directories by their stable inode numbers, so repeated requests do not walk the FLOUDS and the inodes again.
+ * Stable inode numbers do not change when other nodes are inserted or removed, so items only have to be invalidated when their own node changes.
+ * Both parts are bounded and evict their least recently used items. All methods may be called concurrently.
+ */
+class MetadataCache {
+private:
+    /**
+     * A map of bounded size that evicts its least recently used item.
+     */
+    template <typename Key, typename Value, typename Hash = std::hash<Key>>
+    class LruMap {
+    private:
+        size_t capacity;
+        // Most recently used items first
+        std::list<std::pair<Key, Value>> items;
+        std::unordered_map<Key, typename std::list<std::pair<Key, Value>>::iterator, Hash> index;
+
+    public:
+        LruMap(size_t capacity) : capacity(capacity) {}
+
+        std::optional<Value> find(const Key& key) {
+            auto it = index.find(key);
+            if (it == index.end()) {
+                return std::nullopt;
+            }
+            items.splice(items.begin(), items, it->second);
+            return it->second->second;
+        }
+
+        void put(const Key& key, const Value& value) {
+            auto it = index.find(key);
+            if (it != index.end()) {
+                it->second->second = value;
+                items.splice(items.begin(), items, it->second);
+                return;
+            }
+            if (capacity == 0) {
+                return;
+            }
+            if (items.size() >= capacity) {
+                index.erase(items.back().first);
+                items.pop_back();
+            }
+            items.emplace_front(key, value);
+            index.emplace(key, items.begin());
+        }
+
+        void erase(const Key& key) {
+            auto it = index.find(key);
+            if (it != index.end()) {
+                items.erase(it->second);
+                index.erase(it);
+            }
+        }
+
+        size_t size() const {
+            return items.size();
+        }
+    };
+
+    struct EntryKey {
+        uint64_t parent;
+        std::string name;
+
+        bool operator==(const EntryKey& other) const {
+            return parent == other.parent && name == other.name;
+        }
+    };
+
+    struct EntryKeyHash {
+        size_t operator()(const EntryKey& key) const {
+            return std::hash<std::string_view>{}(key.name) ^ (std::hash<uint64_t>{}(key.parent) * 0x9e3779b97f4a7c15ull);
+        }
+    };
+
+    // Child stable inode by parent stable inode and name
+    LruMap<EntryKey, uint64_t, EntryKeyHash> entries;
+    std::mutex entries_mutex;
+
+    // Attributes by stable inode
+    LruMap<uint64_t, struct stat> attributes;
+    std::mutex attributes_mutex;
+
+public:
+    /**
+     * @param capacity The number of lookups and of attributes that are cached each.
+     */
+    MetadataCache(size_t capacity = METADATA_CACHE_ENTRIES) : entries(capacity), attributes(capacity) {}
+
+    /**
+     * Looks up the child of a directory.
+     *
+     * @param parent The stable inode number of the directory.
+     * @param name The name of the child.
+     * @return The stable inode number of the child or nothing if the lookup is not cached.
+     */
+    std::optional<uint64_t> find_entry(uint64_t parent, std::string_view name);
+
+    /**
+     * Caches the result of a lookup.
+     *
+     * @param parent The stable inode number of the directory.
+     * @param name The name of the child.
+     * @param inode The stable inode number of the child.
+     */
+    void put_entry(uint64_t parent, std::string_view name, uint64_t inode);
+
+    /**
+     * Removes a lookup from the cache, e.g. because the child was removed.
+     *
+     * @param parent The stable inode number of the directory.
+     * @param name The name of the child.
+     */
+    void invalidate_entry(uint64_t parent, std::string_view name);
+
+    /**
+     * Gets the attributes of a file or directory.
+     *
+     * @param inode The stable inode number.
+     * @return The attributes or nothing if they are not cached.
+     */
+    std::optional<struct stat> find_attributes(uint64_t inode);
+
+    /**
+     * Caches the attributes of a file or directory. The caller must hold the lock of the inode, so the attributes cannot be outdated by a concurrent change.
+     *
+     * @param inode The stable inode number.
+     * @param stbuf The attributes.
+     */
+    void put_attributes(uint64_t inode, const struct stat& stbuf);
+
+    /**
+     * Removes the attributes of a file or directory from the cache. Must be called by every change of the attributes while the lock of the inode is held.
+     *
+     * @param inode The stable inode number.
+     */
+    void invalidate_attributes(uint64_t inode);
+
+    /**
+     * @return The number of cached lookups.
+     */
+    size_t get_entry_count();
+
+    /**
+     * @return The number of cached attributes.
+     */
+    size_t get_attribute_count();
+};
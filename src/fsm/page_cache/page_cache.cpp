@@ -0,0 +1,136 @@
+/**
+ * This file is part of the Succinct Filesystem project.
+ *
+ * Copyright (c) 2026 Sebastian Brunnert <mail@sebastianbrunnert.de>
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "page_cache.hpp"
+#include <algorithm>
+#include <cstring>
+
+bool PageCache::write(size_t inode, const char* buffer, size_t size, size_t offset) {
+    if (size == 0) return true;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    File& file = files[inode];
+    size_t first_page = offset / page_size;
+    size_t last_page = (offset + size - 1) / page_size;
+
+    // Check all pages first, so a rejected write does not change anything
+    for (size_t index = first_page; index <= last_page; index++) {
+        auto it = file.pages.find(index);
+        if (it == file.pages.end()) continue;
+
+        size_t page_offset = index * page_size;
+        size_t begin = std::max(offset, page_offset) - page_offset;
+        size_t end = std::min(offset + size, page_offset + page_size) - page_offset;
+        if (end < it->second.begin || begin > it->second.end) {
+            return false;
+        }
+    }
+
+    for (size_t index = first_page; index <= last_page; index++) {
+        size_t page_offset = index * page_size;
+        size_t begin = std::max(offset, page_offset) - page_offset;
+        size_t end = std::min(offset + size, page_offset + page_size) - page_offset;
+
+        auto it = file.pages.find(index);
+        if (it == file.pages.end()) {
+            it = file.pages.emplace(index, Page{std::make_unique<char[]>(page_size), begin, end}).first;
+            dirty_pages++;
+        }
+        Page& page = it->second;
+        std::memcpy(page.data.get() + begin, buffer + (page_offset + begin - offset), end - begin);
+        page.begin = std::min(page.begin, begin);
+        page.end = std::max(page.end, end);
+    }
+
+    file.end = std::max(file.end, offset + size);
+    return true;
+}
+
+void PageCache::read(size_t inode, char* buffer, size_t size, size_t offset) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto file = files.find(inode);
+    if (file == files.end()) return;
+
+    for (auto it = file->second.pages.lower_bound(offset / page_size); it != file->second.pages.end(); it++) {
+        size_t page_offset = it->first * page_size;
+        if (page_offset >= offset + size) break;
+
+        // Intersection of the dirty range with the requested range
+        size_t begin = std::max(page_offset + it->second.begin, offset);
+        size_t end = std::min(page_offset + it->second.end, offset + size);
+        if (begin < end) {
+            std::memcpy(buffer + (begin - offset), it->second.data.get() + (begin - page_offset), end - begin);
+        }
+    }
+}
+
+std::vector<DirtyRun> PageCache::take(size_t inode) {
+    std::vector<DirtyRun> runs;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto file = files.find(inode);
+    if (file == files.end()) return runs;
+
+    for (const auto& [index, page] : file->second.pages) {
+        size_t begin = index * page_size + page.begin;
+        // Coalesce dirty ranges that continue the previous run
+        if (runs.empty() || runs.back().offset + runs.back().data.size() != begin) {
+            runs.push_back(DirtyRun{begin, {}});
+        }
+        runs.back().data.insert(runs.back().data.end(), page.data.get() + page.begin, page.data.get() + page.end);
+    }
+
+    dirty_pages -= file->second.pages.size();
+    files.erase(file);
+    return runs;
+}
+
+bool PageCache::contains(size_t inode) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return files.count(inode) > 0;
+}
+
+size_t PageCache::get_end(size_t inode) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto file = files.find(inode);
+    return file == files.end() ? 0 : file->second.end;
+}
+
+std::vector<size_t> PageCache::get_inodes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<size_t> inodes;
+    for (const auto& [inode, file] : files) {
+        inodes.push_back(inode);
+    }
+    return inodes;
+}
+
+void PageCache::insert_inode(size_t inode) {
+    std::lock_guard<std::mutex> lock(mutex);
+    // Move the files from the back, so no inode number is taken twice
+    for (auto it = files.end(); it != files.begin() && std::prev(it)->first >= inode;) {
+        auto node = files.extract(std::prev(it));
+        node.key()++;
+        it = files.insert(std::move(node)).position;
+    }
+}
+
+void PageCache::remove_inode(size_t inode) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto file = files.find(inode);
+    if (file != files.end()) {
+        dirty_pages -= file->second.pages.size();
+        files.erase(file);
+    }
+
+    for (auto it = files.upper_bound(inode); it != files.end();) {
+        auto next = std::next(it);
+        auto node = files.extract(it);
+        node.key()--;
+        files.insert(std::move(node));
+        it = next;
+    }
+}
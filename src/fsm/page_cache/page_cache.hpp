@@ -0,0 +1,139 @@
+/**
+ * This file is part of the Succinct Filesystem project.
+ *
+ * Copyright (c) 2026 Sebastian Brunnert <mail@sebastianbrunnert.de>
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Default number of dirty pages all files may hold together before they are written back
+#ifndef PAGE_CACHE_PAGES
+#define PAGE_CACHE_PAGES 4096
+#endif
+
+/**
+ * A contiguous range of dirty bytes of a file.
+ */
+struct DirtyRun {
+    size_t offset;
+    std::vector<char> data;
+};
+
+/**
+ * This class buffers written file data in memory until it is written back, so the space of a file can be allocated once for all buffered writes.
+ * Pages are kept per inode and hold one contiguous dirty range each. Adjacent dirty ranges are coalesced into runs when a file is written back.
+ * All methods may be called concurrently, but the pages of one inode must only be changed by one thread at a time.
+ */
+class PageCache {
+private:
+    struct Page {
+        std::unique_ptr<char[]> data;
+        // Dirty range within the page
+        size_t begin;
+        size_t end;
+    };
+
+    struct File {
+        std::map<size_t, Page> pages;
+        // End of the last dirty byte of the file
+        size_t end = 0;
+    };
+
+    size_t page_size;
+    size_t capacity;
+    std::map<size_t, File> files;
+    size_t dirty_pages = 0;
+
+    mutable std::mutex mutex;
+
+public:
+    /**
+     * @param page_size The size of a page in bytes, typically the block size.
+     * @param capacity The number of dirty pages after which files should be written back.
+     */
+    PageCache(size_t page_size, size_t capacity = PAGE_CACHE_PAGES) : page_size(page_size), capacity(capacity) {}
+
+    /**
+     * Stores written data of a file.
+     *
+     * @param inode The inode number of the file.
+     * @param buffer The written data.
+     * @param size The number of bytes written.
+     * @param offset The offset within the file.
+     * @return false if the write would leave a gap within a dirty page. Nothing is stored then and the file has to be written back first.
+     */
+    bool write(size_t inode, const char* buffer, size_t size, size_t offset);
+
+    /**
+     * Copies the dirty bytes of a file that lie in the given range into the buffer. Other bytes of the buffer are not changed.
+     *
+     * @param inode The inode number of the file.
+     * @param buffer The buffer to copy into. Must be at least size bytes.
+     * @param size The number of bytes to read.
+     * @param offset The offset within the file.
+     */
+    void read(size_t inode, char* buffer, size_t size, size_t offset) const;
+
+    /**
+     * Removes all dirty data of a file.
+     *
+     * @param inode The inode number of the file.
+     * @return The dirty data as runs of contiguous bytes in ascending order.
+     */
+    std::vector<DirtyRun> take(size_t inode);
+
+    /**
+     * @return true if the file has dirty data.
+     */
+    bool contains(size_t inode) const;
+
+    /**
+     * @return The end of the last dirty byte of the file or 0 if it has no dirty data.
+     */
+    size_t get_end(size_t inode) const;
+
+    /**
+     * @return The inode numbers of all files with dirty data.
+     */
+    std::vector<size_t> get_inodes() const;
+
+    /**
+     * Shifts the inode numbers of the cached files after a node was inserted at the given inode number.
+     */
+    void insert_inode(size_t inode);
+
+    /**
+     * Drops the dirty data of a removed node and shifts the inode numbers of the files behind it.
+     */
+    void remove_inode(size_t inode);
+
+    /**
+     * @return true if the files hold more dirty pages than the capacity allows.
+     */
+    bool over_capacity() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return dirty_pages > capacity;
+    }
+
+    /**
+     * @return The number of bytes that the capacity allows.
+     */
+    size_t get_capacity_bytes() const {
+        return capacity * page_size;
+    }
+
+    /**
+     * @return The number of dirty pages of all files.
+     */
+    size_t get_dirty_pages() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return dirty_pages;
+    }
+};
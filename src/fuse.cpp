@@ -13,15 +13,37 @@
 #include <stddef.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
 #include "fsm/file_system_manager.hpp"
-#include "fsm/delta/delta_stabilization.hpp"
+#include "fsm/metadata_cache/metadata_cache.hpp"
+
+// Number of seconds the kernel may cache entries and attributes. Inode numbers are stable and all changes pass through this filesystem, so the kernel's copies stay valid.
+// The kernel updates its caches itself for the changes it requests. Notifying it from within these requests would deadlock, as it holds the lock of the directory meanwhile.
+#ifndef CACHE_TIMEOUT
+#define CACHE_TIMEOUT 1000.0
+#endif
 
 FileSystemManager* file_system_manager = nullptr;
-DeltaStabilization* delta_stabilization = new DeltaStabilization();
+BlockDeviceBackend block_device_backend = BlockDeviceBackend::FILE;
+// Whether the kernel decides per directory if listings return the attributes of the entries (--readdirplus-always disables it)
+bool readdirplus_adaptive = true;
+
+// Requests that only read the filesystem (lookup, getattr, open, read, readdir, statfs) hold this lock shared and run in parallel.
+// Writes of file data hold it shared too and additionally hold the lock of their inode exclusively, so writes of different files run in parallel.
+// Requests that modify the structure or the metadata of the filesystem hold it exclusively.
+static std::shared_mutex filesystem_mutex;
+
+// Lookups and attributes by stable inode, so requests the kernel cache misses do not walk the FLOUDS again.
+// Changes invalidate their items while they hold the locks the cache is filled under.
+static MetadataCache metadata_cache;
 
 static bool try_resolve_inode(fuse_req_t req, fuse_ino_t stable_inode, size_t& node) {
-    auto resolved_inode = delta_stabilization->stable_inode_to_flouds_inode(stable_inode);
+    auto resolved_inode = file_system_manager->get_delta_stabilization()->stable_inode_to_flouds_inode(stable_inode);
     if (!resolved_inode.has_value()) {
         fuse_reply_err(req, ESTALE);
         return false;
@@ -31,6 +53,62 @@ static bool try_resolve_inode(fuse_req_t req, fuse_ino_t stable_inode, size_t& n
     return true;
 }
 
+/**
+ * Fills the attributes of a file or directory from the metadata cache or from its inode.
+ * 
+ * @param node The FLOUDS index of the file or directory.
+ * @param ino The inode number the kernel knows the file or directory by.
+ * @param stbuf The attributes to fill.
+ * @return false if the node is neither a file nor a directory.
+ */
+static bool fill_attributes(size_t node, fuse_ino_t ino, struct stat *stbuf) {
+    auto cached = metadata_cache.find_attributes(ino);
+    if (cached.has_value()) {
+        *stbuf = *cached;
+        return true;
+    }
+
+    Flouds* flouds = file_system_manager->get_flouds();
+    memset(stbuf, 0, sizeof(*stbuf));
+    stbuf->st_ino = ino;
+
+    std::shared_lock<std::shared_mutex> inode_lock(file_system_manager->get_inode_lock(node));
+    Inode* inode = file_system_manager->get_inode(node);
+    
+    if (flouds->is_folder(node)) {
+        stbuf->st_mode = S_IFDIR | inode->mode;
+        stbuf->st_nlink = 2;
+    } else if (flouds->is_file(node)) {
+        stbuf->st_mode = S_IFREG | inode->mode;
+        stbuf->st_nlink = 1;
+        stbuf->st_size = file_system_manager->get_file_size(node);
+    } else {
+        return false;
+    }
+
+    // Concurrent reads update the access time
+    stbuf->st_atime = std::atomic_ref<time_t>(inode->access_time).load(std::memory_order_relaxed);
+    stbuf->st_mtime = inode->modification_time;
+    stbuf->st_ctime = inode->creation_time;
+    metadata_cache.put_attributes(ino, *stbuf);
+    return true;
+}
+
+/**
+ * Fills the entry of a file or directory that lookup and readdirplus hand to the kernel.
+ * 
+ * @param node The FLOUDS index of the file or directory.
+ * @param entry The entry to fill.
+ */
+static void fill_entry(size_t node, struct fuse_entry_param *entry) {
+    memset(entry, 0, sizeof(*entry));
+    entry->ino = file_system_manager->get_delta_stabilization()->flouds_inode_to_stable_inode(node);
+    fill_attributes(node, entry->ino, &entry->attr);
+
+    entry->attr_timeout = CACHE_TIMEOUT;
+    entry->entry_timeout = CACHE_TIMEOUT;
+}
+
 /**
  * This function is called when the FUSE session is being initialized. It can be used to set up any necessary state or resources for the filesystem.
  * 
@@ -41,7 +119,16 @@ static void flouds_init(void *userdata, struct fuse_conn_info *conn) {
     const char *image_path = (const char*) userdata;
 
     file_system_manager = new FileSystemManager();
-    file_system_manager->mount(image_path);
+    file_system_manager->mount(image_path, block_device_backend);
+
+    // Directory listings return the attributes of the entries, so the kernel does not have to look up each entry afterwards.
+    // In the adaptive mode the kernel only asks for them if entries of the directory were looked up before, so plain listings stay cheap.
+    fuse_set_feature_flag(conn, FUSE_CAP_READDIRPLUS);
+    if (readdirplus_adaptive) {
+        fuse_set_feature_flag(conn, FUSE_CAP_READDIRPLUS_AUTO);
+    } else {
+        fuse_unset_feature_flag(conn, FUSE_CAP_READDIRPLUS_AUTO);
+    }
 }
 
 /**
@@ -62,6 +149,25 @@ static void flouds_destroy(void *userdata) {
  * @param name The name of the entry being looked up within the parent directory.
  */
 static void flouds_lookup(fuse_req_t req, fuse_ino_t parent, const char *name) {
+    std::shared_lock<std::shared_mutex> lock(filesystem_mutex);
+    struct fuse_entry_param entry;
+
+    // Cached lookups are answered without resolving the directory
+    auto cached_child = metadata_cache.find_entry(parent, name);
+    if (cached_child.has_value()) {
+        auto cached_attributes = metadata_cache.find_attributes(*cached_child);
+        if (cached_attributes.has_value()) {
+            memset(&entry, 0, sizeof(entry));
+            entry.ino = *cached_child;
+            entry.attr = *cached_attributes;
+            entry.attr_timeout = CACHE_TIMEOUT;
+            entry.entry_timeout = CACHE_TIMEOUT;
+            file_system_manager->get_delta_stabilization()->record_lookup(entry.ino);
+            fuse_reply_entry(req, &entry);
+            return;
+        }
+    }
+
     size_t parent_node;
     if (!try_resolve_inode(req, parent, parent_node)) {
         return;
@@ -76,40 +182,47 @@ static void flouds_lookup(fuse_req_t req, fuse_ino_t parent, const char *name) {
     }
     
     // Search for the child with the given name
-    size_t num_children = flouds->children_count(parent_node);
-    for (size_t i = 0; i < num_children; i++) {
-        size_t child_node = flouds->child(parent_node, i);
-        if (flouds->get_name(child_node) == name) {
-            // Found the child
-            struct fuse_entry_param entry;
-            memset(&entry, 0, sizeof(entry));
-            
-            entry.ino = delta_stabilization->flouds_inode_to_stable_inode(child_node);
-            entry.attr.st_ino = entry.ino;
-            entry.attr.st_nlink = flouds->is_folder(child_node) ? 2 : 1;
-            
-            if (flouds->is_folder(child_node)) {
-                entry.attr.st_mode = S_IFDIR | 0755;
-            } else {
-                entry.attr.st_mode = S_IFREG | 0644;
-                entry.attr.st_size = file_system_manager->get_inode(child_node)->size;
-            }
-            
-            #ifdef DELTA_STABILIZATION
-            entry.attr_timeout = 1000;
-            entry.entry_timeout = 1000;
-            #else 
-            entry.attr_timeout = 0;
-            entry.entry_timeout = 0;
-            #endif
-            
-            fuse_reply_entry(req, &entry);
-            return;
-        }
+    size_t child_node;
+    try {
+        child_node = flouds->find_child(parent_node, name);
+    } catch (const std::out_of_range&) {
+        // Child not found
+        fuse_reply_err(req, ENOENT);
+        return;
     }
-    
-    // Child not found
-    fuse_reply_err(req, ENOENT);
+
+    fill_entry(child_node, &entry);
+    metadata_cache.put_entry(parent, name, entry.ino);
+    file_system_manager->get_delta_stabilization()->record_lookup(entry.ino);
+    fuse_reply_entry(req, &entry);
+}
+
+/**
+ * This function is called when the kernel removes an inode from its cache. The inode number stays reserved until the kernel forgot all its lookups.
+ * Lookups are counted independently of the filesystem lock, so forgetting does not wait for other requests.
+ * 
+ * @param req The request handle, which is answered without a reply.
+ * @param ino The inode number of the forgotten file or directory.
+ * @param nlookup The number of lookups to forget.
+ */
+static void flouds_forget(fuse_req_t req, fuse_ino_t ino, uint64_t nlookup) {
+    file_system_manager->get_delta_stabilization()->record_forget(ino, nlookup);
+    fuse_reply_none(req);
+}
+
+/**
+ * This function is called when the kernel removes several inodes from its cache at once.
+ * 
+ * @param req The request handle, which is answered without a reply.
+ * @param count The number of forgotten inodes.
+ * @param forgets The inode numbers and the number of lookups to forget for each of them.
+ */
+static void flouds_forget_multi(fuse_req_t req, size_t count, struct fuse_forget_data *forgets) {
+    DeltaStabilization* delta_stabilization = file_system_manager->get_delta_stabilization();
+    for (size_t i = 0; i < count; i++) {
+        delta_stabilization->record_forget(forgets[i].ino, forgets[i].nlookup);
+    }
+    fuse_reply_none(req);
 }
 
 /**
@@ -120,35 +233,25 @@ static void flouds_lookup(fuse_req_t req, fuse_ino_t parent, const char *name) {
  * @param fi Internal file information.
  */
 static void flouds_getattr(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi) {
-    struct stat stbuf;
-    memset(&stbuf, 0, sizeof(stbuf));
-    
-    Flouds* flouds = file_system_manager->get_flouds();
-    stbuf.st_ino = ino;
+    std::shared_lock<std::shared_mutex> lock(filesystem_mutex);
+    auto cached = metadata_cache.find_attributes(ino);
+    if (cached.has_value()) {
+        fuse_reply_attr(req, &*cached, CACHE_TIMEOUT);
+        return;
+    }
 
     size_t node;
     if (!try_resolve_inode(req, ino, node)) {
         return;
     }
-    Inode* inode = file_system_manager->get_inode(node);
-    
-    if (flouds->is_folder(node)) {
-        stbuf.st_mode = S_IFDIR | inode->mode;
-        stbuf.st_nlink = 2;
-    } else if (flouds->is_file(node)) {
-        stbuf.st_mode = S_IFREG | inode->mode;
-        stbuf.st_nlink = 1;
-        stbuf.st_size = inode->size;
-    } else {
+
+    struct stat stbuf;
+    if (!fill_attributes(node, ino, &stbuf)) {
         fuse_reply_err(req, ENOENT);
         return;
     }
-
-    stbuf.st_atime = inode->access_time;
-    stbuf.st_mtime = inode->modification_time;
-    stbuf.st_ctime = inode->creation_time;
     
-    fuse_reply_attr(req, &stbuf, 1.0);
+    fuse_reply_attr(req, &stbuf, CACHE_TIMEOUT);
 }
 
 /**
@@ -161,6 +264,7 @@ static void flouds_getattr(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info
  * @param fi Internal file information.
  */
 static void flouds_setattr(fuse_req_t req, fuse_ino_t ino, struct stat *attr, int to_set, struct fuse_file_info *fi) {
+    std::unique_lock<std::shared_mutex> lock(filesystem_mutex);
     Flouds* flouds = file_system_manager->get_flouds();
 
     size_t node;
@@ -172,19 +276,17 @@ static void flouds_setattr(fuse_req_t req, fuse_ino_t ino, struct stat *attr, in
     try {
         // Handle different attribute changes
         if (to_set & FUSE_SET_ATTR_MODE) {
-            inode->mode = attr->st_mode;
+            file_system_manager->set_mode(node, attr->st_mode);
         }
         
         if (to_set & FUSE_SET_ATTR_SIZE && flouds->is_file(node)) {
             file_system_manager->set_file_size(node, attr->st_size);
         }
         
-        if (to_set & FUSE_SET_ATTR_ATIME) {
-            inode->access_time = attr->st_atime;
-        }
-        
-        if (to_set & FUSE_SET_ATTR_MTIME) {
-            inode->modification_time = attr->st_mtime;
+        if (to_set & (FUSE_SET_ATTR_ATIME | FUSE_SET_ATTR_MTIME)) {
+            time_t access_time = (to_set & FUSE_SET_ATTR_ATIME) ? attr->st_atime : inode->access_time;
+            time_t modification_time = (to_set & FUSE_SET_ATTR_MTIME) ? attr->st_mtime : inode->modification_time;
+            file_system_manager->set_times(node, access_time, modification_time);
         }
         
         // Return the updated attributes
@@ -198,16 +300,17 @@ static void flouds_setattr(fuse_req_t req, fuse_ino_t ino, struct stat *attr, in
         } else if (flouds->is_file(node)) {
             stbuf.st_mode = S_IFREG | inode->mode;
             stbuf.st_nlink = 1;
-            stbuf.st_size = inode->size;
+            stbuf.st_size = file_system_manager->get_file_size(node);
         }
         
         stbuf.st_atime = inode->access_time;
         stbuf.st_mtime = inode->modification_time;
         stbuf.st_ctime = inode->creation_time;
 
-        file_system_manager->save();
+        metadata_cache.put_attributes(ino, stbuf);
+        file_system_manager->checkpoint();
 
-        fuse_reply_attr(req, &stbuf, 1.0);
+        fuse_reply_attr(req, &stbuf, CACHE_TIMEOUT);
     } catch (...) {
         fuse_reply_err(req, EIO);
     }
@@ -221,6 +324,7 @@ static void flouds_setattr(fuse_req_t req, fuse_ino_t ino, struct stat *attr, in
  * @param fi Internal file information that can be used to store state about the open file.
  */
 static void flouds_open(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi) {
+    std::shared_lock<std::shared_mutex> lock(filesystem_mutex);
     size_t node;
     if (!try_resolve_inode(req, ino, node)) {
         return;
@@ -246,6 +350,7 @@ static void flouds_open(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *f
  * @param fi Internal file information that can be used to store state about the open file.
  */
 static void flouds_read(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off, struct fuse_file_info *fi) {
+    std::shared_lock<std::shared_mutex> lock(filesystem_mutex);
     size_t node;
     if (!try_resolve_inode(req, ino, node)) {
         return;
@@ -257,21 +362,34 @@ static void flouds_read(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off,
         return;
     }
 
-    Inode* inode = file_system_manager->get_inode(node);
+    // Held until the reply is sent, so a memory mapped view is not modified while FUSE copies it
+    std::shared_lock<std::shared_mutex> inode_lock(file_system_manager->get_inode_lock(node));
+    // Buffered data that is not allocated yet counts towards the size
+    size_t file_size = file_system_manager->get_file_size(node);
     
     // Don't read beyond file size
-    if (off >= inode->size) {
+    if (off >= file_size) {
         fuse_reply_buf(req, NULL, 0);
         return;
     }
     
     // Adjust size if reading beyond end of file
-    if (off + size > inode->size) {
-        size = inode->size - off;
+    if (off + size > file_size) {
+        size = file_size - off;
+    }
+
+    // Memory mapped data can be passed to FUSE without copying it first
+    // Reads update the access time. A concurrent getattr may still cache the previous one, so access times may lag behind.
+    const char* data = file_system_manager->view_file(node, size, off);
+    if (data != nullptr) {
+        metadata_cache.invalidate_attributes(ino);
+        fuse_reply_buf(req, data, size);
+        return;
     }
 
     char* buffer = new char[size];
     file_system_manager->read_file(node, buffer, size, off);
+    metadata_cache.invalidate_attributes(ino);
     
     fuse_reply_buf(req, buffer, size);
     delete[] buffer;
@@ -288,6 +406,7 @@ static void flouds_read(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off,
  * @param fi Internal file information that can be used to store state about the open file.
  */
 static void flouds_write(fuse_req_t req, fuse_ino_t ino, const char *buf, size_t size, off_t off, struct fuse_file_info *fi) {
+    std::shared_lock<std::shared_mutex> lock(filesystem_mutex);
     size_t node;
     if (!try_resolve_inode(req, ino, node)) {
         return;
@@ -300,9 +419,20 @@ static void flouds_write(fuse_req_t req, fuse_ino_t ino, const char *buf, size_t
     }
 
     try {
-        Inode* inode = file_system_manager->get_inode(node);
-        file_system_manager->write_file(node, buf, size, off);
-        file_system_manager->save();
+        bool checkpoint_due;
+        {
+            std::unique_lock<std::shared_mutex> inode_lock(file_system_manager->get_inode_lock(node));
+            file_system_manager->write_file(node, buf, size, off);
+            metadata_cache.invalidate_attributes(ino);
+            checkpoint_due = file_system_manager->count_operation();
+        }
+
+        if (checkpoint_due) {
+            // Checkpoints serialize all components, so other requests have to wait
+            lock.unlock();
+            std::unique_lock<std::shared_mutex> exclusive_lock(filesystem_mutex);
+            file_system_manager->checkpoint_if_due();
+        }
         fuse_reply_write(req, size);
     } catch (...) {
         fuse_reply_err(req, EIO);
@@ -310,91 +440,212 @@ static void flouds_write(fuse_req_t req, fuse_ino_t ino, const char *buf, size_t
 }
 
 /**
- * This function is called when the contents of a directory are being read.
+ * This function is called when the contents of a file should be synchronized with the storage.
  * 
- * @param req The request handle that contains information about the readdir request and is used to send the response back to the kernel.
- * @param ino The inode number of the directory whose contents are being read.
- * @param size The size of the buffer provided for reading the directory entries.
- * @param off The offset within the directory entries from which to start reading.
- * @param fi Internal file information.
+ * @param req The request handle that contains information about the fsync request and is used to send the response back to the kernel.
+ * @param ino The inode number of the file being synchronized.
+ * @param datasync If non-zero, only the user data should be flushed, not the metadata.
+ * @param fi Internal file information that can be used to store state about the open file.
  */
-static void flouds_readdir(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off, struct fuse_file_info *fi) {
+static void flouds_fsync(fuse_req_t req, fuse_ino_t ino, int datasync, struct fuse_file_info *fi) {
+    std::unique_lock<std::shared_mutex> lock(filesystem_mutex);
+    try {
+        file_system_manager->sync();
+        fuse_reply_err(req, 0);
+    } catch (...) {
+        fuse_reply_err(req, EIO);
+    }
+}
+
+/**
+ * This function is called when the last file descriptor of an open file is closed.
+ * 
+ * @param req The request handle that contains information about the release request and is used to send the response back to the kernel.
+ * @param ino The inode number of the file being released.
+ * @param fi Internal file information that can be used to store state about the open file.
+ */
+static void flouds_release(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi) {
+    std::shared_lock<std::shared_mutex> lock(filesystem_mutex);
     size_t node;
     if (!try_resolve_inode(req, ino, node)) {
         return;
     }
-    
+
+    try {
+        std::unique_lock<std::shared_mutex> inode_lock(file_system_manager->get_inode_lock(node));
+        #ifdef DELAYED_ALLOCATION
+        // The file is complete, so its buffered data is allocated and written now
+        file_system_manager->flush_file(node);
+        #endif
+        // The file will not grow any further, so the space reserved behind it is released
+        file_system_manager->trim_file(node);
+    } catch (...) {
+        fuse_reply_err(req, EIO);
+        return;
+    }
+    fuse_reply_err(req, 0);
+}
+
+/**
+ * The position of the children of an open directory in the FLOUDS. It is kept from opendir to releasedir, so readdir continues without searching the tree again.
+ */
+struct DirectoryCursor {
+    // The version of the FLOUDS the position was determined in. Node indexes shift when the tree is modified.
+    size_t version;
+    size_t node;
+    size_t first_child;
+    size_t children_count;
+};
+
+/**
+ * Determines the position of the children of a directory. The children of a folder are stored next to each other, so they are located once and then iterated directly.
+ */
+static void locate_children(Flouds* flouds, size_t node, DirectoryCursor* cursor) {
+    cursor->version = flouds->get_version();
+    cursor->node = node;
+    cursor->children_count = flouds->children_count(node);
+    cursor->first_child = cursor->children_count > 0 ? flouds->child(node, 0) : 0;
+}
+
+/**
+ * This function is called when a directory is being opened.
+ * 
+ * @param req The request handle that contains information about the opendir request and is used to send the response back to the kernel.
+ * @param ino The inode number of the directory being opened.
+ * @param fi Internal file information, which keeps the cursor of the directory.
+ */
+static void flouds_opendir(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi) {
+    std::shared_lock<std::shared_mutex> lock(filesystem_mutex);
+    size_t node;
+    if (!try_resolve_inode(req, ino, node)) {
+        return;
+    }
+
     Flouds* flouds = file_system_manager->get_flouds();
     if (!flouds->is_folder(node)) {
         fuse_reply_err(req, ENOTDIR);
         return;
     }
 
-    struct stat stbuf;
-    memset(&stbuf, 0, sizeof(stbuf));
-    
-    char buf[4096];
-    size_t bufsize = sizeof(buf);
-    char *p = buf;
-    size_t rem = bufsize;
-    
-    off_t current_off = 0;
-    
-    // Add "." entry
-    if (off <= current_off) {
-        stbuf.st_ino = ino;
-        stbuf.st_mode = S_IFDIR;
-        size_t entsize = fuse_add_direntry(req, p, rem, ".", &stbuf, current_off + 1);
-        if (entsize > rem) {
-            fuse_reply_buf(req, buf, bufsize - rem);
-            return;
-        }
-        p += entsize;
-        rem -= entsize;
+    DirectoryCursor* cursor = new DirectoryCursor();
+    locate_children(flouds, node, cursor);
+    fi->fh = (uint64_t) cursor;
+    fuse_reply_open(req, fi);
+}
+
+/**
+ * Reads the entries of a directory for readdir and readdirplus.
+ * 
+ * @param req The request handle that is used to send the entries back to the kernel.
+ * @param ino The inode number of the directory whose contents are being read.
+ * @param size The size of the buffer provided for reading the directory entries.
+ * @param off The offset within the directory entries from which to start reading.
+ * @param fi Internal file information, which keeps the cursor of the directory.
+ * @param plus Whether the entries contain the attributes of the children.
+ */
+static void read_directory(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off, struct fuse_file_info *fi, bool plus) {
+    std::shared_lock<std::shared_mutex> lock(filesystem_mutex);
+    size_t node;
+    if (!try_resolve_inode(req, ino, node)) {
+        return;
     }
-    current_off++;
     
-    // Add ".." entry
-    if (off <= current_off) {
-        stbuf.st_ino = ino;
-        stbuf.st_mode = S_IFDIR;
-        size_t entsize = fuse_add_direntry(req, p, rem, "..", &stbuf, current_off + 1);
+    Flouds* flouds = file_system_manager->get_flouds();
+    DirectoryCursor* cursor = (DirectoryCursor*) fi->fh;
+    if (cursor->version != flouds->get_version() || cursor->node != node) {
+        // The tree was modified since the last call, so the children may have moved
+        locate_children(flouds, node, cursor);
+    }
+
+    // The reply is filled up to the size the kernel offers
+    std::vector<char> buf(size);
+    char *p = buf.data();
+    size_t rem = size;
+
+    // Adds the current entry to the reply and returns false if it does not fit anymore
+    struct fuse_entry_param entry;
+    auto add_entry = [&](const char* name, off_t next_off) {
+        size_t entsize = plus ? fuse_add_direntry_plus(req, p, rem, name, &entry, next_off) : fuse_add_direntry(req, p, rem, name, &entry.attr, next_off);
         if (entsize > rem) {
-            fuse_reply_buf(req, buf, bufsize - rem);
-            return;
+            return false;
         }
         p += entsize;
         rem -= entsize;
+        return true;
+    };
+
+    // The offsets 0 and 1 are "." and "..", the offset of the i-th child is i + 2.
+    // The kernel does not look up "." and "..", so their entries carry no inode.
+    memset(&entry, 0, sizeof(entry));
+    entry.attr.st_ino = ino;
+    entry.attr.st_mode = S_IFDIR;
+    bool full = false;
+    if (off <= 0) {
+        full = !add_entry(".", 1);
     }
-    current_off++;
-    
-    // Add directory entries from FLOUDS
-    size_t num_children = flouds->children_count(node);
-    for (size_t i = 0; i < num_children; i++) {
-        if (off <= current_off) {
-            size_t child_node = flouds->child(node, i);
-            std::string child_name = flouds->get_name(child_node);
-            
-            stbuf.st_ino = delta_stabilization->flouds_inode_to_stable_inode(child_node);
-            if (flouds->is_folder(child_node)) {
-                stbuf.st_mode = S_IFDIR;
-            } else {
-                stbuf.st_mode = S_IFREG;
-            }
-            
-            size_t entsize = fuse_add_direntry(req, p, rem, child_name.c_str(), &stbuf, current_off + 1);
-            if (entsize > rem) {
-                fuse_reply_buf(req, buf, bufsize - rem);
-                return;
-            }
-            p += entsize;
-            rem -= entsize;
+    if (!full && off <= 1) {
+        full = !add_entry("..", 2);
+    }
+
+    // FUSE needs null-terminated names, so they are copied into a buffer that is reused for all entries
+    std::string child_name;
+    for (size_t i = std::max<off_t>(off, 2) - 2; !full && i < cursor->children_count; i++) {
+        size_t child_node = cursor->first_child + i;
+        child_name.assign(flouds->get_name(child_node));
+        if (plus) {
+            fill_entry(child_node, &entry);
+        } else {
+            entry.attr.st_ino = file_system_manager->get_delta_stabilization()->flouds_inode_to_stable_inode(child_node);
+            entry.attr.st_mode = flouds->is_folder(child_node) ? S_IFDIR : S_IFREG;
+        }
+        full = !add_entry(child_name.c_str(), i + 3);
+        if (plus && !full) {
+            metadata_cache.put_entry(ino, child_name, entry.ino);
+            // The kernel counts a lookup for every entry it receives
+            file_system_manager->get_delta_stabilization()->record_lookup(entry.ino);
         }
-        current_off++;
     }
     
-    // End of directory
-    fuse_reply_buf(req, buf, bufsize - rem);
+    fuse_reply_buf(req, buf.data(), size - rem);
+}
+
+/**
+ * This function is called when the contents of a directory are being read.
+ * 
+ * @param req The request handle that contains information about the readdir request and is used to send the response back to the kernel.
+ * @param ino The inode number of the directory whose contents are being read.
+ * @param size The size of the buffer provided for reading the directory entries.
+ * @param off The offset within the directory entries from which to start reading.
+ * @param fi Internal file information.
+ */
+static void flouds_readdir(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off, struct fuse_file_info *fi) {
+    read_directory(req, ino, size, off, fi, false);
+}
+
+/**
+ * This function is called when the contents of a directory are being read together with the attributes of the entries.
+ * The kernel does not have to look up the entries afterwards, e.g. for ls -l or find.
+ * 
+ * @param req The request handle that contains information about the readdirplus request and is used to send the response back to the kernel.
+ * @param ino The inode number of the directory whose contents are being read.
+ * @param size The size of the buffer provided for reading the directory entries.
+ * @param off The offset within the directory entries from which to start reading.
+ * @param fi Internal file information.
+ */
+static void flouds_readdirplus(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off, struct fuse_file_info *fi) {
+    read_directory(req, ino, size, off, fi, true);
+}
+
+/**
+ * This function is called when a directory is being closed.
+ * 
+ * @param req The request handle that contains information about the releasedir request and is used to send the response back to the kernel.
+ * @param ino The inode number of the directory being closed.
+ * @param fi Internal file information, which keeps the cursor of the directory.
+ */
+static void flouds_releasedir(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi) {
+    delete (DirectoryCursor*) fi->fh;
+    fuse_reply_err(req, 0);
 }
 
 /**
@@ -406,6 +657,7 @@ static void flouds_readdir(fuse_req_t req, fuse_ino_t ino, size_t size, off_t of
  * @param mode The permissions for the new directory.
  */
 static void flouds_mkdir(fuse_req_t req, fuse_ino_t parent, const char *name, mode_t mode) {
+    std::unique_lock<std::shared_mutex> lock(filesystem_mutex);
     size_t parent_node;
     if (!try_resolve_inode(req, parent, parent_node)) {
         return;
@@ -414,24 +666,20 @@ static void flouds_mkdir(fuse_req_t req, fuse_ino_t parent, const char *name, mo
     try {
         // Create the new directory
         size_t new_node = file_system_manager->add_node(parent_node, name, true, mode);
-        delta_stabilization->record_insert(new_node);
     
         struct fuse_entry_param entry;
         memset(&entry, 0, sizeof(entry));
         
-        entry.ino = delta_stabilization->flouds_inode_to_stable_inode(new_node);
+        entry.ino = file_system_manager->get_delta_stabilization()->flouds_inode_to_stable_inode(new_node);
         entry.attr.st_ino = entry.ino;
         entry.attr.st_mode = S_IFDIR | mode;
         entry.attr.st_nlink = 2;
-        #ifdef DELTA_STABILIZATION
-        entry.attr_timeout = 1000;
-        entry.entry_timeout = 1000;
-        #else 
-        entry.attr_timeout = 0;
-        entry.entry_timeout = 0;
-        #endif
+        entry.attr_timeout = CACHE_TIMEOUT;
+        entry.entry_timeout = CACHE_TIMEOUT;
+        metadata_cache.put_entry(parent, name, entry.ino);
+        file_system_manager->get_delta_stabilization()->record_lookup(entry.ino);
 
-        file_system_manager->save();
+        file_system_manager->checkpoint();
 
         fuse_reply_entry(req, &entry);
     } catch (...) {
@@ -449,6 +697,7 @@ static void flouds_mkdir(fuse_req_t req, fuse_ino_t parent, const char *name, mo
  * @param fi File information structure that can be used to store state about the open file.
  */
 static void flouds_create(fuse_req_t req, fuse_ino_t parent, const char *name, mode_t mode, struct fuse_file_info *fi) {
+    std::unique_lock<std::shared_mutex> lock(filesystem_mutex);
     size_t parent_node;
     if (!try_resolve_inode(req, parent, parent_node)) {
         return;
@@ -457,25 +706,21 @@ static void flouds_create(fuse_req_t req, fuse_ino_t parent, const char *name, m
     try {
         // Create the new file
         size_t new_node = file_system_manager->add_node(parent_node, name, false, mode);
-        delta_stabilization->record_insert(new_node);   
         
         struct fuse_entry_param entry;
         memset(&entry, 0, sizeof(entry));
 
-        entry.ino = delta_stabilization->flouds_inode_to_stable_inode(new_node);
+        entry.ino = file_system_manager->get_delta_stabilization()->flouds_inode_to_stable_inode(new_node);
         entry.attr.st_ino = entry.ino;
         entry.attr.st_mode = S_IFREG | mode;
         entry.attr.st_nlink = 1;
         entry.attr.st_size = 0;
-        #ifdef DELTA_STABILIZATION
-        entry.attr_timeout = 1000;
-        entry.entry_timeout = 1000;
-        #else 
-        entry.attr_timeout = 0;
-        entry.entry_timeout = 0;
-        #endif
+        entry.attr_timeout = CACHE_TIMEOUT;
+        entry.entry_timeout = CACHE_TIMEOUT;
+        metadata_cache.put_entry(parent, name, entry.ino);
+        file_system_manager->get_delta_stabilization()->record_lookup(entry.ino);
         
-        file_system_manager->save();        
+        file_system_manager->checkpoint();        
 
         fuse_reply_create(req, &entry, fi);
     } catch (...) {
@@ -483,6 +728,51 @@ static void flouds_create(fuse_req_t req, fuse_ino_t parent, const char *name, m
     }
 }
 
+/**
+ * This function is called when space of a file is being allocated or deallocated.
+ * 
+ * @param req The request handle that contains information about the fallocate request and is used to send the response back to the kernel.
+ * @param ino The inode number of the file.
+ * @param mode FALLOC_FL_KEEP_SIZE to keep the size of the file, FALLOC_FL_PUNCH_HOLE (together with FALLOC_FL_KEEP_SIZE) to deallocate the range.
+ * @param offset The offset of the range within the file.
+ * @param length The length of the range in bytes.
+ * @param fi Internal file information.
+ */
+static void flouds_fallocate(fuse_req_t req, fuse_ino_t ino, int mode, off_t offset, off_t length, struct fuse_file_info *fi) {
+    std::unique_lock<std::shared_mutex> lock(filesystem_mutex);
+    Flouds* flouds = file_system_manager->get_flouds();
+
+    size_t node;
+    if (!try_resolve_inode(req, ino, node)) {
+        return;
+    }
+    if (!flouds->is_file(node)) {
+        fuse_reply_err(req, EISDIR);
+        return;
+    }
+    if (offset < 0 || length <= 0) {
+        fuse_reply_err(req, EINVAL);
+        return;
+    }
+
+    try {
+        if (mode == (FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE)) {
+            file_system_manager->punch_hole(node, length, offset);
+        } else if (mode == 0 || mode == FALLOC_FL_KEEP_SIZE) {
+            file_system_manager->allocate_file(node, length, offset, mode == FALLOC_FL_KEEP_SIZE);
+        } else {
+            fuse_reply_err(req, EOPNOTSUPP);
+            return;
+        }
+
+        metadata_cache.invalidate_attributes(ino);
+        file_system_manager->checkpoint();
+        fuse_reply_err(req, 0);
+    } catch (...) {
+        fuse_reply_err(req, EIO);
+    }
+}
+
 /**
  * This function is called when a file is being deleted.
  * 
@@ -491,6 +781,7 @@ static void flouds_create(fuse_req_t req, fuse_ino_t parent, const char *name, m
  * @param name The name of the file to be deleted.
  */
 static void flouds_unlink(fuse_req_t req, fuse_ino_t parent, const char *name) {
+    std::unique_lock<std::shared_mutex> lock(filesystem_mutex);
     size_t parent_node;
     if (!try_resolve_inode(req, parent, parent_node)) {
         return;
@@ -499,30 +790,31 @@ static void flouds_unlink(fuse_req_t req, fuse_ino_t parent, const char *name) {
     Flouds* flouds = file_system_manager->get_flouds();
     
     // Find the child node with the given name
-    size_t num_children = flouds->children_count(parent_node);
-    for (size_t i = 0; i < num_children; i++) {
-        size_t child_node = flouds->child(parent_node, i);
-        if (flouds->get_name(child_node) == name) {
-            // Check if its a file (not a directory)
-            if (flouds->is_folder(child_node)) {
-                fuse_reply_err(req, EISDIR);
-                return;
-            }
-            
-            try {
-                delta_stabilization->record_remove(child_node);
-                file_system_manager->remove_node(child_node);
-                file_system_manager->save();
-                fuse_reply_err(req, 0);
-            } catch (...) {
-                fuse_reply_err(req, EIO);
-            }
-            return;
-        }
+    size_t child_node;
+    try {
+        child_node = flouds->find_child(parent_node, name);
+    } catch (const std::out_of_range&) {
+        // File not found
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+
+    // Check if its a file (not a directory)
+    if (flouds->is_folder(child_node)) {
+        fuse_reply_err(req, EISDIR);
+        return;
     }
     
-    // File not found
-    fuse_reply_err(req, ENOENT);
+    try {
+        uint64_t child = file_system_manager->get_delta_stabilization()->flouds_inode_to_stable_inode(child_node);
+        file_system_manager->remove_node(child_node);
+        metadata_cache.invalidate_entry(parent, name);
+        metadata_cache.invalidate_attributes(child);
+        file_system_manager->checkpoint();
+        fuse_reply_err(req, 0);
+    } catch (...) {
+        fuse_reply_err(req, EIO);
+    }
 }
 
 /**
@@ -533,6 +825,7 @@ static void flouds_unlink(fuse_req_t req, fuse_ino_t parent, const char *name) {
  * @param name The name of the directory to be deleted.
  */
 static void flouds_rmdir(fuse_req_t req, fuse_ino_t parent, const char *name) {
+    std::unique_lock<std::shared_mutex> lock(filesystem_mutex);
     size_t parent_node;
     if (!try_resolve_inode(req, parent, parent_node)) {
         return;
@@ -541,37 +834,38 @@ static void flouds_rmdir(fuse_req_t req, fuse_ino_t parent, const char *name) {
     Flouds* flouds = file_system_manager->get_flouds();
     
     // Find the child node with the given name
-    size_t num_children = flouds->children_count(parent_node);
-    for (size_t i = 0; i < num_children; i++) {
-        size_t child_node = flouds->child(parent_node, i);
-        if (flouds->get_name(child_node) == name) {
-            // Check if its a directory (not a file)
-            if (!flouds->is_folder(child_node)) {
-                fuse_reply_err(req, ENOTDIR);
-                return;
-            }
-            
-            // Check if directory is empty
-            if (!flouds->is_empty_folder(child_node)) {
-                fuse_reply_err(req, ENOTEMPTY);
-                return;
-            }
-            
-            try {
-                // Remove the directory
-                delta_stabilization->record_remove(child_node);
-                file_system_manager->remove_node(child_node);
-                file_system_manager->save();
-                fuse_reply_err(req, 0);
-            } catch (...) {
-                fuse_reply_err(req, EIO);
-            }
-            return;
-        }
+    size_t child_node;
+    try {
+        child_node = flouds->find_child(parent_node, name);
+    } catch (const std::out_of_range&) {
+        // Directory not found
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+
+    // Check if its a directory (not a file)
+    if (!flouds->is_folder(child_node)) {
+        fuse_reply_err(req, ENOTDIR);
+        return;
+    }
+    
+    // Check if directory is empty
+    if (!flouds->is_empty_folder(child_node)) {
+        fuse_reply_err(req, ENOTEMPTY);
+        return;
     }
     
-    // Directory not found
-    fuse_reply_err(req, ENOENT);
+    try {
+        // Remove the directory
+        uint64_t child = file_system_manager->get_delta_stabilization()->flouds_inode_to_stable_inode(child_node);
+        file_system_manager->remove_node(child_node);
+        metadata_cache.invalidate_entry(parent, name);
+        metadata_cache.invalidate_attributes(child);
+        file_system_manager->checkpoint();
+        fuse_reply_err(req, 0);
+    } catch (...) {
+        fuse_reply_err(req, EIO);
+    }
 }
 
 /**
@@ -581,6 +875,7 @@ static void flouds_rmdir(fuse_req_t req, fuse_ino_t parent, const char *name) {
  * @param ino The inode number of the file or directory for which the statistics are being requested (often ignored for statfs).
  */
 static void flouds_stats(fuse_req_t req, fuse_ino_t ino) {
+    std::shared_lock<std::shared_mutex> lock(filesystem_mutex);
     struct statvfs stbuf;
     memset(&stbuf, 0, sizeof(stbuf));
     
@@ -602,6 +897,7 @@ static const struct fuse_lowlevel_ops flouds_operations = {
     .init = flouds_init,
     .destroy = flouds_destroy,
     .lookup = flouds_lookup,
+    .forget = flouds_forget,
     .getattr = flouds_getattr,
     .setattr = flouds_setattr,
     .mkdir = flouds_mkdir,
@@ -610,9 +906,16 @@ static const struct fuse_lowlevel_ops flouds_operations = {
     .open = flouds_open,
     .read = flouds_read,
     .write = flouds_write,
+    .release = flouds_release,
+    .fsync = flouds_fsync,
+    .opendir = flouds_opendir,
     .readdir = flouds_readdir,
+    .releasedir = flouds_releasedir,
     .statfs = flouds_stats,
-    .create = flouds_create
+    .create = flouds_create,
+    .forget_multi = flouds_forget_multi,
+    .fallocate = flouds_fallocate,
+    .readdirplus = flouds_readdirplus
 };
 
 /**
@@ -627,6 +930,26 @@ int main(int argc, char *argv[]) {
     const char *image_path = NULL;
     int ret = -1;
 
+    // Extract the block device backend and readdirplus options, which are unknown to FUSE
+    for (int i = 1; i < args.argc; i++) {
+        if (strcmp(args.argv[i], "--io-uring") == 0 || strcmp(args.argv[i], "--io-uring-direct") == 0 || strcmp(args.argv[i], "--mmap") == 0 || strcmp(args.argv[i], "--readdirplus-always") == 0) {
+            if (strcmp(args.argv[i], "--readdirplus-always") == 0) {
+                readdirplus_adaptive = false;
+            } else if (strcmp(args.argv[i], "--io-uring") == 0) {
+                block_device_backend = BlockDeviceBackend::IO_URING;
+            } else if (strcmp(args.argv[i], "--io-uring-direct") == 0) {
+                block_device_backend = BlockDeviceBackend::IO_URING_DIRECT;
+            } else {
+                block_device_backend = BlockDeviceBackend::MMAP;
+            }
+            for (int j = i; j < args.argc - 1; j++) {
+                args.argv[j] = args.argv[j + 1];
+            }
+            args.argc--;
+            i--;
+        }
+    }
+
     // Extract the image path (first non-option argument) before parsing cmdline
     for (int i = 1; i < args.argc; i++) {
         if (args.argv[i][0] != '-') {
@@ -648,6 +971,10 @@ int main(int argc, char *argv[]) {
     if (opts.show_help) {
         // If the user requested help information, print it and exit.
         printf("usage: %s [options] <image> <mountpoint>\n\n", argv[0]);
+        printf("    --io-uring             perform block I/O through io_uring\n");
+        printf("    --io-uring-direct      like --io-uring, but bypass the page cache with O_DIRECT\n");
+        printf("    --mmap                 memory map the image and serve reads without copying\n");
+        printf("    --readdirplus-always   return the attributes with every directory listing instead of letting the kernel decide\n\n");
         fuse_cmdline_help();
         fuse_lowlevel_help();
         ret = 0;
@@ -30,6 +30,10 @@ public:
         return names[position];
     }
 
+    std::string_view view(size_t position) const override {
+        return names[position];
+    }
+
     size_t size() const override {
         return names.size();
     }
@@ -43,6 +47,14 @@ public:
         names.erase(names.begin() + position);  
     }
 
+    size_t get_memory_usage() const override {
+        size_t memory = sizeof(*this) + names.capacity() * sizeof(std::string);
+        for (const std::string& name : names) {
+            memory += string_memory_usage(name);
+        }
+        return memory;
+    }
+
     size_t get_serialized_size() override {
         size_t total_size = sizeof(size_t);
         for (const std::string& name : names) {
@@ -32,6 +32,10 @@ public:
     }
 
     std::string access(size_t position) const override {
+        return std::string(view(position));
+    }
+
+    std::string_view view(size_t position) const override {
         size_t start = boundaries->select1(position + 1);
         size_t end;
         if (position == size() - 1) {
@@ -39,7 +43,7 @@ public:
         } else {
             end = boundaries->select1(position + 2);
         }
-        return concatenated_names.substr(start, end - start);
+        return std::string_view(concatenated_names).substr(start, end - start);
     }
 
     size_t size() const override {
@@ -77,6 +81,11 @@ public:
         }
     }
 
+    size_t get_memory_usage() const override {
+        // The bit vector is estimated by its serialized size
+        return sizeof(*this) + string_memory_usage(concatenated_names) + boundaries->get_serialized_size();
+    }
+
     size_t get_serialized_size() override {
         return sizeof(size_t) + concatenated_names.size() + boundaries->get_serialized_size();
     }
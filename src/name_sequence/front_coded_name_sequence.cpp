@@ -0,0 +1,245 @@
+/**
+ * This file is part of the Succinct Filesystem project.
+ *
+ * Copyright (c) 2026 Sebastian Brunnert <mail@sebastianbrunnert.de>
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include "name_sequence.hpp"
+
+/**
+ * Front-coded implementation of the NameSequence interface.
+ *
+ * The names are split into buckets of consecutive positions. The first name of a bucket is stored completely, every following name only stores the length of the prefix it shares with its predecessor and the remaining suffix.
+ * As siblings are stored next to each other and often share long prefixes, this saves a lot of memory. Inserting or removing a name only rewrites the affected bucket.
+ * The serialized format is the same as the one of the ArrayNameSequenceStrategy.
+ */
+class FrontCodedNameSequenceStrategy : public NameSequence {
+private:
+    // Number of names per bucket when building buckets. Buckets are split when they grow to twice this size.
+    static constexpr size_t BUCKET_SIZE = 16;
+
+    struct Bucket {
+        size_t count = 0;
+        // Sequence of (shared prefix length, suffix length, suffix) entries with the lengths encoded as varints
+        std::string data;
+    };
+
+    std::vector<Bucket> buckets;
+    // Position of the first name of each bucket
+    std::vector<size_t> starts;
+    size_t num_names = 0;
+    size_t total_length = 0;
+    // Buffer for the name returned by view. Each thread has its own, so concurrent views do not interfere.
+    static inline thread_local std::string decoded;
+
+    static void write_varint(std::string& data, size_t value) {
+        while (value >= 0x80) {
+            data.push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        data.push_back(static_cast<char>(value));
+    }
+
+    static size_t read_varint(const std::string& data, size_t& offset) {
+        size_t value = 0;
+        for (size_t shift = 0; ; shift += 7) {
+            uint8_t byte = static_cast<uint8_t>(data[offset++]);
+            value |= static_cast<size_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) return value;
+        }
+    }
+
+    /**
+     * Decodes the next name of a bucket into the given string, which must hold the previous name of the bucket.
+     */
+    static void decode_next(const Bucket& bucket, size_t& offset, std::string& name) {
+        size_t shared = read_varint(bucket.data, offset);
+        size_t length = read_varint(bucket.data, offset);
+        name.resize(shared);
+        name.append(bucket.data, offset, length);
+        offset += length;
+    }
+
+    static std::vector<std::string> decode(const Bucket& bucket) {
+        std::vector<std::string> names(bucket.count);
+        std::string name;
+        size_t offset = 0;
+        for (size_t i = 0; i < bucket.count; i++) {
+            decode_next(bucket, offset, name);
+            names[i] = name;
+        }
+        return names;
+    }
+
+    static Bucket encode(std::vector<std::string>::const_iterator begin, std::vector<std::string>::const_iterator end) {
+        Bucket bucket;
+        const std::string* previous = nullptr;
+        for (auto it = begin; it != end; it++) {
+            size_t shared = 0;
+            if (previous != nullptr) {
+                size_t limit = std::min(previous->size(), it->size());
+                while (shared < limit && (*previous)[shared] == (*it)[shared]) shared++;
+            }
+            write_varint(bucket.data, shared);
+            write_varint(bucket.data, it->size() - shared);
+            bucket.data.append(*it, shared);
+            bucket.count++;
+            previous = &*it;
+        }
+        bucket.data.shrink_to_fit();
+        return bucket;
+    }
+
+    /**
+     * Gets the index of the bucket that contains the given position. A position after the last name belongs to the last bucket.
+     */
+    size_t find_bucket(size_t position) const {
+        return std::upper_bound(starts.begin(), starts.end(), position) - starts.begin() - 1;
+    }
+
+    /**
+     * Replaces a bucket with the given names, splitting it if it became too large and dropping it if it became empty.
+     */
+    void rewrite(size_t index, const std::vector<std::string>& names) {
+        if (names.empty()) {
+            buckets.erase(buckets.begin() + index);
+            starts.erase(starts.begin() + index);
+        } else if (names.size() >= 2 * BUCKET_SIZE) {
+            size_t half = names.size() / 2;
+            buckets[index] = encode(names.begin(), names.begin() + half);
+            buckets.insert(buckets.begin() + index + 1, encode(names.begin() + half, names.end()));
+            starts.insert(starts.begin() + index + 1, starts[index] + half);
+        } else {
+            buckets[index] = encode(names.begin(), names.end());
+        }
+    }
+
+public:
+    FrontCodedNameSequenceStrategy() {}
+
+    void set(size_t position, const std::string& name) override {
+        size_t index = find_bucket(position);
+        std::vector<std::string> names = decode(buckets[index]);
+        std::string& old_name = names[position - starts[index]];
+        total_length = total_length - old_name.size() + name.size();
+        old_name = name;
+        rewrite(index, names);
+    }
+
+    std::string access(size_t position) const override {
+        return std::string(view(position));
+    }
+
+    std::string_view view(size_t position) const override {
+        size_t index = find_bucket(position);
+        size_t offset = 0;
+        for (size_t i = starts[index]; i <= position; i++) {
+            decode_next(buckets[index], offset, decoded);
+        }
+        return decoded;
+    }
+
+    size_t size() const override {
+        return num_names;
+    }
+
+    void insert(size_t position, const std::string& name) override {
+        if (buckets.empty()) {
+            buckets.push_back(Bucket());
+            starts.push_back(0);
+        }
+
+        size_t index = find_bucket(position);
+        std::vector<std::string> names = decode(buckets[index]);
+        names.insert(names.begin() + (position - starts[index]), name);
+        for (size_t i = index + 1; i < starts.size(); i++) {
+            starts[i]++;
+        }
+        rewrite(index, names);
+        num_names++;
+        total_length += name.size();
+    }
+
+    void remove(size_t position) override {
+        size_t index = find_bucket(position);
+        std::vector<std::string> names = decode(buckets[index]);
+        total_length -= names[position - starts[index]].size();
+        names.erase(names.begin() + (position - starts[index]));
+        for (size_t i = index + 1; i < starts.size(); i++) {
+            starts[i]--;
+        }
+
+        // Merge small buckets with their successor to keep the buckets reasonably full
+        if (!names.empty() && names.size() < BUCKET_SIZE / 2 && index + 1 < buckets.size()) {
+            std::vector<std::string> next = decode(buckets[index + 1]);
+            names.insert(names.end(), next.begin(), next.end());
+            buckets.erase(buckets.begin() + index + 1);
+            starts.erase(starts.begin() + index + 1);
+        }
+        rewrite(index, names);
+        num_names--;
+    }
+
+    size_t get_memory_usage() const override {
+        size_t memory = sizeof(*this) + buckets.capacity() * sizeof(Bucket) + starts.capacity() * sizeof(size_t);
+        for (const Bucket& bucket : buckets) {
+            memory += string_memory_usage(bucket.data);
+        }
+        return memory;
+    }
+
+    size_t get_serialized_size() override {
+        return sizeof(size_t) + num_names * sizeof(size_t) + total_length;
+    }
+
+    void serialize(char* buffer, size_t* offset) override {
+        memcpy(buffer + *offset, &num_names, sizeof(size_t));
+        *offset += sizeof(size_t);
+        std::string name;
+        for (const Bucket& bucket : buckets) {
+            size_t bucket_offset = 0;
+            for (size_t i = 0; i < bucket.count; i++) {
+                decode_next(bucket, bucket_offset, name);
+                size_t name_length = name.size();
+                memcpy(buffer + *offset, &name_length, sizeof(size_t));
+                *offset += sizeof(size_t);
+                memcpy(buffer + *offset, name.data(), name_length);
+                *offset += name_length;
+            }
+        }
+    }
+
+    void deserialize(const char* buffer, size_t* offset) override {
+        memcpy(&num_names, buffer + *offset, sizeof(size_t));
+        *offset += sizeof(size_t);
+        buckets.clear();
+        starts.clear();
+        total_length = 0;
+
+        std::vector<std::string> names;
+        for (size_t i = 0; i < num_names; i++) {
+            size_t name_length;
+            memcpy(&name_length, buffer + *offset, sizeof(size_t));
+            *offset += sizeof(size_t);
+            names.emplace_back(buffer + *offset, name_length);
+            *offset += name_length;
+            total_length += name_length;
+
+            if (names.size() == BUCKET_SIZE || i + 1 == num_names) {
+                starts.push_back(i + 1 - names.size());
+                buckets.push_back(encode(names.begin(), names.end()));
+                names.clear();
+            }
+        }
+    }
+};
+
+template <>
+NameSequence* create_name_sequence<FrontCodedNameSequenceStrategy>() {
+    return new FrontCodedNameSequenceStrategy();
+}
@@ -29,6 +29,11 @@ public:
         return it->second;
     }
 
+    std::string_view view(size_t position) const override {
+        auto it = names.find(position);
+        return it->second;
+    }
+
     size_t size() const override {
         return names.size();
     }
@@ -57,6 +62,15 @@ public:
         names.erase(names.size() - 1);
     }
 
+    size_t get_memory_usage() const override {
+        // Each node of the map holds the entry and a pointer to the next node
+        size_t memory = sizeof(*this) + names.bucket_count() * sizeof(void*) + names.size() * (sizeof(std::pair<const size_t, std::string>) + sizeof(void*));
+        for (const auto& pair : names) {
+            memory += string_memory_usage(pair.second);
+        }
+        return memory;
+    }
+
     size_t get_serialized_size() override {
         size_t total_size = sizeof(size_t);
         for (const auto& pair : names) {
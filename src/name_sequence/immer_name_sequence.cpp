@@ -29,6 +29,11 @@ public:
         return names[position];
     }
 
+    std::string_view view(size_t position) const override {
+        // The elements of the flex_vector stay in place as long as the vector itself is not replaced
+        return names[position];
+    }
+
     size_t size() const override {
         return names.size();
     }
@@ -41,6 +46,15 @@ public:
         names = names.erase(position);
     }
 
+    size_t get_memory_usage() const override {
+        // The inner nodes of the flex_vector are not taken into account
+        size_t memory = sizeof(*this) + names.size() * sizeof(std::string);
+        for (const std::string& name : names) {
+            memory += string_memory_usage(name);
+        }
+        return memory;
+    }
+
     size_t get_serialized_size() override {
         size_t total_size = sizeof(size_t);
         for (const std::string& name : names) {
@@ -9,6 +9,7 @@
 
 #include <cstddef>
 #include <string>
+#include <string_view>
 #include <iostream>
 #include "../serialization/serializable.hpp"
 
@@ -40,6 +41,15 @@ public:
      */
     virtual std::string access(size_t position) const = 0;
 
+    /**
+     * Gets a view of the name at the specified position without copying it.
+     * The view is only valid until the name sequence is modified or the next view is requested by the same thread. Views may be requested concurrently as long as the name sequence is not modified.
+     * 
+     * @param position The 0-based position of the name to get. Must be less than the size of the name sequence.
+     * @return A view of the name at the specified position.
+     */
+    virtual std::string_view view(size_t position) const = 0;
+
     /**
      * Gets the current size of the name sequence.
      * 
@@ -62,13 +72,19 @@ public:
      */    
     virtual void remove(size_t position) = 0;
 
+    /**
+     * Gets the approximate number of bytes the name sequence occupies in memory.
+     * 
+     * @return The number of bytes used by the name sequence.
+     */
+    virtual size_t get_memory_usage() const = 0;
+
     /**
      * Helper function to see the names for debugging.
      */
     friend std::ostream& operator<<(std::ostream& os, const NameSequence& ns) {
         for (size_t i = 0; i < ns.size(); i++) {
-            std::string name = ns.access(i);
-            os << name << " ";
+            os << ns.view(i) << " ";
         }
         return os;
     }
@@ -76,6 +92,14 @@ public:
     virtual void serialize(char* buffer, size_t* offset) override = 0;
     virtual void deserialize(const char* buffer, size_t* offset) override = 0;
     virtual size_t get_serialized_size() override = 0;
+
+protected:
+    /**
+     * Gets the number of bytes a string allocates on the heap. Short strings are stored inside the string object itself.
+     */
+    static size_t string_memory_usage(const std::string& string) {
+        return string.capacity() > std::string().capacity() ? string.capacity() + 1 : 0;
+    }
 };
 
 /**
@@ -97,4 +121,7 @@ class HashNameSequenceStrategy;
 template <> NameSequence* create_name_sequence<HashNameSequenceStrategy>();
 
 class ImmerNameSequenceStrategy;
-template <> NameSequence* create_name_sequence<ImmerNameSequenceStrategy>();
\ No newline at end of file
+template <> NameSequence* create_name_sequence<ImmerNameSequenceStrategy>();
+
+class FrontCodedNameSequenceStrategy;
+template <> NameSequence* create_name_sequence<FrontCodedNameSequenceStrategy>();
\ No newline at end of file
@@ -13,6 +13,11 @@
  * This class defines the interface for serializable objects to store and load them on block devices.
  */
 class Serializable {
+public:
+    /**
+     * Virtual destructor.
+     */
+    virtual ~Serializable() = default;
 
     /**
      * Serializes the object into a byte array.
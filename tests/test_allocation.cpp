@@ -7,7 +7,9 @@
 
 #include <gtest/gtest.h>
 #include "../src/fsm/allocation/allocation_manager.hpp"
+#include "../src/block_device/mapped_block_device.hpp"
 #include <memory>
+#include <vector>
 
 // Parameterized test class for different strategies
 class AllocationManagerTest : public ::testing::Test, public ::testing::WithParamInterface<std::function<AllocationManager*(BlockDevice*)>> {
@@ -48,6 +50,65 @@ TEST_P(AllocationManagerTest, ReadAndWrite) {
     std::remove("test_block_device.img");
 }
 
+TEST_P(AllocationManagerTest, ReadAndWriteUnaligned) {
+    BlockDevice* block_device = new BlockDevice("test_block_device.img", 4096);
+    AllocationManager* allocation_manager = create_allocation_manager(block_device);
+    size_t handle = allocation_manager->allocate(3 * 4096);
+    size_t other = allocation_manager->allocate(4096);
+    // Growing behind another allocation may split the space into several runs
+    handle = allocation_manager->resize(handle, 3 * 4096, 8 * 4096);
+
+    std::vector<char> data(6 * 4096 + 1000);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = static_cast<char>(i * 7 + 3);
+    }
+    allocation_manager->write(handle, data.data(), data.size(), 700);
+    allocation_manager->write(other, "other", 6, 0);
+
+    std::vector<char> buffer(data.size());
+    allocation_manager->read(handle, buffer.data(), buffer.size(), 700);
+    EXPECT_EQ(buffer, data);
+
+    // Read a part that starts and ends inside a block
+    allocation_manager->read(handle, buffer.data(), 3 * 4096, 4096 + 300);
+    EXPECT_EQ(memcmp(buffer.data(), data.data() + 4096 + 300 - 700, 3 * 4096), 0);
+
+    char other_buffer[6];
+    allocation_manager->read(other, other_buffer, 6, 0);
+    EXPECT_STREQ(other_buffer, "other");
+
+    delete allocation_manager;
+    delete block_device;
+    std::remove("test_block_device.img");
+}
+
+TEST_P(AllocationManagerTest, View) {
+    BlockDevice* block_device = new BlockDevice("test_block_device.img", 4096);
+    AllocationManager* allocation_manager = create_allocation_manager(block_device);
+    size_t handle = allocation_manager->allocate(2 * 4096);
+    allocation_manager->write(handle, "Hello, World!", 14, 100);
+
+    // Blocks of a file based block device cannot be accessed directly
+    EXPECT_EQ(allocation_manager->view(handle, 14, 100), nullptr);
+
+    delete allocation_manager;
+    delete block_device;
+
+    block_device = new MappedBlockDevice("test_block_device.img", 4096);
+    allocation_manager = create_allocation_manager(block_device);
+    handle = allocation_manager->allocate(2 * 4096);
+    allocation_manager->write(handle, "Hello, World!", 14, 4000);
+
+    // The data crosses a block boundary but is still contiguous
+    const char* data = allocation_manager->view(handle, 14, 4000);
+    ASSERT_NE(data, nullptr);
+    EXPECT_STREQ(data, "Hello, World!");
+
+    delete allocation_manager;
+    delete block_device;
+    std::remove("test_block_device.img");
+}
+
 TEST_P(AllocationManagerTest, Resize) {
     BlockDevice* block_device = new BlockDevice("test_block_device.img", 4096);
     AllocationManager* allocation_manager = create_allocation_manager(block_device);
@@ -73,6 +134,193 @@ TEST_P(AllocationManagerTest, Resize) {
     std::remove("test_block_device.img");
 }
 
+TEST_P(AllocationManagerTest, ResizeAtEnd) {
+    BlockDevice* block_device = new BlockDevice("test_block_device.img", 4096);
+    AllocationManager* allocation_manager = create_allocation_manager(block_device);
+    size_t handle = allocation_manager->allocate(4096);
+    // The last allocation grows behind the end of the used space, a new allocation must not overlap it
+    handle = allocation_manager->resize(handle, 4096, 4 * 4096);
+    size_t other = allocation_manager->allocate(4096);
+
+    std::string data(4 * 4096, 'a');
+    allocation_manager->write(handle, data.data(), data.size(), 0);
+    allocation_manager->write(other, "b", 1, 0);
+    std::string buffer(data.size(), '\0');
+    allocation_manager->read(handle, buffer.data(), buffer.size(), 0);
+    EXPECT_EQ(buffer, data);
+    EXPECT_EQ(allocation_manager->get_used_blocks(), 6);
+
+    std::remove("test_block_device.img");
+}
+
+TEST_P(AllocationManagerTest, GrowAndTrim) {
+    BlockDevice* block_device = new BlockDevice("test_block_device.img", 4096);
+    AllocationManager* allocation_manager = create_allocation_manager(block_device);
+    size_t used_blocks = allocation_manager->get_used_blocks();
+
+    // Another allocation follows the growing one after every step
+    size_t handle = allocation_manager->allocate(4096);
+    std::vector<size_t> others;
+    std::string data;
+    for (size_t i = 0; i < 8; i++) {
+        if (i > 0) {
+            others.push_back(allocation_manager->allocate(4096));
+            handle = allocation_manager->grow(handle, data.size(), data.size() + 4096);
+        }
+        std::string chunk(4096, 'a' + i);
+        allocation_manager->write(handle, chunk.data(), chunk.size(), data.size());
+        data += chunk;
+    }
+    // Without reserved space, every step would move the data
+    EXPECT_LE(allocation_manager->get_relocations(), 3);
+
+    std::string buffer(data.size(), '\0');
+    allocation_manager->read(handle, buffer.data(), buffer.size(), 0);
+    EXPECT_EQ(buffer, data);
+
+    // Releasing the reserved space and all allocations frees every block
+    allocation_manager->trim_all();
+    allocation_manager->free(handle, data.size());
+    for (size_t other : others) {
+        allocation_manager->free(other, 4096);
+    }
+    EXPECT_EQ(allocation_manager->get_used_blocks(), used_blocks);
+
+    std::remove("test_block_device.img");
+}
+
+TEST_P(AllocationManagerTest, FragmentedRandomAccess) {
+    BlockDevice* block_device = new BlockDevice("test_block_device.img", 4096);
+    AllocationManager* allocation_manager = create_allocation_manager(block_device);
+
+    // Growing in small steps between other allocations splits the space into many pieces
+    size_t handle = allocation_manager->allocate(4096);
+    size_t size = 4096;
+    for (size_t i = 0; i < 32; i++) {
+        allocation_manager->allocate(4096);
+        handle = allocation_manager->resize(handle, size, size + 4096);
+        size += 4096;
+    }
+    std::string data(size, '\0');
+    for (size_t i = 0; i < size; i++) {
+        data[i] = 'a' + (i * 7 + i / 4096) % 26;
+    }
+    allocation_manager->write(handle, data.data(), data.size(), 0);
+
+    // Ranges across the boundaries of the pieces
+    for (size_t offset = 100; offset + 9000 < size; offset += 12345) {
+        std::string buffer(9000, '\0');
+        allocation_manager->read(handle, buffer.data(), buffer.size(), offset);
+        EXPECT_EQ(buffer, data.substr(offset, buffer.size()));
+    }
+
+    // Shrinking keeps the data in front of the new end
+    size_t new_size = size / 2 + 100;
+    handle = allocation_manager->resize(handle, size, new_size);
+    std::string buffer(new_size, '\0');
+    allocation_manager->read(handle, buffer.data(), buffer.size(), 0);
+    EXPECT_EQ(buffer, data.substr(0, new_size));
+
+    std::remove("test_block_device.img");
+}
+
+TEST_P(AllocationManagerTest, Holes) {
+    BlockDevice* block_device = new BlockDevice("test_block_device.img", 4096);
+    AllocationManager* allocation_manager = create_allocation_manager(block_device);
+    if (!allocation_manager->supports_holes()) {
+        GTEST_SKIP() << "The strategy does not support holes";
+    }
+    size_t used_blocks = allocation_manager->get_used_blocks();
+
+    // Only the block of the handle is allocated
+    size_t handle = allocation_manager->allocate_sparse(16 * 4096);
+    EXPECT_EQ(allocation_manager->get_used_blocks(), used_blocks + 1);
+    EXPECT_TRUE(allocation_manager->has_holes(handle, 4096, 0));
+    std::string buffer(16 * 4096, 'x');
+    allocation_manager->read(handle, buffer.data(), buffer.size(), 0);
+    EXPECT_EQ(buffer, std::string(16 * 4096, '\0'));
+
+    // The range spans two blocks
+    EXPECT_TRUE(allocation_manager->fill(handle, 4096, 5 * 4096 + 10, true));
+    EXPECT_FALSE(allocation_manager->fill(handle, 4096, 5 * 4096 + 10, true));
+    EXPECT_FALSE(allocation_manager->has_holes(handle, 4096, 5 * 4096 + 10));
+    EXPECT_EQ(allocation_manager->get_used_blocks(), used_blocks + 3);
+    std::string data(4096, 'a');
+    allocation_manager->write(handle, data.data(), data.size(), 5 * 4096 + 10);
+    allocation_manager->read(handle, buffer.data(), buffer.size(), 0);
+    EXPECT_EQ(buffer, std::string(5 * 4096 + 10, '\0') + data + std::string(10 * 4096 - 10, '\0'));
+
+    // Extending adds a hole, resizing allocates
+    handle = allocation_manager->extend(handle, 16 * 4096, 32 * 4096);
+    EXPECT_EQ(allocation_manager->get_used_blocks(), used_blocks + 3);
+    handle = allocation_manager->resize(handle, 32 * 4096, 40 * 4096);
+    EXPECT_EQ(allocation_manager->get_used_blocks(), used_blocks + 11);
+    EXPECT_FALSE(allocation_manager->has_holes(handle, 8 * 4096, 32 * 4096));
+
+    // Only the sixth block lies completely within the range
+    allocation_manager->punch_hole(handle, 4096 + 20, 5 * 4096 - 10);
+    EXPECT_EQ(allocation_manager->get_used_blocks(), used_blocks + 10);
+    EXPECT_TRUE(allocation_manager->has_holes(handle, 1, 5 * 4096));
+    allocation_manager->read(handle, buffer.data(), 4096, 5 * 4096);
+    EXPECT_EQ(buffer.substr(0, 4096), std::string(4096, '\0'));
+    allocation_manager->read(handle, buffer.data(), 10, 6 * 4096);
+    EXPECT_EQ(buffer.substr(0, 10), std::string(10, 'a'));
+
+    allocation_manager->free(handle, 40 * 4096);
+    EXPECT_EQ(allocation_manager->get_used_blocks(), used_blocks);
+
+    std::remove("test_block_device.img");
+}
+
+TEST_P(AllocationManagerTest, FillReusedBlocks) {
+    BlockDevice* block_device = new BlockDevice("test_block_device.img", 4096);
+    AllocationManager* allocation_manager = create_allocation_manager(block_device);
+    if (!allocation_manager->supports_holes()) {
+        GTEST_SKIP() << "The strategy does not support holes";
+    }
+    size_t handle = allocation_manager->allocate(4 * 4096);
+    std::string data(4 * 4096, 'z');
+    allocation_manager->write(handle, data.data(), data.size(), 0);
+    allocation_manager->free(handle, data.size());
+
+    // The filled blocks are the freed ones, but they still read as zeros
+    handle = allocation_manager->allocate_sparse(4 * 4096);
+    EXPECT_TRUE(allocation_manager->fill(handle, 10, 4096 + 100, true));
+    std::string buffer(4 * 4096, 'x');
+    allocation_manager->read(handle, buffer.data(), buffer.size(), 0);
+    EXPECT_EQ(buffer, std::string(4 * 4096, '\0'));
+
+    allocation_manager->free(handle, 4 * 4096);
+    std::remove("test_block_device.img");
+}
+
+TEST_P(AllocationManagerTest, ReuseFreedSpace) {
+    BlockDevice* block_device = new BlockDevice("test_block_device.img", 4096);
+    AllocationManager* allocation_manager = create_allocation_manager(block_device);
+    std::vector<size_t> handles;
+    for (size_t i = 0; i < 6; i++) {
+        handles.push_back(allocation_manager->allocate(2 * 4096));
+    }
+    // Free runs of two and four blocks, the neighbouring runs are merged
+    allocation_manager->free(handles[1], 2 * 4096);
+    allocation_manager->free(handles[3], 2 * 4096);
+    allocation_manager->free(handles[4], 2 * 4096);
+
+    size_t large = allocation_manager->allocate(4 * 4096);
+    size_t small = allocation_manager->allocate(2 * 4096);
+
+    std::string data(4 * 4096, 'a');
+    allocation_manager->write(large, data.data(), data.size(), 0);
+    allocation_manager->write(small, "b", 1, 0);
+    std::string buffer(data.size(), '\0');
+    allocation_manager->read(large, buffer.data(), buffer.size(), 0);
+    EXPECT_EQ(buffer, data);
+    allocation_manager->read(small, buffer.data(), 1, 0);
+    EXPECT_EQ(buffer[0], 'b');
+
+    std::remove("test_block_device.img");
+}
+
 TEST_P(AllocationManagerTest, SerializeDeserialize) {
     BlockDevice* block_device = new BlockDevice("test_block_device.img", 4096);
     AllocationManager* allocation_manager = create_allocation_manager(block_device);
@@ -105,6 +353,161 @@ INSTANTIATE_TEST_SUITE_P(
     AllocationManagerTest,
     ::testing::Values(
         std::function<AllocationManager*(BlockDevice*)>([](BlockDevice* block_device) { return create_allocation_manager<BestFitAllocationStrategy>(block_device); }),
-        std::function<AllocationManager*(BlockDevice*)>([](BlockDevice* block_device) { return create_allocation_manager<ExtentAllocationStrategy>(block_device); })
+        std::function<AllocationManager*(BlockDevice*)>([](BlockDevice* block_device) { return create_allocation_manager<ExtentAllocationStrategy>(block_device); }),
+        std::function<AllocationManager*(BlockDevice*)>([](BlockDevice* block_device) { return create_allocation_manager<PackedAllocationStrategy<BestFitAllocationStrategy>>(block_device); }),
+        std::function<AllocationManager*(BlockDevice*)>([](BlockDevice* block_device) { return create_allocation_manager<PackedAllocationStrategy<ExtentAllocationStrategy>>(block_device); })
     )
 );
+
+TEST(PackedAllocationTest, PackSmallAllocations) {
+    BlockDevice* block_device = new BlockDevice("test_block_device.img", 4096);
+    AllocationManager* allocation_manager = create_allocation_manager<PackedAllocationStrategy<BestFitAllocationStrategy>>(block_device);
+    size_t used_blocks = allocation_manager->get_used_blocks();
+
+    // Allocations of two units share a block with three others
+    std::vector<size_t> handles;
+    for (size_t i = 0; i < 16; i++) {
+        handles.push_back(allocation_manager->allocate(1000));
+        std::string data(1000, 'a' + i);
+        allocation_manager->write(handles[i], data.data(), data.size(), 0);
+    }
+    EXPECT_EQ(allocation_manager->get_used_blocks(), used_blocks + 4);
+    for (size_t i = 0; i < 16; i++) {
+        std::string buffer(1000, '\0');
+        allocation_manager->read(handles[i], buffer.data(), buffer.size(), 0);
+        EXPECT_EQ(buffer, std::string(1000, 'a' + i));
+    }
+
+    // Freed units are reused and empty blocks are returned
+    for (size_t i = 0; i < 4; i++) {
+        allocation_manager->free(handles[i], 1000);
+    }
+    EXPECT_EQ(allocation_manager->get_used_blocks(), used_blocks + 3);
+    handles[0] = allocation_manager->allocate(200);
+    EXPECT_EQ(allocation_manager->get_used_blocks(), used_blocks + 4);
+
+    // Growing beyond the free units moves the data to another block, growing beyond a block moves it to the block allocation strategy
+    size_t handle = allocation_manager->resize(handles[4], 1000, 3000);
+    std::string buffer(1000, '\0');
+    allocation_manager->read(handle, buffer.data(), buffer.size(), 0);
+    EXPECT_EQ(buffer, std::string(1000, 'e'));
+    handle = allocation_manager->resize(handle, 3000, 3 * 4096);
+    allocation_manager->read(handle, buffer.data(), buffer.size(), 0);
+    EXPECT_EQ(buffer, std::string(1000, 'e'));
+    EXPECT_EQ(allocation_manager->get_relocations(), 2);
+
+    // The shared blocks survive serialization
+    std::vector<char> serialized(allocation_manager->get_serialized_size());
+    size_t offset = 0;
+    allocation_manager->serialize(serialized.data(), &offset);
+    EXPECT_EQ(offset, serialized.size());
+    AllocationManager* deserialized_manager = create_allocation_manager<PackedAllocationStrategy<BestFitAllocationStrategy>>(block_device);
+    offset = 0;
+    deserialized_manager->deserialize(serialized.data(), &offset);
+    EXPECT_EQ(deserialized_manager->get_used_blocks(), allocation_manager->get_used_blocks());
+    deserialized_manager->read(handles[15], buffer.data(), buffer.size(), 0);
+    EXPECT_EQ(buffer, std::string(1000, 'p'));
+    size_t small = deserialized_manager->allocate(1000);
+    EXPECT_EQ(deserialized_manager->get_used_blocks(), allocation_manager->get_used_blocks());
+    deserialized_manager->free(small, 1000);
+
+    delete deserialized_manager;
+    delete allocation_manager;
+    delete block_device;
+    std::remove("test_block_device.img");
+}
+
+TEST(ExtentAllocationTest, AllocateExactlyInFragmentedSpace) {
+    BlockDevice* block_device = new BlockDevice("test_block_device.img", 4096);
+    AllocationManager* allocation_manager = create_allocation_manager<ExtentAllocationStrategy>(block_device);
+    std::vector<size_t> handles;
+    for (size_t i = 0; i < 10; i++) {
+        handles.push_back(allocation_manager->allocate(4096));
+        EXPECT_EQ(handles[i], i + 1);
+    }
+    allocation_manager->write(handles[2], "c", 1, 0);
+
+    // The free runs are the blocks 2, 4-5 and 7-9
+    for (size_t i : {1, 3, 4, 6, 7, 8}) {
+        allocation_manager->free(handles[i], 4096);
+    }
+    EXPECT_EQ(allocation_manager->get_used_blocks(), 5);
+
+    // Block 2 is too short, so the blocks 4-5 and the front of 7-9 are used
+    size_t handle = allocation_manager->allocate(3 * 4096);
+    EXPECT_EQ(handle, 4);
+    EXPECT_EQ(allocation_manager->get_used_blocks(), 8);
+    std::string data = std::string(4096, 'x') + std::string(4096, 'y') + std::string(4096, 'z');
+    allocation_manager->write(handle, data.data(), data.size(), 0);
+    std::string block(4096, '\0');
+    for (auto [block_index, value] : {std::pair<size_t, char>{4, 'x'}, {5, 'y'}, {7, 'z'}, {3, 'c'}}) {
+        block_device->read_block(block_index, block.data());
+        EXPECT_EQ(block[0], value);
+    }
+
+    EXPECT_EQ(allocation_manager->allocate(877), 2);
+    EXPECT_EQ(allocation_manager->allocate(2 * 4096), 8);
+    EXPECT_EQ(allocation_manager->get_used_blocks(), 11);
+    EXPECT_EQ(allocation_manager->get_total_blocks(), 11);
+
+    // A free run at the end is split as well and only extended by the missing blocks
+    handle = allocation_manager->allocate(3 * 4096);
+    EXPECT_EQ(handle, 11);
+    allocation_manager->free(handle, 3 * 4096);
+    EXPECT_EQ(allocation_manager->allocate(877), 11);
+    EXPECT_EQ(allocation_manager->get_used_blocks(), 12);
+    EXPECT_EQ(allocation_manager->get_total_blocks(), 14);
+    handle = allocation_manager->allocate(5 * 4096);
+    EXPECT_EQ(handle, 12);
+    EXPECT_EQ(allocation_manager->get_used_blocks(), 17);
+    EXPECT_EQ(allocation_manager->get_total_blocks(), 17);
+    data = std::string(4 * 4096, 'a') + std::string(4096, 'b');
+    allocation_manager->write(handle, data.data(), data.size(), 0);
+    block_device->read_block(16, block.data());
+    EXPECT_EQ(block, std::string(4096, 'b'));
+
+    delete allocation_manager;
+    delete block_device;
+    std::remove("test_block_device.img");
+}
+
+TEST(PackedAllocationTest, PromoteAndExtend) {
+    BlockDevice* block_device = new BlockDevice("test_block_device.img", 4096);
+    AllocationManager* allocation_manager = create_allocation_manager<PackedAllocationStrategy<ExtentAllocationStrategy>>(block_device);
+
+    // Extending a small allocation beyond a block moves it to the extent strategy, only its data is allocated there
+    size_t handle = allocation_manager->allocate(2768);
+    std::string data(2768, 'a');
+    allocation_manager->write(handle, data.data(), data.size(), 0);
+    handle = allocation_manager->extend(handle, 2768, 5376);
+    EXPECT_TRUE(allocation_manager->has_holes(handle, 1, 5000));
+    EXPECT_FALSE(allocation_manager->has_holes(handle, 2768, 0));
+    handle = allocation_manager->grow(handle, 5376, 39610);
+    allocation_manager->fill(handle, 34234, 5376, true);
+    std::string written(34234, 'b');
+    allocation_manager->write(handle, written.data(), written.size(), 5376);
+
+    std::string buffer(39610, 'x');
+    allocation_manager->read(handle, buffer.data(), buffer.size(), 0);
+    EXPECT_EQ(buffer.substr(0, 4096), data + std::string(4096 - 2768, '\0'));
+    EXPECT_EQ(buffer.substr(4096, 1280), std::string(1280, '\0'));
+    EXPECT_EQ(buffer.substr(5376), written);
+
+    // The extents survive serialization
+    std::vector<char> serialized(allocation_manager->get_serialized_size());
+    size_t offset = 0;
+    allocation_manager->serialize(serialized.data(), &offset);
+    AllocationManager* deserialized_manager = create_allocation_manager<PackedAllocationStrategy<ExtentAllocationStrategy>>(block_device);
+    offset = 0;
+    deserialized_manager->deserialize(serialized.data(), &offset);
+    EXPECT_EQ(offset, serialized.size());
+    EXPECT_EQ(deserialized_manager->get_used_blocks(), allocation_manager->get_used_blocks());
+    buffer.assign(4096, 'x');
+    deserialized_manager->read(handle, buffer.data(), buffer.size(), 0);
+    EXPECT_EQ(buffer, data + std::string(4096 - 2768, '\0'));
+
+    delete deserialized_manager;
+    delete allocation_manager;
+    delete block_device;
+    std::remove("test_block_device.img");
+}
@@ -7,7 +7,10 @@
 
 #include <gtest/gtest.h>
 #include "../src/bitvector/bitvector.hpp"
+#include <algorithm>
 #include <memory>
+#include <random>
+#include <vector>
 
 // Parameterized test class for different strategies
 class BitVectorTest : public ::testing::Test, public ::testing::WithParamInterface<std::function<BitVector*(size_t)>> {
@@ -46,6 +49,19 @@ TEST_P(BitVectorTest, SetAndAccess) {
     }
 }
 
+TEST_P(BitVectorTest, SetRange) {
+    BitVector* bv = create_bitvector(1200);
+    // Spans partial words at both ends and several superblocks
+    bv->set_range(60, 1000, true);
+    bv->set_range(100, 64, false);
+    for (size_t i = 0; i < 1200; i++) {
+        EXPECT_EQ(bv->access(i), i >= 60 && i < 1060 && (i < 100 || i >= 164)) << i;
+    }
+    EXPECT_EQ(bv->rank1(1199), 936);
+    EXPECT_EQ(bv->select1(41), 164);
+    EXPECT_EQ(bv->select0(61), 100);
+}
+
 TEST_P(BitVectorTest, Rank) {
     BitVector* bv = create_bitvector(10);
     bv->set(3, true);
@@ -181,6 +197,49 @@ TEST_P(BitVectorTest, SerializeDeserialize) {
     delete[] buffer;
 }
 
+TEST_P(BitVectorTest, RandomOperations) {
+    // Compare against a plain vector over several superblocks
+    std::mt19937 random(42);
+    std::vector<bool> expected(3000);
+    BitVector* bv = create_bitvector(expected.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        expected[i] = random() % 3 == 0;
+        bv->set(i, expected[i]);
+    }
+
+    for (size_t i = 0; i < 2000; i++) {
+        size_t operation = random() % 3;
+        if (operation == 0) {
+            size_t position = random() % (expected.size() + 1);
+            bool value = random() % 2;
+            expected.insert(expected.begin() + position, value);
+            bv->insert(position, value);
+        } else if (operation == 1) {
+            size_t position = random() % expected.size();
+            expected.erase(expected.begin() + position);
+            bv->remove(position);
+        } else {
+            size_t position = random() % expected.size();
+            expected[position] = !expected[position];
+            bv->set(position, expected[position]);
+        }
+    }
+
+    ASSERT_EQ(bv->size(), expected.size());
+    size_t ones = 0;
+    for (size_t i = 0; i < expected.size(); i++) {
+        ASSERT_EQ(bv->access(i), expected[i]);
+        if (expected[i]) {
+            ones++;
+            ASSERT_EQ(bv->select1(ones), i);
+        } else {
+            ASSERT_EQ(bv->select0(i + 1 - ones), i);
+        }
+        ASSERT_EQ(bv->rank1(i), ones);
+        ASSERT_EQ(bv->rank0(i), i + 1 - ones);
+    }
+}
+
 INSTANTIATE_TEST_SUITE_P(
     BitVectorStrategies,
     BitVectorTest,
@@ -188,6 +247,127 @@ INSTANTIATE_TEST_SUITE_P(
         std::function<BitVector*(size_t)>([](size_t n) { return create_bitvector<ArrayBitVectorStrategy>(n); }),
         std::function<BitVector*(size_t)>([](size_t n) { return create_bitvector<WordBitVectorStrategy>(n); }),
         std::function<BitVector*(size_t)>([](size_t n) { return create_bitvector<SaskeliBitVectorStrategy>(n); }),
-        std::function<BitVector*(size_t)>([](size_t n) { return create_bitvector<AdaptiveDynamicBitVectorStrategy>(n); })
+        std::function<BitVector*(size_t)>([](size_t n) { return create_bitvector<AdaptiveDynamicBitVectorStrategy>(n); }),
+        std::function<BitVector*(size_t)>([](size_t n) { return create_bitvector<BTreeBitVectorStrategy>(n); })
     )
 );
+
+// Compares the whole bitvector against the expected bits
+static void expect_bits(const BitVector* bv, const std::vector<bool>& expected) {
+    ASSERT_EQ(bv->size(), expected.size());
+    size_t ones = 0;
+    for (size_t i = 0; i < expected.size(); i++) {
+        ASSERT_EQ(bv->access(i), expected[i]);
+        if (expected[i]) {
+            ones++;
+            ASSERT_EQ(bv->select1(ones), i);
+        } else {
+            ASSERT_EQ(bv->select0(i + 1 - ones), i);
+        }
+        ASSERT_EQ(bv->rank1(i), ones);
+        ASSERT_EQ(bv->rank0(i), i + 1 - ones);
+    }
+}
+
+// Inserts random bits at distinct random positions, the expected bits are rebuilt in a single pass
+static void insert_random(BitVector* bv, std::vector<bool>& expected, size_t count, std::mt19937& random) {
+    std::vector<bool> inserted(expected.size() + count);
+    for (size_t chosen = 0; chosen < count; ) {
+        size_t position = random() % inserted.size();
+        if (!inserted[position]) {
+            inserted[position] = true;
+            chosen++;
+        }
+    }
+    // Inserting in ascending order keeps all following bits in front of their final position
+    std::vector<bool> result;
+    result.reserve(inserted.size());
+    size_t old_position = 0;
+    for (size_t position = 0; position < inserted.size(); position++) {
+        if (inserted[position]) {
+            bool value = random() % 3 == 0;
+            bv->insert(position, value);
+            result.push_back(value);
+        } else {
+            result.push_back(expected[old_position++]);
+        }
+    }
+    expected.swap(result);
+}
+
+// Removes the bits at distinct random positions, the expected bits are rebuilt in a single pass
+static void remove_random(BitVector* bv, std::vector<bool>& expected, size_t count, std::mt19937& random) {
+    std::vector<bool> removed(expected.size());
+    for (size_t chosen = 0; chosen < count; ) {
+        size_t position = random() % removed.size();
+        if (!removed[position]) {
+            removed[position] = true;
+            chosen++;
+        }
+    }
+    // Removing in descending order keeps the positions of all bits in front
+    for (size_t position = removed.size(); position-- > 0; ) {
+        if (removed[position]) {
+            bv->remove(position);
+        }
+    }
+    std::vector<bool> result;
+    result.reserve(expected.size() - count);
+    for (size_t position = 0; position < expected.size(); position++) {
+        if (!removed[position]) {
+            result.push_back(expected[position]);
+        }
+    }
+    expected.swap(result);
+}
+
+TEST(BTreeBitVectorTest, GrowAndShrink) {
+    // Leaves hold up to 512 bits and inner nodes up to 15 children, so 150k bits need at least two levels of inner nodes
+    std::mt19937 random(42);
+    std::vector<bool> expected;
+    std::unique_ptr<BitVector> bv(create_bitvector<BTreeBitVectorStrategy>(0));
+    while (expected.size() < 150000) {
+        insert_random(bv.get(), expected, 2000, random);
+        if (expected.size() % 50000 == 0) {
+            ASSERT_NO_FATAL_FAILURE(expect_bits(bv.get(), expected));
+        }
+    }
+
+    for (size_t round = 0; round < 60; round++) {
+        size_t operation = round % 3;
+        if (operation == 0) {
+            insert_random(bv.get(), expected, 1000, random);
+        } else if (operation == 1) {
+            remove_random(bv.get(), expected, 1000, random);
+        } else {
+            for (size_t i = 0; i < 1000; i++) {
+                size_t position = random() % expected.size();
+                expected[position] = !expected[position];
+                bv->set(position, expected[position]);
+            }
+        }
+    }
+    ASSERT_NO_FATAL_FAILURE(expect_bits(bv.get(), expected));
+
+    // The deserialized tree has to support further updates as well
+    std::vector<char> buffer(bv->get_serialized_size());
+    size_t offset = 0;
+    bv->serialize(buffer.data(), &offset);
+    EXPECT_EQ(offset, buffer.size());
+    std::unique_ptr<BitVector> deserialized(create_bitvector<BTreeBitVectorStrategy>(0));
+    offset = 0;
+    deserialized->deserialize(buffer.data(), &offset);
+    EXPECT_EQ(offset, buffer.size());
+    ASSERT_NO_FATAL_FAILURE(expect_bits(deserialized.get(), expected));
+
+    // Removing almost all bits merges the nodes until the tree is a single leaf again
+    while (expected.size() > 100) {
+        remove_random(deserialized.get(), expected, std::min<size_t>(2000, expected.size() - 100), random);
+        if (expected.size() % 50000 == 0) {
+            ASSERT_NO_FATAL_FAILURE(expect_bits(deserialized.get(), expected));
+        }
+    }
+    ASSERT_NO_FATAL_FAILURE(expect_bits(deserialized.get(), expected));
+    insert_random(deserialized.get(), expected, 1000, random);
+    ASSERT_NO_FATAL_FAILURE(expect_bits(deserialized.get(), expected));
+}
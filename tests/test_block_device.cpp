@@ -7,6 +7,10 @@
 
 #include <gtest/gtest.h>
 #include "../src/block_device/block_device.hpp"
+#include "../src/block_device/cached_block_device.hpp"
+#include "../src/block_device/io_uring_block_device.hpp"
+#include "../src/block_device/mapped_block_device.hpp"
+#include <vector>
 
 TEST(BlockDeviceTest, Create) {
     BlockDevice* device = new BlockDevice("test_block_device.img", 4096);
@@ -35,4 +39,214 @@ TEST(BlockDeviceTest, ReadWriteBlock) {
         
     delete device;
     std::remove("test_block_device.img");
-}
\ No newline at end of file
+}
+
+TEST(BlockDeviceTest, CachedReadWriteBlock) {
+    // The cache is smaller than the number of blocks, so blocks are evicted
+    CachedBlockDevice* device = new CachedBlockDevice("test_block_device.img", 4, 4096);
+
+    char write_buffer[4096];
+    for (size_t i = 0; i < 10; i++) {
+        memset(write_buffer, static_cast<char>(i + 1), 4096);
+        device->write_block(i, write_buffer);
+    }
+
+    char read_buffer[4096];
+    for (size_t i = 0; i < 10; i++) {
+        device->read_block(i, read_buffer);
+        EXPECT_EQ(read_buffer[0], static_cast<char>(i + 1));
+        EXPECT_EQ(read_buffer[4095], static_cast<char>(i + 1));
+    }
+
+    // Repeated reads of a cached block are hits
+    size_t hits = device->get_hits();
+    device->read_block(9, read_buffer);
+    device->read_block(9, read_buffer);
+    EXPECT_EQ(device->get_hits(), hits + 2);
+    EXPECT_EQ(device->get_misses(), 20);
+
+    // After flushing, the blocks are visible to an uncached device
+    memset(write_buffer, 42, 4096);
+    device->write_block(9, write_buffer);
+    device->flush();
+    BlockDevice* uncached = new BlockDevice("test_block_device.img", 4096);
+    for (size_t i = 0; i < 10; i++) {
+        uncached->read_block(i, read_buffer);
+        EXPECT_EQ(read_buffer[100], static_cast<char>(i == 9 ? 42 : i + 1));
+    }
+
+    delete uncached;
+    delete device;
+    std::remove("test_block_device.img");
+}
+
+TEST(BlockDeviceTest, CachedReadWriteBlocks) {
+    CachedBlockDevice* device = new CachedBlockDevice("test_block_device.img", 4, 4096);
+
+    // Some blocks are only dirty in the cache, others were already evicted to the file
+    std::vector<char> data(8 * 4096);
+    for (size_t i = 0; i < 8; i++) {
+        memset(data.data() + i * 4096, static_cast<char>(i + 1), 4096);
+        device->write_block(i, data.data() + i * 4096);
+    }
+
+    std::vector<char> buffer(8 * 4096);
+    device->read_blocks(0, 8, buffer.data());
+    EXPECT_EQ(buffer, data);
+
+    // Runs are written through, cached copies must not be stale afterwards
+    memset(data.data() + 4 * 4096, 42, 4 * 4096);
+    device->write_blocks(4, 4, data.data() + 4 * 4096);
+    char read_buffer[4096];
+    device->read_block(6, read_buffer);
+    EXPECT_EQ(read_buffer[0], 42);
+
+    // Blocks behind the end of the file are empty
+    device->read_blocks(100, 2, buffer.data());
+    EXPECT_EQ(buffer[0], 0);
+    EXPECT_EQ(buffer[2 * 4096 - 1], 0);
+
+    delete device;
+    device = new CachedBlockDevice("test_block_device.img", 4, 4096);
+    device->read_blocks(0, 8, buffer.data());
+    EXPECT_EQ(buffer, data);
+
+    delete device;
+    std::remove("test_block_device.img");
+}
+
+TEST(BlockDeviceTest, IoUringReadWriteBlocks) {
+    IoUringBlockDevice* device;
+    try {
+        device = new IoUringBlockDevice("test_block_device.img", false, 4, 4096);
+    } catch (const std::runtime_error&) {
+        GTEST_SKIP() << "io_uring is not available";
+    }
+
+    char write_buffer[4096];
+    char read_buffer[4096];
+    memset(write_buffer, 7, 4096);
+    device->write_block(3, write_buffer);
+    device->read_block(3, read_buffer);
+    EXPECT_EQ(memcmp(write_buffer, read_buffer, 4096), 0);
+
+    // Runs larger than one registered buffer are split into several requests
+    size_t count = IO_URING_BUFFER_BLOCKS * 2 + 3;
+    std::vector<char> data(count * 4096);
+    for (size_t i = 0; i < count; i++) {
+        memset(data.data() + i * 4096, static_cast<char>(i + 1), 4096);
+    }
+    device->write_blocks(10, count, data.data());
+    // Synchronizing the file goes through the ring as well, which stays usable afterwards
+    device->flush();
+    std::vector<char> buffer(count * 4096);
+    device->read_blocks(10, count, buffer.data());
+    EXPECT_EQ(buffer, data);
+
+    // Blocks behind the end of the file are empty
+    device->read_blocks(10000, 2, buffer.data());
+    EXPECT_EQ(buffer[0], 0);
+    EXPECT_EQ(buffer[2 * 4096 - 1], 0);
+
+    delete device;
+    std::remove("test_block_device.img");
+}
+
+TEST(BlockDeviceTest, IoUringSubmitBatch) {
+    IoUringBlockDevice* device;
+    try {
+        device = new IoUringBlockDevice("test_block_device.img", false, 4, 4096);
+    } catch (const std::runtime_error&) {
+        GTEST_SKIP() << "io_uring is not available";
+    }
+
+    // More requests than the queue depth
+    std::vector<std::vector<char>> data(16, std::vector<char>(2 * 4096));
+    std::vector<BlockRequest> writes;
+    for (size_t i = 0; i < data.size(); i++) {
+        memset(data[i].data(), static_cast<char>(i + 1), data[i].size());
+        writes.push_back({i * 5, 2, data[i].data(), true});
+    }
+    device->submit(writes);
+
+    std::vector<std::vector<char>> buffers(16, std::vector<char>(2 * 4096));
+    std::vector<BlockRequest> reads;
+    for (size_t i = 0; i < buffers.size(); i++) {
+        reads.push_back({i * 5, 2, buffers[i].data(), false});
+    }
+    device->submit(reads);
+    EXPECT_EQ(buffers, data);
+
+    delete device;
+
+    // The data is visible to the synchronous backend
+    BlockDevice* file_device = new BlockDevice("test_block_device.img", 4096);
+    std::vector<char> buffer(2 * 4096);
+    file_device->read_blocks(15 * 5, 2, buffer.data());
+    EXPECT_EQ(buffer, data[15]);
+    delete file_device;
+    std::remove("test_block_device.img");
+}
+
+TEST(BlockDeviceTest, IoUringDirect) {
+    IoUringBlockDevice* device;
+    try {
+        device = new IoUringBlockDevice("test_block_device.img", true, 4, 4096);
+    } catch (const std::runtime_error&) {
+        std::remove("test_block_device.img");
+        GTEST_SKIP() << "io_uring or O_DIRECT is not available";
+    }
+
+    // Unaligned caller buffers are copied through the aligned registered buffers
+    std::vector<char> data(3 * 4096 + 1);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = static_cast<char>(i * 31);
+    }
+    device->write_blocks(1, 3, data.data() + 1);
+    std::vector<char> buffer(3 * 4096 + 1);
+    device->read_blocks(1, 3, buffer.data() + 1);
+    EXPECT_EQ(memcmp(buffer.data() + 1, data.data() + 1, 3 * 4096), 0);
+
+    delete device;
+    std::remove("test_block_device.img");
+}
+
+TEST(BlockDeviceTest, MappedReadWriteBlocks) {
+    MappedBlockDevice* device = new MappedBlockDevice("test_block_device.img", 4096);
+
+    char write_buffer[4096];
+    char read_buffer[4096];
+    memset(write_buffer, 7, 4096);
+    device->write_block(0, write_buffer);
+    EXPECT_EQ(memcmp(device->map_blocks(0, 1), write_buffer, 4096), 0);
+
+    // Writing behind the end grows the mapping
+    EXPECT_EQ(device->map_blocks(50, 1), nullptr);
+    std::vector<char> data(4 * 4096);
+    for (size_t i = 0; i < 4; i++) {
+        memset(data.data() + i * 4096, static_cast<char>(i + 1), 4096);
+    }
+    device->write_blocks(50, 4, data.data());
+    ASSERT_NE(device->map_blocks(50, 4), nullptr);
+    EXPECT_EQ(memcmp(device->map_blocks(50, 4), data.data(), 4 * 4096), 0);
+
+    // Blocks that were never written are empty
+    device->read_block(20, read_buffer);
+    EXPECT_EQ(read_buffer[0], 0);
+    std::vector<char> buffer(4 * 4096);
+    device->read_blocks(10000, 4, buffer.data());
+    EXPECT_EQ(buffer[4 * 4096 - 1], 0);
+
+    device->flush();
+    delete device;
+
+    // The data is visible to the file based block device
+    BlockDevice* file_device = new BlockDevice("test_block_device.img", 4096);
+    file_device->read_blocks(50, 4, buffer.data());
+    EXPECT_EQ(buffer, data);
+    file_device->read_block(0, read_buffer);
+    EXPECT_EQ(memcmp(read_buffer, write_buffer, 4096), 0);
+
+    delete file_device;
+    std::remove("test_block_device.img");
+}
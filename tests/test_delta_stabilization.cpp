@@ -8,12 +8,16 @@
 #include <cstddef>
 #include <cstdint>
 #include <gtest/gtest.h>
+#include <random>
+#include <vector>
 
 #include "../src/fsm/delta/delta_stabilization.hpp"
 
 TEST(DeltaStabilizationTest, FloudsToStableAndBack) {
-    #ifdef DELTA_STABILIZATION
-    DeltaStabilization delta_stabilization;
+    DeltaStabilization delta_stabilization(10);
+
+    // The root is the stable inode 1 that FUSE expects
+    EXPECT_EQ(delta_stabilization.flouds_inode_to_stable_inode(0), 1);
 
     uint64_t stable_inode = delta_stabilization.flouds_inode_to_stable_inode(5);
     auto resolved_inode = delta_stabilization.stable_inode_to_flouds_inode(stable_inode);
@@ -23,26 +27,103 @@ TEST(DeltaStabilizationTest, FloudsToStableAndBack) {
     delta_stabilization.record_remove(5);
 
     EXPECT_FALSE(delta_stabilization.stable_inode_to_flouds_inode(stable_inode).has_value());
-    #endif
+    EXPECT_FALSE(delta_stabilization.stable_inode_to_flouds_inode(0).has_value());
+
+    // The id is reused with a new generation
+    delta_stabilization.record_insert(5);
+    EXPECT_NE(delta_stabilization.flouds_inode_to_stable_inode(5), stable_inode);
+    EXPECT_FALSE(delta_stabilization.stable_inode_to_flouds_inode(stable_inode).has_value());
+}
+
+TEST(DeltaStabilizationTest, ShiftedInodes) {
+    DeltaStabilization delta_stabilization(101);
+
+    uint64_t stable_inode = delta_stabilization.flouds_inode_to_stable_inode(100);
+
+    // Any number of operations keeps the stable inode valid
+    for (size_t i = 0; i < 1000; i++) {
+        delta_stabilization.record_insert(1);
+    }
+    delta_stabilization.record_remove(3);
+
+    auto resolved_inode = delta_stabilization.stable_inode_to_flouds_inode(stable_inode);
+    ASSERT_TRUE(resolved_inode.has_value());
+    EXPECT_EQ(*resolved_inode, 1099);
 }
 
-TEST(DeltaStabilizationTest, Overflow) {
-    #ifdef DELTA_STABILIZATION
+TEST(DeltaStabilizationTest, RandomOperations) {
     DeltaStabilization delta_stabilization;
+    // The stable inodes in the order of the FLOUDS inodes
+    std::vector<uint64_t> expected = {1};
 
-    uint64_t stale_inode = delta_stabilization.flouds_inode_to_stable_inode(100);
+    std::mt19937 rng(42);
+    for (size_t i = 0; i < 5000; i++) {
+        if (expected.size() < 2 || rng() % 3 != 0) {
+            size_t position = 1 + rng() % expected.size();
+            delta_stabilization.record_insert(position);
+            expected.insert(expected.begin() + position, delta_stabilization.flouds_inode_to_stable_inode(position));
+        } else {
+            size_t position = 1 + rng() % (expected.size() - 1);
+            delta_stabilization.record_remove(position);
+            expected.erase(expected.begin() + position);
+        }
+    }
+
+    for (size_t i = 0; i < expected.size(); i++) {
+        EXPECT_EQ(delta_stabilization.flouds_inode_to_stable_inode(i), expected[i]);
+        EXPECT_EQ(delta_stabilization.stable_inode_to_flouds_inode(expected[i]), i);
+    }
+}
+
+TEST(DeltaStabilizationTest, SerializeDeserialize) {
+    DeltaStabilization delta_stabilization(20);
+    delta_stabilization.record_remove(4);
+    delta_stabilization.record_insert(10);
+    uint64_t removed_inode = delta_stabilization.flouds_inode_to_stable_inode(4);
+    delta_stabilization.record_remove(4);
 
-    delta_stabilization.record_insert(0);
-    uint64_t oldest_valid_inode = delta_stabilization.flouds_inode_to_stable_inode(100);
+    std::vector<char> buffer(delta_stabilization.get_serialized_size());
+    size_t offset = 0;
+    delta_stabilization.serialize(buffer.data(), &offset);
+    EXPECT_EQ(offset, buffer.size());
 
-    for (size_t i = 0; i < 256; i++) {
-        delta_stabilization.record_insert(0);
+    DeltaStabilization deserialized;
+    offset = 0;
+    deserialized.deserialize(buffer.data(), &offset);
+    for (size_t i = 0; i < 19; i++) {
+        EXPECT_EQ(deserialized.flouds_inode_to_stable_inode(i), delta_stabilization.flouds_inode_to_stable_inode(i));
     }
+    EXPECT_FALSE(deserialized.stable_inode_to_flouds_inode(removed_inode).has_value());
+
+    // Both reuse the same id
+    delta_stabilization.record_insert(2);
+    deserialized.record_insert(2);
+    EXPECT_EQ(deserialized.flouds_inode_to_stable_inode(2), delta_stabilization.flouds_inode_to_stable_inode(2));
+}
 
-    EXPECT_FALSE(delta_stabilization.stable_inode_to_flouds_inode(stale_inode).has_value());
+TEST(DeltaStabilizationTest, LookupCounts) {
+    DeltaStabilization delta_stabilization(4);
+    uint64_t stable_inode = delta_stabilization.flouds_inode_to_stable_inode(2);
+    delta_stabilization.record_lookup(stable_inode);
+    delta_stabilization.record_lookup(stable_inode, 2);
+    EXPECT_EQ(delta_stabilization.get_referenced_inodes(), 1);
 
-    auto resolved_inode = delta_stabilization.stable_inode_to_flouds_inode(oldest_valid_inode);
-    ASSERT_TRUE(resolved_inode.has_value());
-    EXPECT_EQ(*resolved_inode, 356);
-    #endif
-}
\ No newline at end of file
+    // The kernel still knows the removed node, so its id is not reused
+    delta_stabilization.record_remove(2);
+    delta_stabilization.record_insert(2);
+    EXPECT_EQ(delta_stabilization.flouds_inode_to_stable_inode(2), 5);
+    EXPECT_FALSE(delta_stabilization.stable_inode_to_flouds_inode(stable_inode).has_value());
+
+    delta_stabilization.record_forget(stable_inode, 2);
+    EXPECT_EQ(delta_stabilization.get_referenced_inodes(), 1);
+    delta_stabilization.record_forget(stable_inode, 1);
+    EXPECT_EQ(delta_stabilization.get_referenced_inodes(), 0);
+    delta_stabilization.record_insert(2);
+    EXPECT_EQ(delta_stabilization.flouds_inode_to_stable_inode(2) & UINT32_MAX, 3);
+    EXPECT_NE(delta_stabilization.flouds_inode_to_stable_inode(2), stable_inode);
+
+    // Free ids at the end are dropped
+    size_t capacity = delta_stabilization.get_capacity();
+    delta_stabilization.record_remove(delta_stabilization.stable_inode_to_flouds_inode(5).value());
+    EXPECT_EQ(delta_stabilization.get_capacity(), capacity - 1);
+}
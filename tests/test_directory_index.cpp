@@ -0,0 +1,100 @@
+/**
+ * This file is part of the Succinct Filesystem project.
+ *
+ * Copyright (c) 2026 Sebastian Brunnert <mail@sebastianbrunnert.de>
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <gtest/gtest.h>
+#include "../src/flouds/directory_index.hpp"
+#include <random>
+#include <string>
+#include <vector>
+
+TEST(DirectoryIndexTest, AppendRemoveFind) {
+    DirectoryIndex index;
+    std::vector<std::string> children;
+    for (size_t i = 0; i < 1000; i++) {
+        children.push_back("file" + std::to_string(i));
+        index.append(children.back());
+    }
+
+    // Remove children from anywhere and append new ones, the indexes of the following children shift
+    std::mt19937 rng(42);
+    for (size_t i = 0; i < 3000; i++) {
+        if (rng() % 2 == 0 && !children.empty()) {
+            size_t position = rng() % children.size();
+            index.remove(position, children[position]);
+            children.erase(children.begin() + position);
+        } else {
+            children.push_back("new" + std::to_string(i));
+            index.append(children.back());
+        }
+        ASSERT_EQ(index.size(), children.size());
+    }
+
+    for (size_t i = 0; i < children.size(); i++) {
+        auto found = index.find(children[i], [&](size_t position) {
+            return children[position] == children[i];
+        });
+        ASSERT_TRUE(found.has_value());
+        EXPECT_EQ(*found, i);
+    }
+    auto missing = index.find("missing", [&](size_t position) {
+        return children[position] == "missing";
+    });
+    EXPECT_FALSE(missing.has_value());
+}
+
+TEST(DirectoryIndexTest, Sparse) {
+    DirectoryIndex index;
+    for (size_t i = 0; i < 100; i++) {
+        index.append("file" + std::to_string(i));
+    }
+    EXPECT_FALSE(index.is_sparse());
+
+    // Removing the first child always shifts all others to the front
+    for (size_t i = 0; i < 50; i++) {
+        index.remove(0, "file" + std::to_string(i));
+    }
+    EXPECT_FALSE(index.is_sparse());
+    index.remove(0, "file50");
+    EXPECT_TRUE(index.is_sparse());
+}
+
+TEST(DirectoryIndexTest, ShiftFolders) {
+    DirectoryIndexMap map;
+    DirectoryIndex* first = map.insert(10, std::make_unique<DirectoryIndex>());
+    DirectoryIndex* second = map.insert(20, std::make_unique<DirectoryIndex>());
+    DirectoryIndex* third = map.insert(30, std::make_unique<DirectoryIndex>());
+    EXPECT_EQ(map.find(20), second);
+    EXPECT_EQ(map.find(15), nullptr);
+
+    // An insert in front of the second folder moves it and all following ones
+    map.shift(15, true);
+    EXPECT_EQ(map.find(10), first);
+    EXPECT_EQ(map.find(20), nullptr);
+    EXPECT_EQ(map.find(21), second);
+    EXPECT_EQ(map.find(31), third);
+
+    // A remove in front of all folders moves all of them back
+    map.shift(5, false);
+    map.shift(5, false);
+    EXPECT_EQ(map.find(8), first);
+    EXPECT_EQ(map.find(19), second);
+    EXPECT_EQ(map.find(29), third);
+
+    // Adding and erasing entries keeps the shifted positions
+    DirectoryIndex* fourth = map.insert(25, std::make_unique<DirectoryIndex>());
+    map.erase(19);
+    EXPECT_EQ(map.size(), 3);
+    map.shift(26, true);
+    EXPECT_EQ(map.find(8), first);
+    EXPECT_EQ(map.find(19), nullptr);
+    EXPECT_EQ(map.find(25), fourth);
+    EXPECT_EQ(map.find(30), third);
+
+    map.clear();
+    EXPECT_EQ(map.size(), 0);
+    EXPECT_EQ(map.find(8), nullptr);
+}
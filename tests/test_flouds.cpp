@@ -9,6 +9,8 @@
 #include "../src/flouds/flouds.hpp"
 #include <vector>
 #include <tuple>
+#include <atomic>
+#include <thread>
 
 TEST(FloudsTest, Create) {
     Flouds* flouds = create_flouds();
@@ -59,6 +61,23 @@ TEST(FloudsTest, ChildrenCount) {
     delete flouds;
 }
 
+TEST(FloudsTest, Version) {
+    Flouds* flouds = create_flouds();
+    size_t version = flouds->get_version();
+    size_t folder = flouds->insert(0, "folder", true);
+    EXPECT_NE(flouds->get_version(), version);
+    version = flouds->get_version();
+
+    // Lookups do not modify the tree
+    flouds->find_child(0, "folder");
+    flouds->children_count(folder);
+    EXPECT_EQ(flouds->get_version(), version);
+
+    flouds->remove(folder);
+    EXPECT_NE(flouds->get_version(), version);
+    delete flouds;
+}
+
 TEST(FloudsTest, Parent) {
     Flouds* flouds = create_flouds();
     size_t folder1 = flouds->insert(0, "folder1", true);
@@ -248,6 +267,109 @@ TEST(FloudsTest, ComplexCase) {
     delete flouds;
 }
 
+TEST(FloudsTest, FindChild) {
+    Flouds* flouds = create_flouds();
+    size_t folder1 = flouds->insert(0, "folder1", true);
+    size_t folder2 = flouds->insert(0, "folder2", true);
+    for (size_t i = 0; i < 2 * DIRECTORY_INDEX_THRESHOLD; i++) {
+        flouds->insert(folder1, "file" + std::to_string(i), false);
+        flouds->insert(folder2, "file" + std::to_string(i), false);
+    }
+
+    // The first lookups build the name indexes of both folders
+    EXPECT_EQ(flouds->get_name(flouds->find_child(folder1, "file7")), "file7");
+    EXPECT_EQ(flouds->get_name(flouds->find_child(folder2, "file7")), "file7");
+
+    // Insert and remove nodes in front of the indexed folders and their children
+    size_t folder3 = flouds->insert(folder1, "folder3", true);
+    flouds->insert(folder3, "file", false);
+    flouds->remove(flouds->find_child(folder1, "file3"));
+    flouds->remove(flouds->find_child(folder2, "file0"));
+    flouds->insert(0, "folder4", true);
+    flouds->insert(folder2, "new", false);
+
+    folder1 = flouds->path("/folder1");
+    folder2 = flouds->path("/folder2");
+    for (size_t i = 0; i < 2 * DIRECTORY_INDEX_THRESHOLD; i++) {
+        std::string name = "file" + std::to_string(i);
+        if (i == 3) {
+            EXPECT_THROW(flouds->find_child(folder1, name), std::out_of_range);
+        } else {
+            EXPECT_EQ(flouds->get_name(flouds->find_child(folder1, name)), name);
+            EXPECT_EQ(flouds->parent(flouds->find_child(folder1, name)), folder1);
+        }
+        if (i == 0) {
+            EXPECT_THROW(flouds->find_child(folder2, name), std::out_of_range);
+        } else {
+            EXPECT_EQ(flouds->get_name(flouds->find_child(folder2, name)), name);
+            EXPECT_EQ(flouds->parent(flouds->find_child(folder2, name)), folder2);
+        }
+    }
+    EXPECT_EQ(flouds->get_name(flouds->path("/folder1/folder3/file")), "file");
+    EXPECT_EQ(flouds->get_name(flouds->path("/folder2/new")), "new");
+    EXPECT_THROW(flouds->find_child(folder2, "missing"), std::out_of_range);
+
+    delete flouds;
+}
+
+TEST(FloudsTest, FindChildAfterRemovals) {
+    Flouds* flouds = create_flouds();
+    size_t folder = flouds->insert(0, "folder", true);
+    size_t count = 8 * DIRECTORY_INDEX_THRESHOLD;
+    for (size_t i = 0; i < count; i++) {
+        flouds->insert(folder, "file" + std::to_string(i), false);
+    }
+    EXPECT_EQ(flouds->get_name(flouds->find_child(folder, "file0")), "file0");
+
+    // Remove every second child through the name index and look up the rest after each removal, the index is built again once most of it is unused
+    for (size_t i = 0; i < count; i += 2) {
+        flouds->remove(flouds->find_child(folder, "file" + std::to_string(i)));
+        std::string next = "file" + std::to_string(i + 1);
+        EXPECT_EQ(flouds->get_name(flouds->find_child(folder, next)), next);
+    }
+    flouds->insert(folder, "new", false);
+    ASSERT_EQ(flouds->children_count(folder), count / 2 + 1);
+    for (size_t i = 0; i < count; i++) {
+        std::string name = "file" + std::to_string(i);
+        if (i % 2 == 0) {
+            EXPECT_THROW(flouds->find_child(folder, name), std::out_of_range);
+        } else {
+            EXPECT_EQ(flouds->find_child(folder, name), flouds->child(folder, i / 2));
+        }
+    }
+    EXPECT_EQ(flouds->find_child(folder, "new"), flouds->child(folder, count / 2));
+
+    delete flouds;
+}
+
+TEST(FloudsTest, FindChildConcurrent) {
+    Flouds* flouds = create_flouds();
+    size_t folder = flouds->insert(0, "folder", true);
+    for (size_t i = 0; i < 4 * DIRECTORY_INDEX_THRESHOLD; i++) {
+        flouds->insert(folder, "file" + std::to_string(i), false);
+    }
+
+    // All threads race to build the name index of the folder on their first lookup
+    std::atomic<size_t> mismatches = 0;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < 8; t++) {
+        threads.emplace_back([&, t]() {
+            for (size_t i = 0; i < 4 * DIRECTORY_INDEX_THRESHOLD; i++) {
+                std::string name = "file" + std::to_string((i + t * 17) % (4 * DIRECTORY_INDEX_THRESHOLD));
+                if (flouds->get_name(flouds->find_child(folder, name)) != name) {
+                    mismatches++;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(mismatches, 0);
+
+    delete flouds;
+}
+
 TEST(FloudsTest, SerializeDeserialize) {
     Flouds* flouds = create_flouds();
     size_t folder1 = flouds->insert(0, "folder1", true);
@@ -7,6 +7,11 @@
 
 #include <gtest/gtest.h>
 #include "../src/fsm/file_system_manager.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <sys/stat.h>
+#include <thread>
 
 TEST(FileSystemManagerTest, Mount) {
     FileSystemManager* fsm = new FileSystemManager();
@@ -87,4 +92,639 @@ TEST(FileSystemManagerTest, ReadWriteFile) {
 
     delete fsm;
     std::remove("test_fs_readwrite.img");
-}
\ No newline at end of file
+}
+
+TEST(FileSystemManagerTest, MappedReadWriteFile) {
+    FileSystemManager* fsm = new FileSystemManager();
+    fsm->mount("test_fs_mapped.img", BlockDeviceBackend::MMAP);
+    // The allocation of a file is only stored for regular files
+    fsm->add_node(0, "test_file.txt", false, S_IFREG | 0644);
+    size_t node_id = fsm->get_flouds()->child(0, 0);
+
+    std::string data(3 * 4096, 'x');
+    fsm->write_file(node_id, data.data(), data.size(), 0);
+    // Writes the buffered data to the block device
+    fsm->sync();
+
+    std::string buffer(data.size(), '\0');
+    fsm->read_file(node_id, buffer.data(), buffer.size(), 0);
+    EXPECT_EQ(buffer, data);
+
+    const char* view = fsm->view_file(node_id, 100, 4000);
+    ASSERT_NE(view, nullptr);
+    EXPECT_EQ(std::string(view, 100), data.substr(4000, 100));
+
+    fsm->save();
+    delete fsm;
+
+    // The image can be mounted with the file based block device
+    fsm = new FileSystemManager();
+    fsm->mount("test_fs_mapped.img");
+    node_id = fsm->get_flouds()->child(0, 0);
+    fsm->read_file(node_id, buffer.data(), buffer.size(), 0);
+    EXPECT_EQ(buffer, data);
+
+    delete fsm;
+    std::remove("test_fs_mapped.img");
+}
+
+TEST(FileSystemManagerTest, ConcurrentReadFile) {
+    FileSystemManager* fsm = new FileSystemManager();
+    fsm->mount("test_fs_concurrent.img");
+    for (size_t i = 0; i < 8; i++) {
+        fsm->add_node(0, "file" + std::to_string(i), false, S_IFREG | 0644);
+        std::string data(2 * 4096, static_cast<char>('a' + i));
+        fsm->write_file(fsm->get_flouds()->child(0, i), data.data(), data.size(), 0);
+    }
+    fsm->sync();
+
+    // Reads only need shared access and may run in parallel
+    std::atomic<size_t> mismatches = 0;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < 8; t++) {
+        threads.emplace_back([&, t]() {
+            std::string buffer(2 * 4096, '\0');
+            for (size_t i = 0; i < 100; i++) {
+                size_t file = (t + i) % 8;
+                fsm->read_file(fsm->get_flouds()->find_child(0, "file" + std::to_string(file)), buffer.data(), buffer.size(), 0);
+                if (buffer != std::string(2 * 4096, static_cast<char>('a' + file))) {
+                    mismatches++;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(mismatches, 0);
+
+    delete fsm;
+    std::remove("test_fs_concurrent.img");
+}
+
+TEST(FileSystemManagerTest, ConcurrentWriteFile) {
+    FileSystemManager* fsm = new FileSystemManager();
+    fsm->mount("test_fs_concurrent_write.img");
+    for (size_t i = 0; i < 8; i++) {
+        fsm->add_node(0, "file" + std::to_string(i), false, S_IFREG | 0644);
+    }
+
+    // Writes of different files only need the lock of their inode
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < 8; t++) {
+        threads.emplace_back([&, t]() {
+            size_t node = fsm->get_flouds()->find_child(0, "file" + std::to_string(t));
+            std::unique_lock<std::shared_mutex> lock(fsm->get_inode_lock(node));
+            std::string data(4096, static_cast<char>('a' + t));
+            for (size_t i = 0; i < 32; i++) {
+                fsm->write_file(node, data.data(), data.size(), i * data.size());
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    fsm->sync();
+
+    for (size_t t = 0; t < 8; t++) {
+        size_t node = fsm->get_flouds()->find_child(0, "file" + std::to_string(t));
+        EXPECT_EQ(fsm->get_inode(node)->size, 32 * 4096);
+        std::string buffer(32 * 4096, '\0');
+        fsm->read_file(node, buffer.data(), buffer.size(), 0);
+        EXPECT_EQ(buffer, std::string(32 * 4096, static_cast<char>('a' + t)));
+    }
+
+    delete fsm;
+    std::remove("test_fs_concurrent_write.img");
+}
+
+#ifdef DELAYED_ALLOCATION
+TEST(FileSystemManagerTest, PageCache) {
+    FileSystemManager* fsm = new FileSystemManager();
+    fsm->mount("test_fs_page_cache.img");
+    fsm->add_node(0, "a", false, S_IFREG | 0644);
+    fsm->add_node(0, "b", false, S_IFREG | 0644);
+    Flouds* flouds = fsm->get_flouds();
+
+    // Interleaved writes to several files are all buffered
+    std::string block(4096, 'x');
+    for (size_t i = 0; i < 8; i++) {
+        block.assign(4096, 'a');
+        fsm->write_file(flouds->find_child(0, "a"), block.data(), block.size(), i * 4096);
+        block.assign(4096, 'b');
+        fsm->write_file(flouds->find_child(0, "b"), block.data(), block.size(), i * 4096);
+    }
+    size_t a = flouds->find_child(0, "a");
+    EXPECT_EQ(fsm->get_inode(a)->size, 0);
+    EXPECT_EQ(fsm->get_file_size(a), 8 * 4096);
+
+    // Buffered data follows its file when inode numbers change
+    fsm->add_node(0, "0", false, S_IFREG | 0644);
+    fsm->remove_node(flouds->find_child(0, "b"));
+    a = flouds->find_child(0, "a");
+    std::string buffer(8 * 4096, '\0');
+    fsm->read_file(a, buffer.data(), buffer.size(), 0);
+    EXPECT_EQ(buffer, std::string(8 * 4096, 'a'));
+
+    // The file is allocated at once when it is written back
+    fsm->flush_file(a);
+    EXPECT_EQ(fsm->get_inode(a)->size, 8 * 4096);
+    buffer.assign(buffer.size(), '\0');
+    fsm->read_file(a, buffer.data(), buffer.size(), 0);
+    EXPECT_EQ(buffer, std::string(8 * 4096, 'a'));
+
+    fsm->unmount();
+    delete fsm;
+    std::remove("test_fs_page_cache.img");
+}
+#endif
+
+TEST(FileSystemManagerTest, IncrementalSave) {
+    FileSystemManager* fsm = new FileSystemManager();
+    fsm->mount("test_fs_incremental.img");
+    for (size_t i = 0; i < 500; i++) {
+        fsm->add_node(0, "file" + std::to_string(i), false, 0644);
+    }
+    fsm->save();
+
+    // Only a few blocks of the metadata change here
+    Flouds* flouds = fsm->get_flouds();
+    size_t node_id = flouds->child(0, 250);
+    fsm->set_mode(node_id, 0600);
+    fsm->remove_node(flouds->child(0, 499));
+    fsm->save();
+    delete fsm;
+
+    FileSystemManager* fsm2 = new FileSystemManager();
+    fsm2->mount("test_fs_incremental.img");
+    flouds = fsm2->get_flouds();
+    EXPECT_EQ(flouds->children_count(0), 499);
+    for (size_t i = 0; i < 499; i++) {
+        EXPECT_EQ(flouds->get_name(flouds->child(0, i)), "file" + std::to_string(i));
+    }
+    EXPECT_EQ(fsm2->get_inode(flouds->child(0, 250))->mode, 0600);
+    EXPECT_EQ(fsm2->get_inode(flouds->child(0, 249))->mode, 0644);
+    delete fsm2;
+
+    std::remove("test_fs_incremental.img");
+}
+
+TEST(FileSystemManagerTest, CheckpointPolicy) {
+    FileSystemManager* fsm = new FileSystemManager();
+    fsm->mount("test_fs_checkpoint.img");
+    fsm->set_checkpoint_policy({2, 0, true});
+    fsm->add_node(0, "first.txt", false, 0644);
+    fsm->checkpoint();
+    delete fsm;
+
+    // The first operation did not reach the checkpoint limit
+    fsm = new FileSystemManager();
+    fsm->mount("test_fs_checkpoint.img");
+    fsm->set_checkpoint_policy({2, 0, true});
+    EXPECT_EQ(fsm->get_flouds()->children_count(0), 0);
+    fsm->add_node(0, "first.txt", false, 0644);
+    fsm->checkpoint();
+    fsm->add_node(0, "second.txt", false, 0644);
+    fsm->checkpoint();
+    delete fsm;
+
+    fsm = new FileSystemManager();
+    fsm->mount("test_fs_checkpoint.img");
+    fsm->set_checkpoint_policy({0, 0, true});
+    EXPECT_EQ(fsm->get_flouds()->children_count(0), 2);
+    fsm->add_node(0, "third.txt", false, 0644);
+    fsm->sync();
+    delete fsm;
+
+    fsm = new FileSystemManager();
+    fsm->mount("test_fs_checkpoint.img");
+    EXPECT_EQ(fsm->get_flouds()->children_count(0), 3);
+    delete fsm;
+
+    std::remove("test_fs_checkpoint.img");
+}
+
+TEST(FileSystemManagerTest, JournalReplay) {
+    FileSystemManager* fsm = new FileSystemManager();
+    fsm->mount("test_fs_journal.img");
+    fsm->set_checkpoint_policy({0, 0, true});
+    size_t folder = fsm->add_node(0, "folder", true, 0755);
+    fsm->add_node(folder, "file.txt", false, 0644);
+    fsm->add_node(0, "removed.txt", false, 0644);
+    Flouds* flouds = fsm->get_flouds();
+    size_t file = flouds->child(flouds->child(0, 0), 0);
+    fsm->write_file(file, "journaled", 9, 0);
+    fsm->set_mode(file, 0600);
+    fsm->set_times(file, 100, 200);
+    fsm->remove_node(flouds->child(0, 1));
+    fsm->sync();
+
+    // Simulate a crash without a checkpoint
+    delete fsm;
+
+    fsm = new FileSystemManager();
+    fsm->mount("test_fs_journal.img");
+    flouds = fsm->get_flouds();
+    ASSERT_EQ(flouds->children_count(0), 1);
+    EXPECT_EQ(flouds->get_name(flouds->child(0, 0)), "folder");
+    ASSERT_EQ(flouds->children_count(flouds->child(0, 0)), 1);
+    file = flouds->child(flouds->child(0, 0), 0);
+    EXPECT_EQ(flouds->get_name(file), "file.txt");
+
+    Inode* inode = fsm->get_inode(file);
+    EXPECT_EQ(inode->size, 9);
+    EXPECT_EQ(inode->mode, 0600);
+    EXPECT_EQ(inode->access_time, 100);
+    EXPECT_EQ(inode->modification_time, 200);
+    char buffer[9];
+    fsm->read_file(file, buffer, 9, 0);
+    EXPECT_EQ(std::string(buffer, 9), "journaled");
+    delete fsm;
+
+    std::remove("test_fs_journal.img");
+}
+
+TEST(FileSystemManagerTest, ReplayMovedAllocation) {
+    FileSystemManager* fsm = new FileSystemManager();
+    fsm->mount("test_fs_replay_moved.img");
+    fsm->set_checkpoint_policy({0, 0, true});
+    fsm->add_node(0, "moved.txt", false, S_IFREG | 0644);
+    fsm->add_node(0, "behind.txt", false, S_IFREG | 0644);
+    fsm->add_node(0, "reused.txt", false, S_IFREG | 0644);
+
+    // The first file cannot grow in place, so it moves and the third file reuses its old blocks
+    std::string head(8000, 'a');
+    std::string tail(12000, 'A');
+    std::string reused(8000, 'c');
+    fsm->write_file(1, head.data(), head.size(), 0);
+    #ifdef DELAYED_ALLOCATION
+    fsm->flush_page_cache();
+    #endif
+    fsm->write_file(2, head.data(), head.size(), 0);
+    #ifdef DELAYED_ALLOCATION
+    fsm->flush_page_cache();
+    #endif
+    fsm->write_file(1, tail.data(), tail.size(), head.size());
+    #ifdef DELAYED_ALLOCATION
+    fsm->flush_page_cache();
+    #endif
+    fsm->write_file(3, reused.data(), reused.size(), 0);
+    #ifdef DELAYED_ALLOCATION
+    fsm->flush_page_cache();
+    #endif
+    fsm->sync();
+    delete fsm;
+
+    // Replaying the move must not copy the old blocks over the data at the new position
+    fsm = new FileSystemManager();
+    fsm->mount("test_fs_replay_moved.img");
+    std::string buffer(head.size() + tail.size(), '\0');
+    fsm->read_file(1, buffer.data(), buffer.size(), 0);
+    EXPECT_TRUE(buffer == head + tail);
+    buffer.resize(reused.size());
+    fsm->read_file(3, buffer.data(), buffer.size(), 0);
+    EXPECT_EQ(buffer, reused);
+    delete fsm;
+
+    std::remove("test_fs_replay_moved.img");
+}
+
+TEST(FileSystemManagerTest, FullJournalReplay) {
+    FileSystemManager* fsm = new FileSystemManager();
+    fsm->mount("test_fs_full_journal.img");
+    fsm->set_checkpoint_policy({0, 0, true});
+
+    // The inserts with long names fill the journal, the smaller mode changes of the root after them would still fit
+    size_t files = JOURNAL_SIZE / 1000;
+    for (size_t i = 0; i < files; i++) {
+        std::string name = std::to_string(i) + std::string(1000, 'x');
+        size_t node = fsm->add_node(0, name, false, 0644);
+        fsm->set_mode(0, 0700 | (i % 64));
+        fsm->set_mode(node, 0600);
+    }
+    fsm->sync();
+
+    // Simulate a crash without a checkpoint
+    delete fsm;
+
+    fsm = new FileSystemManager();
+    fsm->mount("test_fs_full_journal.img");
+    Flouds* flouds = fsm->get_flouds();
+    size_t replayed = flouds->children_count(0);
+    EXPECT_GT(replayed, 0);
+    EXPECT_LT(replayed, files);
+
+    // Only a prefix of the operations is replayed, the mode of the root was last set after the last replayed insert
+    EXPECT_EQ(fsm->get_inode(0)->mode, 0700 | ((replayed - 1) % 64));
+    for (size_t i = 0; i < replayed; i++) {
+        std::string name = std::to_string(i) + std::string(1000, 'x');
+        size_t node = flouds->find_child(0, name);
+        EXPECT_EQ(fsm->get_inode(node)->mode, 0600);
+    }
+    delete fsm;
+
+    std::remove("test_fs_full_journal.img");
+}
+
+TEST(FileSystemManagerTest, InterruptedCheckpoint) {
+    FileSystemManager* fsm = new FileSystemManager();
+    fsm->mount("test_fs_interrupted.img");
+    fsm->set_checkpoint_policy({0, 0, true});
+    for (size_t i = 0; i < 100; i++) {
+        fsm->add_node(0, "file" + std::to_string(i), false, 0644);
+    }
+    fsm->save();
+
+    // Keep the header of the first checkpoint
+    char header[4096];
+    FILE* image = fopen("test_fs_interrupted.img", "rb");
+    ASSERT_EQ(fread(header, 1, sizeof(header), image), sizeof(header));
+    fclose(image);
+
+    Flouds* flouds = fsm->get_flouds();
+    fsm->remove_node(flouds->find_child(0, "file10"));
+    fsm->add_node(0, "new.txt", false, 0644);
+    fsm->set_mode(flouds->find_child(0, "file50"), 0600);
+    fsm->sync();
+    fsm->save();
+    delete fsm;
+
+    // Simulate a crash before the header of the second checkpoint was written. The components of the first checkpoint must still be intact, so replaying the journal leads to the same state.
+    image = fopen("test_fs_interrupted.img", "r+b");
+    ASSERT_EQ(fwrite(header, 1, sizeof(header), image), sizeof(header));
+    fclose(image);
+
+    fsm = new FileSystemManager();
+    fsm->mount("test_fs_interrupted.img");
+    flouds = fsm->get_flouds();
+    ASSERT_EQ(flouds->children_count(0), 100);
+    std::vector<std::string> names;
+    for (size_t i = 0; i < 100; i++) {
+        names.emplace_back(flouds->get_name(flouds->child(0, i)));
+    }
+    EXPECT_EQ(std::count(names.begin(), names.end(), "file10"), 0);
+    EXPECT_EQ(std::count(names.begin(), names.end(), "new.txt"), 1);
+    EXPECT_EQ(fsm->get_inode(flouds->find_child(0, "file50"))->mode, 0600);
+    EXPECT_EQ(fsm->get_inode(flouds->find_child(0, "file51"))->mode, 0644);
+    delete fsm;
+
+    std::remove("test_fs_interrupted.img");
+}
+
+TEST(FileSystemManagerTest, StableInodes) {
+    FileSystemManager* fsm = new FileSystemManager();
+    fsm->mount("test_fs_stable.img");
+    fsm->set_checkpoint_policy({0, 0, true});
+    fsm->add_node(0, "first.txt", false, 0644);
+    size_t folder = fsm->add_node(0, "folder", true, 0755);
+    size_t file = fsm->add_node(folder, "file.txt", false, 0644);
+    uint64_t stable_file = fsm->get_delta_stabilization()->flouds_inode_to_stable_inode(file);
+    uint64_t stable_first = fsm->get_delta_stabilization()->flouds_inode_to_stable_inode(1);
+    fsm->save();
+
+    // The FLOUDS inode of the file shifts, its stable inode does not
+    fsm->remove_node(1);
+    fsm->add_node(0, "second.txt", false, 0644);
+    fsm->sync();
+    file = fsm->get_flouds()->path("/folder/file.txt");
+    EXPECT_EQ(fsm->get_delta_stabilization()->stable_inode_to_flouds_inode(stable_file), file);
+    EXPECT_FALSE(fsm->get_delta_stabilization()->stable_inode_to_flouds_inode(stable_first).has_value());
+
+    // The stable inodes survive a crash, as the journal is replayed in the same order
+    delete fsm;
+    fsm = new FileSystemManager();
+    fsm->mount("test_fs_stable.img");
+    file = fsm->get_flouds()->path("/folder/file.txt");
+    EXPECT_EQ(fsm->get_delta_stabilization()->stable_inode_to_flouds_inode(stable_file), file);
+    EXPECT_EQ(fsm->get_delta_stabilization()->flouds_inode_to_stable_inode(file), stable_file);
+    EXPECT_FALSE(fsm->get_delta_stabilization()->stable_inode_to_flouds_inode(stable_first).has_value());
+    fsm->unmount();
+    delete fsm;
+
+    fsm = new FileSystemManager();
+    fsm->mount("test_fs_stable.img");
+    file = fsm->get_flouds()->path("/folder/file.txt");
+    EXPECT_EQ(fsm->get_delta_stabilization()->flouds_inode_to_stable_inode(file), stable_file);
+    delete fsm;
+
+    std::remove("test_fs_stable.img");
+}
+
+TEST(FileSystemManagerTest, GrowAndTrimFile) {
+    FileSystemManager* fsm = new FileSystemManager();
+    fsm->mount("test_fs_grow.img");
+    fsm->set_checkpoint_policy({0, 0, true});
+    fsm->add_node(0, "a.txt", false, 0644);
+    fsm->add_node(0, "b.txt", false, 0644);
+
+    // Appends to both files alternate, so each file grows into the space reserved behind it
+    std::string data_a, data_b;
+    for (size_t i = 0; i < 16; i++) {
+        std::string chunk_a(4096, 'a' + i);
+        std::string chunk_b(4096, 'A' + i);
+        fsm->write_file(1, chunk_a.data(), chunk_a.size(), data_a.size());
+        fsm->write_file(2, chunk_b.data(), chunk_b.size(), data_b.size());
+        #ifdef DELAYED_ALLOCATION
+        fsm->flush_file(1);
+        fsm->flush_file(2);
+        #endif
+        data_a += chunk_a;
+        data_b += chunk_b;
+    }
+    fsm->trim_file(1);
+    fsm->trim_file(2);
+    fsm->sync();
+
+    // The reserved space is released in the journal as well
+    delete fsm;
+    fsm = new FileSystemManager();
+    fsm->mount("test_fs_grow.img");
+    std::string buffer(data_a.size(), '\0');
+    fsm->read_file(1, buffer.data(), buffer.size(), 0);
+    EXPECT_EQ(buffer, data_a);
+    fsm->read_file(2, buffer.data(), buffer.size(), 0);
+    EXPECT_EQ(buffer, data_b);
+    delete fsm;
+
+    std::remove("test_fs_grow.img");
+}
+
+TEST(FileSystemManagerTest, SparseFile) {
+    FileSystemManager* fsm = new FileSystemManager();
+    fsm->mount("test_fs_sparse.img");
+    fsm->set_checkpoint_policy({0, 0, true});
+    fsm->add_node(0, "sparse.img", false, 0644);
+
+    // Growing the file and writing far behind its end leaves the space in between unwritten
+    fsm->set_file_size(1, 1 << 20);
+    fsm->write_file(1, "end", 3, 4 << 20);
+    std::string data(8192, 'a');
+    fsm->write_file(1, data.data(), data.size(), 10000);
+    #ifdef DELAYED_ALLOCATION
+    fsm->flush_file(1);
+    #endif
+    EXPECT_EQ(fsm->get_file_size(1), (4 << 20) + 3);
+
+    // The punched range reads as zeros, the size stays the same
+    fsm->punch_hole(1, 5000, 12000);
+    fsm->sync();
+    delete fsm;
+
+    fsm = new FileSystemManager();
+    fsm->mount("test_fs_sparse.img");
+    EXPECT_EQ(fsm->get_file_size(1), (4 << 20) + 3);
+    std::string expected((4 << 20) + 3, '\0');
+    std::memset(expected.data() + 10000, 'a', 2000);
+    std::memset(expected.data() + 17000, 'a', 1192);
+    std::memcpy(expected.data() + (4 << 20), "end", 3);
+    std::string buffer(expected.size(), 'x');
+    fsm->read_file(1, buffer.data(), buffer.size(), 0);
+    EXPECT_TRUE(buffer == expected);
+    delete fsm;
+
+    std::remove("test_fs_sparse.img");
+}
+
+TEST(FileSystemManagerTest, InlineData) {
+    FileSystemManager* fsm = new FileSystemManager();
+    fsm->mount("test_fs_inline.img");
+    fsm->set_checkpoint_policy({0, 0, true});
+    fsm->add_node(0, "small.txt", false, S_IFREG | 0644);
+    fsm->add_node(0, "grows.txt", false, S_IFREG | 0644);
+    fsm->save();
+    size_t used_blocks = fsm->get_used_blocks();
+
+    // Small files do not need blocks
+    fsm->write_file(1, "tiny", 4, 0);
+    fsm->write_file(2, "hello", 5, 0);
+    #ifdef DELAYED_ALLOCATION
+    fsm->flush_page_cache();
+    #endif
+    EXPECT_EQ(fsm->get_inode(1)->allocation_handle, 0);
+    EXPECT_EQ(fsm->get_used_blocks(), used_blocks);
+
+    // The data moves to blocks when the file outgrows its inode
+    std::string data(INLINE_DATA_SIZE + 100, 'a');
+    fsm->write_file(2, data.data(), data.size(), 5);
+    #ifdef DELAYED_ALLOCATION
+    fsm->flush_page_cache();
+    #endif
+    EXPECT_NE(fsm->get_inode(2)->allocation_handle, 0);
+    fsm->sync();
+
+    // Inline data is restored from the journal
+    delete fsm;
+    fsm = new FileSystemManager();
+    fsm->mount("test_fs_inline.img");
+    char buffer[4];
+    fsm->read_file(1, buffer, 4, 0);
+    EXPECT_EQ(std::string(buffer, 4), "tiny");
+    std::string grown(data.size() + 5, '\0');
+    fsm->read_file(2, grown.data(), grown.size(), 0);
+    EXPECT_EQ(grown, "hello" + data);
+
+    // And from the checkpoint
+    fsm->save();
+    delete fsm;
+    fsm = new FileSystemManager();
+    fsm->mount("test_fs_inline.img");
+    fsm->read_file(1, buffer, 4, 0);
+    EXPECT_EQ(std::string(buffer, 4), "tiny");
+
+    // An empty file stores its data inline again
+    fsm->set_file_size(2, 0);
+    EXPECT_EQ(fsm->get_inode(2)->allocation_handle, 0);
+    delete fsm;
+
+    std::remove("test_fs_inline.img");
+}
+
+TEST(FileSystemManagerTest, ShrinkThenExtend) {
+    FileSystemManager* fsm = new FileSystemManager();
+    fsm->mount("test_fs_shrink_extend.img");
+    fsm->set_checkpoint_policy({0, 0, true});
+    fsm->add_node(0, "partial.txt", false, S_IFREG | 0644);
+    fsm->add_node(0, "blocks.txt", false, S_IFREG | 0644);
+    fsm->add_node(0, "new.txt", false, S_IFREG | 0644);
+
+    // The bytes behind the new end stay in the last block and blocks of removed files are reused, but the added space reads as zeros
+    std::string data(4000, 'a');
+    fsm->write_file(1, data.data(), data.size(), 0);
+    data.assign(20000, 'b');
+    fsm->write_file(2, data.data(), data.size(), 0);
+    #ifdef DELAYED_ALLOCATION
+    fsm->flush_page_cache();
+    #endif
+    fsm->set_file_size(1, 1000);
+    fsm->set_file_size(1, 4000);
+    fsm->set_file_size(2, 5000);
+    fsm->set_file_size(2, 20000);
+    fsm->remove_node(2);
+    // The removal moved the third file to the second node
+    fsm->write_file(2, "x", 1, 6000);
+    #ifdef DELAYED_ALLOCATION
+    fsm->flush_page_cache();
+    #endif
+    fsm->sync();
+
+    for (int mount = 0; mount < 2; mount++) {
+        std::string buffer(4000, 'x');
+        fsm->read_file(1, buffer.data(), buffer.size(), 0);
+        EXPECT_EQ(buffer, std::string(1000, 'a') + std::string(3000, '\0'));
+        buffer.assign(6001, 'y');
+        fsm->read_file(2, buffer.data(), buffer.size(), 0);
+        EXPECT_EQ(buffer, std::string(6000, '\0') + "x");
+
+        delete fsm;
+        fsm = new FileSystemManager();
+        fsm->mount("test_fs_shrink_extend.img");
+    }
+    delete fsm;
+
+    std::remove("test_fs_shrink_extend.img");
+}
+
+TEST(FileSystemManagerTest, ShrinkIntoInode) {
+    FileSystemManager* fsm = new FileSystemManager();
+    fsm->mount("test_fs_shrink_inode.img");
+    fsm->set_checkpoint_policy({0, 0, true});
+    fsm->add_node(0, "small.txt", false, S_IFREG | 0644);
+    fsm->add_node(0, "reuse.txt", false, S_IFREG | 0644);
+
+    // A file that shrinks into its inode frees its blocks, so extending it again must not bring back the old data
+    std::string data(20000, 'c');
+    fsm->write_file(1, data.data(), data.size(), 0);
+    #ifdef DELAYED_ALLOCATION
+    fsm->flush_page_cache();
+    #endif
+    fsm->set_file_size(1, 100);
+    EXPECT_EQ(fsm->get_inode(1)->allocation_handle, 0);
+    fsm->set_file_size(1, 20000);
+    fsm->set_file_size(1, 100);
+
+    // The freed blocks are reused before the crash, so the replay cannot read the moved data from them
+    data.assign(20000, 'd');
+    fsm->write_file(2, data.data(), data.size(), 0);
+    #ifdef DELAYED_ALLOCATION
+    fsm->flush_page_cache();
+    #endif
+    fsm->sync();
+
+    for (int mount = 0; mount < 2; mount++) {
+        EXPECT_EQ(fsm->get_inode(1)->size, 100);
+        EXPECT_EQ(fsm->get_inode(1)->allocation_handle, 0);
+        std::string buffer(100, 'x');
+        fsm->read_file(1, buffer.data(), buffer.size(), 0);
+        EXPECT_EQ(buffer, std::string(100, 'c'));
+        buffer.assign(20000, 'x');
+        fsm->read_file(2, buffer.data(), buffer.size(), 0);
+        EXPECT_EQ(buffer, data);
+
+        delete fsm;
+        fsm = new FileSystemManager();
+        fsm->mount("test_fs_shrink_inode.img");
+    }
+    delete fsm;
+
+    std::remove("test_fs_shrink_inode.img");
+}
@@ -9,6 +9,7 @@
 #include "../src/fsm/inode/inode.hpp"
 #include "../src/fsm/file_system_manager.hpp"
 #include <memory>
+#include <sys/stat.h>
 
 // Parameterized test class for different strategies
 class InodeManagerTest : public ::testing::Test, public ::testing::WithParamInterface<std::function<InodeManager*(AllocationManager*)>> {
@@ -103,6 +104,40 @@ TEST_P(InodeManagerTest, SerializeDeserialize) {
     }
 }
 
+TEST_P(InodeManagerTest, InlineData) {
+    BlockDevice* block_device = new BlockDevice("test_block_device.img", 4096);
+    AllocationManager* allocation_manager = create_allocation_manager<BestFitAllocationStrategy>(block_device);
+    InodeManager* inode_manager = create_inode_manager(allocation_manager);
+
+    // Enough inodes for several chunks, every second one is a file with inline data
+    for (size_t inode_number = 0; inode_number < 200; inode_number++) {
+        Inode* inode = inode_manager->insert_inode(inode_number);
+        inode->mode = (inode_number % 2 == 0) ? (S_IFREG | 0644) : (S_IFDIR | 0755);
+        if (inode_number % 2 == 0) {
+            inode->size = inode_number % 50;
+            inode_manager->get_inline_data(inode_number) = std::string(inode->size, 'a' + inode_number % 26);
+        }
+    }
+    inode_manager->remove_inode(10);
+
+    size_t serialized_size = inode_manager->get_serialized_size();
+    char* buffer = new char[serialized_size];
+    size_t offset = 0;
+    inode_manager->serialize(buffer, &offset);
+
+    InodeManager* deserialized_inode_manager = create_inode_manager(allocation_manager);
+    offset = 0;
+    deserialized_inode_manager->deserialize(buffer, &offset);
+
+    for (size_t inode_number = 0; inode_number < 199; inode_number++) {
+        size_t original = inode_number < 10 ? inode_number : inode_number + 1;
+        std::string expected = (original % 2 == 0) ? std::string(original % 50, 'a' + original % 26) : "";
+        EXPECT_EQ(deserialized_inode_manager->get_inline_data(inode_number), expected);
+    }
+    delete[] buffer;
+    std::remove("test_block_device.img");
+}
+
 INSTANTIATE_TEST_SUITE_P(
     InodeStrategies,
     InodeManagerTest,
@@ -0,0 +1,98 @@
+/**
+ * This file is part of the Succinct Filesystem project.
+ * 
+ * Copyright (c) 2026 Sebastian Brunnert <mail@sebastianbrunnert.de>
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <gtest/gtest.h>
+#include "../src/fsm/journal/journal.hpp"
+
+TEST(JournalTest, CommitAndRead) {
+    BlockDevice* block_device = new BlockDevice("test_journal.img", 4096);
+    AllocationManager* allocation_manager = create_allocation_manager<BestFitAllocationStrategy>(block_device);
+    size_t handle = allocation_manager->allocate(16384);
+
+    Journal* journal = new Journal(allocation_manager, handle, 16384, 1);
+    JournalRecord insert{JournalOperation::INSERT_NODE};
+    insert.node = 0;
+    insert.name = "file.txt";
+    insert.mode = 0644;
+    insert.modification_time = 42;
+    EXPECT_TRUE(journal->append(insert));
+
+    JournalRecord resize{JournalOperation::SET_SIZE};
+    resize.node = 1;
+    resize.size = 8192;
+    resize.allocation_handle = 7;
+    EXPECT_TRUE(journal->append(resize));
+
+    // Records are only visible after the group was committed
+    EXPECT_EQ(Journal(allocation_manager, handle, 16384, 1).read().size(), 0);
+    journal->commit();
+
+    std::vector<JournalRecord> records = Journal(allocation_manager, handle, 16384, 1).read();
+    ASSERT_EQ(records.size(), 2);
+    EXPECT_EQ(records[0].operation, JournalOperation::INSERT_NODE);
+    EXPECT_EQ(records[0].name, "file.txt");
+    EXPECT_EQ(records[0].mode, 0644);
+    EXPECT_EQ(records[0].modification_time, 42);
+    EXPECT_FALSE(records[0].is_folder);
+    EXPECT_EQ(records[1].operation, JournalOperation::SET_SIZE);
+    EXPECT_EQ(records[1].node, 1);
+    EXPECT_EQ(records[1].size, 8192);
+    EXPECT_EQ(records[1].allocation_handle, 7);
+
+    // Records of an older generation are ignored
+    EXPECT_EQ(Journal(allocation_manager, handle, 16384, 2).read().size(), 0);
+
+    delete journal;
+    delete allocation_manager;
+    std::remove("test_journal.img");
+}
+
+TEST(JournalTest, ResetAndCapacity) {
+    BlockDevice* block_device = new BlockDevice("test_journal_capacity.img", 4096);
+    AllocationManager* allocation_manager = create_allocation_manager<BestFitAllocationStrategy>(block_device);
+    size_t handle = allocation_manager->allocate(4096);
+
+    Journal journal(allocation_manager, handle, 4096, 1);
+    JournalRecord record{JournalOperation::SET_MODE};
+    record.mode = 0600;
+
+    size_t appended = 0;
+    while (journal.append(record)) {
+        record.node = ++appended;
+    }
+    EXPECT_GT(appended, 100);
+    journal.commit();
+    EXPECT_EQ(Journal(allocation_manager, handle, 4096, 1).read().size(), appended);
+
+    // After a checkpoint the journal starts empty again and new records overwrite the old ones
+    journal.reset(2);
+    EXPECT_TRUE(journal.append(record));
+    journal.commit();
+    std::vector<JournalRecord> records = Journal(allocation_manager, handle, 4096, 2).read();
+    ASSERT_EQ(records.size(), 1);
+    EXPECT_EQ(records[0].node, appended);
+
+    // Once a large record did not fit, smaller records that would fit are refused as well
+    journal.reset(3);
+    JournalRecord insert{JournalOperation::INSERT_NODE};
+    insert.name = std::string(1000, 'x');
+    size_t inserted = 0;
+    while (journal.append(insert)) {
+        inserted++;
+    }
+    EXPECT_EQ(inserted, 3);
+    EXPECT_FALSE(journal.append(record));
+    journal.commit();
+    EXPECT_EQ(Journal(allocation_manager, handle, 4096, 3).read().size(), inserted);
+
+    // A checkpoint makes the journal accept records again
+    journal.reset(4);
+    EXPECT_TRUE(journal.append(record));
+
+    delete allocation_manager;
+    std::remove("test_journal_capacity.img");
+}
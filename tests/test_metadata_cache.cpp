@@ -0,0 +1,90 @@
+/**
+ * This file is part of the Succinct Filesystem project.
+ *
+ * Copyright (c) 2026 Sebastian Brunnert <mail@sebastianbrunnert.de>
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <gtest/gtest.h>
+#include "../src/fsm/metadata_cache/metadata_cache.hpp"
+#include <cstring>
+#include <string>
+
+static struct stat make_attributes(uint64_t inode, off_t size) {
+    struct stat stbuf;
+    memset(&stbuf, 0, sizeof(stbuf));
+    stbuf.st_ino = inode;
+    stbuf.st_mode = S_IFREG | 0644;
+    stbuf.st_size = size;
+    return stbuf;
+}
+
+TEST(MetadataCacheTest, Entries) {
+    MetadataCache cache(4);
+    EXPECT_FALSE(cache.find_entry(1, "file").has_value());
+
+    cache.put_entry(1, "file", 2);
+    cache.put_entry(1, "folder", 3);
+    // The same name in another directory is another entry
+    cache.put_entry(3, "file", 4);
+    EXPECT_EQ(cache.find_entry(1, "file"), 2);
+    EXPECT_EQ(cache.find_entry(1, "folder"), 3);
+    EXPECT_EQ(cache.find_entry(3, "file"), 4);
+    EXPECT_FALSE(cache.find_entry(1, "fil").has_value());
+    EXPECT_EQ(cache.get_entry_count(), 3);
+
+    cache.invalidate_entry(1, "file");
+    EXPECT_FALSE(cache.find_entry(1, "file").has_value());
+    EXPECT_EQ(cache.find_entry(3, "file"), 4);
+    EXPECT_EQ(cache.get_entry_count(), 2);
+
+    // A new node with the same name replaces the entry
+    cache.put_entry(3, "file", 5);
+    EXPECT_EQ(cache.find_entry(3, "file"), 5);
+    EXPECT_EQ(cache.get_entry_count(), 2);
+}
+
+TEST(MetadataCacheTest, Attributes) {
+    MetadataCache cache(4);
+    EXPECT_FALSE(cache.find_attributes(2).has_value());
+
+    cache.put_attributes(2, make_attributes(2, 100));
+    auto attributes = cache.find_attributes(2);
+    ASSERT_TRUE(attributes.has_value());
+    EXPECT_EQ(attributes->st_ino, 2);
+    EXPECT_EQ(attributes->st_size, 100);
+
+    cache.put_attributes(2, make_attributes(2, 200));
+    EXPECT_EQ(cache.find_attributes(2)->st_size, 200);
+    EXPECT_EQ(cache.get_attribute_count(), 1);
+
+    cache.invalidate_attributes(2);
+    EXPECT_FALSE(cache.find_attributes(2).has_value());
+    EXPECT_EQ(cache.get_attribute_count(), 0);
+    // Invalidating missing items is allowed
+    cache.invalidate_attributes(2);
+    cache.invalidate_entry(1, "file");
+}
+
+TEST(MetadataCacheTest, EvictLeastRecentlyUsed) {
+    MetadataCache cache(3);
+    for (uint64_t inode = 2; inode < 5; inode++) {
+        cache.put_attributes(inode, make_attributes(inode, 0));
+        cache.put_entry(1, "file" + std::to_string(inode), inode);
+    }
+
+    // Using the oldest items keeps them
+    EXPECT_TRUE(cache.find_attributes(2).has_value());
+    EXPECT_TRUE(cache.find_entry(1, "file2").has_value());
+    cache.put_attributes(5, make_attributes(5, 0));
+    cache.put_entry(1, "file5", 5);
+
+    EXPECT_EQ(cache.get_attribute_count(), 3);
+    EXPECT_EQ(cache.get_entry_count(), 3);
+    EXPECT_TRUE(cache.find_attributes(2).has_value());
+    EXPECT_FALSE(cache.find_attributes(3).has_value());
+    EXPECT_TRUE(cache.find_attributes(5).has_value());
+    EXPECT_TRUE(cache.find_entry(1, "file2").has_value());
+    EXPECT_FALSE(cache.find_entry(1, "file3").has_value());
+    EXPECT_TRUE(cache.find_entry(1, "file5").has_value());
+}
@@ -8,6 +8,8 @@
 #include <gtest/gtest.h>
 #include "../src/name_sequence/name_sequence.hpp"
 #include <memory>
+#include <random>
+#include <vector>
 
 class NameSequenceTest : public ::testing::TestWithParam<std::function<NameSequence*()>> {
 protected:
@@ -29,6 +31,19 @@ TEST_P(NameSequenceTest, InsertAndAccess) {
     delete name_sequence;
 }
 
+TEST_P(NameSequenceTest, View) {
+    auto name_sequence = this->create_name_sequence();
+    for (size_t i = 0; i < 10; i++) {
+        name_sequence->insert(i, "name" + std::to_string(i));
+    }
+    name_sequence->insert(5, "longer_name");
+    EXPECT_EQ(name_sequence->view(5), "longer_name");
+    for (size_t i = 0; i < 10; i++) {
+        EXPECT_EQ(name_sequence->view(i < 5 ? i : i + 1), "name" + std::to_string(i));
+    }
+    delete name_sequence;
+}
+
 TEST_P(NameSequenceTest, Set) {
     auto name_sequence = this->create_name_sequence();
     for (size_t i = 0; i < 10; i++) {
@@ -81,6 +96,51 @@ TEST_P(NameSequenceTest, SerializeDeserialize) {
     delete deserialized_name_sequence;
 }
 
+TEST_P(NameSequenceTest, RandomOperations) {
+    // Compare against a plain vector with names sharing long prefixes
+    std::mt19937 random(42);
+    std::vector<std::string> expected;
+    auto name_sequence = this->create_name_sequence();
+    for (size_t i = 0; i < 1000; i++) {
+        size_t operation = random() % 4;
+        if (operation < 2 || expected.empty()) {
+            size_t position = random() % (expected.size() + 1);
+            std::string name = "file_" + std::to_string(random() % 100000) + ".dat";
+            expected.insert(expected.begin() + position, name);
+            name_sequence->insert(position, name);
+        } else if (operation == 2) {
+            size_t position = random() % expected.size();
+            expected.erase(expected.begin() + position);
+            name_sequence->remove(position);
+        } else {
+            size_t position = random() % expected.size();
+            expected[position] = "log_2026-" + std::to_string(random() % 1000);
+            name_sequence->set(position, expected[position]);
+        }
+    }
+
+    ASSERT_EQ(name_sequence->size(), expected.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        EXPECT_EQ(name_sequence->access(i), expected[i]);
+        EXPECT_EQ(name_sequence->view(i), expected[i]);
+    }
+    EXPECT_GT(name_sequence->get_memory_usage(), 0);
+    delete name_sequence;
+}
+
+TEST(FrontCodedNameSequenceTest, MemoryUsage) {
+    NameSequence* array = create_name_sequence<ArrayNameSequenceStrategy>();
+    NameSequence* front_coded = create_name_sequence<FrontCodedNameSequenceStrategy>();
+    for (size_t i = 0; i < 10000; i++) {
+        std::string name = "benchmark_file_" + std::to_string(100000 + i) + ".dat";
+        array->insert(i, name);
+        front_coded->insert(i, name);
+    }
+    EXPECT_LT(front_coded->get_memory_usage() * 2, array->get_memory_usage());
+    delete array;
+    delete front_coded;
+}
+
 INSTANTIATE_TEST_SUITE_P(
     NameSequenceStrategies,
     NameSequenceTest,
@@ -88,6 +148,7 @@ INSTANTIATE_TEST_SUITE_P(
         std::function<NameSequence*()>([]() { return create_name_sequence<ArrayNameSequenceStrategy>(); }),
         std::function<NameSequence*()>([]() { return create_name_sequence<ConcatenatedNameSequenceStrategy>(); }),
         std::function<NameSequence*()>([]() { return create_name_sequence<ImmerNameSequenceStrategy>(); }),
-        std::function<NameSequence*()>([]() { return create_name_sequence<HashNameSequenceStrategy>(); })
+        std::function<NameSequence*()>([]() { return create_name_sequence<HashNameSequenceStrategy>(); }),
+        std::function<NameSequence*()>([]() { return create_name_sequence<FrontCodedNameSequenceStrategy>(); })
     )
 );
\ No newline at end of file
@@ -0,0 +1,88 @@
+/**
+ * This file is part of the Succinct Filesystem project.
+ *
+ * Copyright (c) 2026 Sebastian Brunnert <mail@sebastianbrunnert.de>
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <gtest/gtest.h>
+#include "../src/fsm/page_cache/page_cache.hpp"
+#include <string>
+
+TEST(PageCacheTest, WriteAndRead) {
+    PageCache cache(16, 8);
+    EXPECT_FALSE(cache.contains(1));
+    EXPECT_TRUE(cache.write(1, "Hello, World!", 13, 10));
+    EXPECT_TRUE(cache.contains(1));
+    EXPECT_EQ(cache.get_end(1), 23);
+    // The write spans the first two pages
+    EXPECT_EQ(cache.get_dirty_pages(), 2);
+
+    // Bytes that are not buffered are left unchanged
+    std::string buffer(30, '.');
+    cache.read(1, buffer.data(), buffer.size(), 0);
+    EXPECT_EQ(buffer, "..........Hello, World!.......");
+
+    buffer = std::string(5, '.');
+    cache.read(1, buffer.data(), buffer.size(), 17);
+    EXPECT_EQ(buffer, "World");
+}
+
+TEST(PageCacheTest, CoalesceRuns) {
+    PageCache cache(16, 8);
+    EXPECT_TRUE(cache.write(1, "aaaaaaaaaaaaaaaa", 16, 0));
+    EXPECT_TRUE(cache.write(1, "bbbb", 4, 16));
+    EXPECT_TRUE(cache.write(1, "cccc", 4, 20));
+    EXPECT_TRUE(cache.write(1, "dddd", 4, 64));
+    // Overwrites buffered data
+    EXPECT_TRUE(cache.write(1, "xx", 2, 18));
+    EXPECT_TRUE(cache.write(2, "eeee", 4, 0));
+
+    std::vector<DirtyRun> runs = cache.take(1);
+    ASSERT_EQ(runs.size(), 2);
+    EXPECT_EQ(runs[0].offset, 0);
+    EXPECT_EQ(std::string(runs[0].data.begin(), runs[0].data.end()), "aaaaaaaaaaaaaaaabbxxcccc");
+    EXPECT_EQ(runs[1].offset, 64);
+    EXPECT_EQ(std::string(runs[1].data.begin(), runs[1].data.end()), "dddd");
+
+    EXPECT_FALSE(cache.contains(1));
+    EXPECT_TRUE(cache.contains(2));
+    EXPECT_EQ(cache.get_dirty_pages(), 1);
+}
+
+TEST(PageCacheTest, RejectGap) {
+    PageCache cache(16, 8);
+    EXPECT_TRUE(cache.write(1, "aaaa", 4, 0));
+    // The page would hold two separate dirty ranges
+    EXPECT_FALSE(cache.write(1, "bbbb", 4, 8));
+    EXPECT_EQ(cache.get_end(1), 4);
+    EXPECT_TRUE(cache.write(1, "bbbb", 4, 4));
+}
+
+TEST(PageCacheTest, Capacity) {
+    PageCache cache(16, 2);
+    EXPECT_TRUE(cache.write(1, "a", 1, 0));
+    EXPECT_TRUE(cache.write(2, "b", 1, 0));
+    EXPECT_FALSE(cache.over_capacity());
+    EXPECT_TRUE(cache.write(3, "c", 1, 0));
+    EXPECT_TRUE(cache.over_capacity());
+    cache.take(2);
+    EXPECT_FALSE(cache.over_capacity());
+}
+
+TEST(PageCacheTest, ShiftInodes) {
+    PageCache cache(16, 8);
+    EXPECT_TRUE(cache.write(1, "a", 1, 0));
+    EXPECT_TRUE(cache.write(2, "b", 1, 0));
+    EXPECT_TRUE(cache.write(4, "c", 1, 0));
+
+    cache.insert_inode(2);
+    EXPECT_EQ(cache.get_inodes(), std::vector<size_t>({1, 3, 5}));
+
+    cache.remove_inode(3);
+    EXPECT_EQ(cache.get_inodes(), std::vector<size_t>({1, 4}));
+    char c;
+    cache.read(4, &c, 1, 0);
+    EXPECT_EQ(c, 'c');
+    EXPECT_EQ(cache.get_dirty_pages(), 2);
+}